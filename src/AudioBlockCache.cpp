@@ -0,0 +1,177 @@
+/** AudioBlockCache
+  *     LRU cache of rendered output audio, by aligned blocks of samples.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cassert>
+#include <cstring>
+
+#include <iterator>
+#include <utility>
+
+#include "AudioBlockCache.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** AudioBlockCache constructor
+  *
+  * PARAMETERS:
+  *     channels     - the number of audio channels
+  *     blockSamples - the number of samples of a block; must be > 0
+  *     nbrBlocks    - the maximum number of blocks held; must be > 0
+  */
+AudioBlockCache::AudioBlockCache(int channels_, int blockSamples_, int nbrBlocks_)
+: channels(channels_),
+  blockSamples(blockSamples_),
+  nbrBlocks(nbrBlocks_),
+  mutex(),
+  blocks(),
+  index(),
+  hits(0),
+  misses(0),
+  evictions(0)
+{
+    assert(blockSamples_ > 0);
+    assert(nbrBlocks_ > 0);
+}
+
+
+/** getBlockSamples
+  *
+  * RETURNS:
+  *     the number of samples of a block; block <b> holds the samples
+  *     starting at b * getBlockSamples()
+  */
+int AudioBlockCache::getBlockSamples() const throw()
+{
+    return blockSamples;
+}
+
+
+/** contains
+  *
+  *     Checks for a block without accessing it. A missing block counts as
+  *     a miss, since the caller then renders it.
+  *
+  * RETURNS:
+  *     true if block <block> is cached
+  */
+bool AudioBlockCache::contains(int64_t block)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (index.find(block) == index.end())
+    {
+        ++misses;
+        return false;
+    }
+
+    return true;
+}
+
+
+/** fetch
+  *
+  *     Copies samples of a block, if cached.
+  *
+  * PARAMETERS:
+  *     block   - the block index
+  *     OUT dst - receives <count> interleaved samples
+  *     offset  - the first sample, relative to the block start
+  *     count   - the number of samples
+  *
+  * RETURNS:
+  *     true if the block was cached and holds the samples;
+  *     false otherwise (<dst> untouched)
+  */
+bool AudioBlockCache::fetch(int64_t block, SFLOAT* dst, int offset, int count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unordered_map<int64_t, std::list<Block>::iterator>::iterator it = index.find(block);
+    if (it == index.end() || offset + count > it->second->count)
+    {
+        ++misses;
+        return false;
+    }
+
+    ++hits;
+    blocks.splice(blocks.begin(), blocks, it->second);
+    memcpy(dst, &it->second->samples[size_t (offset) * channels], size_t (count) * channels * sizeof (SFLOAT));
+
+    return true;
+}
+
+
+/** store
+  *
+  *     Adds a rendered block, evicting the least recently used one if
+  *     the cache is full.
+  *
+  * PARAMETERS:
+  *     block  - the block index
+  *     IN src - the <count> interleaved samples starting the block
+  *     count  - the number of samples; lower than the block size only
+  *                for the last block of the clip
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void AudioBlockCache::store(int64_t block, const SFLOAT* src, int count) throw(std::bad_alloc)
+{
+    assert(count > 0 && count <= blockSamples);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::list<Block>::iterator blockIt;
+    std::unordered_map<int64_t, std::list<Block>::iterator>::iterator it = index.find(block);
+    if (it != index.end())
+    {
+        // Rendered concurrently by another thread
+        blockIt = it->second;
+    }
+    else if (int (blocks.size()) < nbrBlocks)
+    {
+        Block newBlock = Block();
+        newBlock.samples.resize(size_t (blockSamples) * channels);
+        blocks.push_front(std::move(newBlock));
+        blockIt = blocks.begin();
+        index[block] = blockIt;
+    }
+    else
+    {
+        // Recycles the least recently used block.
+        blockIt = std::prev(blocks.end());
+        index.erase(blockIt->index);
+        ++evictions;
+        index[block] = blockIt;
+    }
+
+    blocks.splice(blocks.begin(), blocks, blockIt);
+    blockIt->index = block;
+    blockIt->count = count;
+    memcpy(&blockIt->samples[0], src, size_t (count) * channels * sizeof (SFLOAT));
+}
+
+
+/** getStats
+  *
+  * RETURNS:
+  *     the block access counters
+  */
+AudioBlockCache::Stats AudioBlockCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.blocks = int (blocks.size());
+    stats.capacity = nbrBlocks;
+
+    return stats;
+}
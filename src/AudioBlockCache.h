@@ -0,0 +1,69 @@
+/** AudioBlockCache
+  *     LRU cache of rendered output audio, by aligned blocks of samples.
+  */
+
+#ifndef AUDIOBLOCKCACHE_H
+#define AUDIOBLOCKCACHE_H
+
+#include <list>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <avisynth.h>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class AudioBlockCache
+{
+public:
+    struct Stats
+    {
+        int64_t hits;
+        int64_t misses;
+        int64_t evictions;
+        int blocks;         // blocks currently held
+        int capacity;       // maximum number of blocks
+    };
+
+    AudioBlockCache(int channels, int blockSamples, int nbrBlocks);
+
+    int getBlockSamples() const throw();
+
+    bool contains(int64_t block);
+    bool fetch(int64_t block, SFLOAT* dst, int offset, int count);
+    void store(int64_t block, const SFLOAT* src, int count) throw(std::bad_alloc);
+
+    Stats getStats() const;
+
+private:
+    struct Block
+    {
+        int64_t index;
+        int count;
+        std::vector<SFLOAT> samples;
+    };
+
+    const int channels;
+    const int blockSamples;
+    const int nbrBlocks;
+
+    mutable std::mutex mutex;
+
+    // most recently used first
+    std::list<Block> blocks;
+    std::unordered_map<int64_t, std::list<Block>::iterator> index;
+
+    int64_t hits;
+    int64_t misses;
+    int64_t evictions;
+
+    AudioBlockCache(const AudioBlockCache&);
+    AudioBlockCache& operator=(const AudioBlockCache&);
+};
+
+
+#endif // AUDIOBLOCKCACHE_H
@@ -0,0 +1,247 @@
+/** AudioStreamer
+  *     Renders audio ahead of a sequential consumer into a ring buffer.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+
+#include "AudioStreamer.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** AudioStreamer constructor
+  *
+  *     The stream is inactive until restart() is called.
+  *
+  * PARAMETERS:
+  *     channels - the number of audio channels
+  *     capacity - the ring size, in samples; must be > 0
+  *     limit    - the number of samples of the stream
+  *     IN render - the function rendering the samples
+  *
+  * THROWS:
+  *     std::bad_alloc     - insufficient memory
+  *     std::system_error  - the producer thread cannot be started
+  */
+AudioStreamer::AudioStreamer(int channels_, int capacity_, int64_t limit_, const Renderer& render_)
+: channels(channels_),
+  capacity(capacity_),
+  limit(limit_),
+  render(render_),
+  ring(size_t (capacity_) * channels_),
+  readPos(0),
+  writePos(0),
+  activeFlag(false),
+  producerWaitingFlag(false),
+  mutex(),
+  cond(),
+  busyFlag(false),
+  stopFlag(false),
+  envP(NULL),
+  producer()
+{
+    assert(capacity_ > 0);
+
+    producer = std::thread(&AudioStreamer::producerLoop, this);
+}
+
+
+/** AudioStreamer destructor
+  */
+AudioStreamer::~AudioStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+        activeFlag = false;
+    }
+    cond.notify_all();
+
+    producer.join();
+}
+
+
+/** read
+  *
+  *     Reads samples from the ring, if they are those following the last
+  *     ones read. Waits for the producer when it hasn't rendered them yet.
+  *     Only one thread may call it at a time.
+  *
+  * PARAMETERS:
+  *     OUT dst - receives <count> interleaved samples
+  *     start   - the first sample
+  *     count   - the number of samples
+  *
+  * RETURNS:
+  *     true if the samples were read;
+  *     false if they must be rendered by the caller (<dst> untouched)
+  */
+bool AudioStreamer::read(SFLOAT* dst, int64_t start, int64_t count)
+{
+    if (   !activeFlag.load(std::memory_order_acquire)
+        || start != readPos.load(std::memory_order_relaxed)
+        || count > capacity
+        || start + count > limit)
+    {
+        return false;
+    }
+
+    if (writePos.load(std::memory_order_acquire) - start < count)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (activeFlag && writePos.load(std::memory_order_acquire) - start < count)
+        {
+            cond.wait(lock);
+        }
+        if (!activeFlag)
+        {
+            return false;
+        }
+    }
+
+    const int64_t offset = start % capacity;
+    const int64_t count1 = std::min(count, capacity - offset);
+    memcpy(dst, &ring[size_t (offset) * channels], size_t (count1) * channels * sizeof (SFLOAT));
+    memcpy(dst + count1 * channels, &ring[0], size_t (count - count1) * channels * sizeof (SFLOAT));
+
+    // Wakes up the producer if it is waiting for room. Both this store
+    // and the producer's check are sequentially consistent: either it
+    // sees the new position, or we see its flag and, by taking the
+    // mutex, wait until it sleeps before signaling it.
+    readPos.store(start + count);
+    if (producerWaitingFlag.load())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        cond.notify_all();
+    }
+
+    return true;
+}
+
+
+/** restart
+  *
+  *     Drops the rendered samples and starts rendering from <start>.
+  *
+  * PARAMETERS:
+  *     start       - the next sample the consumer will read; must be >= 0
+  *     IN/OUT envP - pointer to the AviSynth scripting environment, used
+  *                     by the producer from its own thread
+  */
+void AudioStreamer::restart(int64_t start, IScriptEnvironment* envP_)
+{
+    assert(start >= 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    activeFlag = false;
+    waitIdle(lock);
+
+    readPos.store(start, std::memory_order_relaxed);
+    writePos.store(start, std::memory_order_relaxed);
+    envP = envP_;
+    activeFlag.store(true, std::memory_order_release);
+
+    cond.notify_all();
+}
+
+
+/** stop
+  *
+  *     Drops the rendered samples and stops rendering. On return, the
+  *     producer doesn't access the clips any more.
+  */
+void AudioStreamer::stop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    activeFlag = false;
+    waitIdle(lock);
+}
+
+
+/** waitIdle
+  *
+  *     Waits for the producer to finish the block it is rendering.
+  *
+  * PARAMETERS:
+  *     IN/OUT lock - lock on <mutex>
+  */
+void AudioStreamer::waitIdle(std::unique_lock<std::mutex>& lock)
+{
+    cond.notify_all();
+    while (busyFlag)
+    {
+        cond.wait(lock);
+    }
+}
+
+
+/** producerLoop
+  *
+  *     Producer thread body: renders blocks as long as there is room in
+  *     the ring. An error stops the stream; the consumer then renders
+  *     the samples itself and gets the error.
+  */
+void AudioStreamer::producerLoop()
+{
+    // Small blocks keep restart() fast.
+    const int64_t blockSamples = std::min(capacity, (int64_t)4096);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;)
+    {
+        producerWaitingFlag.store(true);
+        int64_t w = writePos.load(std::memory_order_relaxed);
+        while (   !stopFlag
+               && (   !activeFlag
+                   || w >= limit
+                   || w - readPos.load() >= capacity))
+        {
+            cond.wait(lock);
+            w = writePos.load(std::memory_order_relaxed);
+        }
+        producerWaitingFlag.store(false, std::memory_order_relaxed);
+        if (stopFlag)
+        {
+            return;
+        }
+
+        const int64_t room = capacity - (w - readPos.load(std::memory_order_acquire));
+        const int64_t count = std::min(std::min(blockSamples, room),
+                                       std::min(capacity - w % capacity, limit - w));
+        SFLOAT* const dstP = &ring[size_t (w % capacity) * channels];
+        IScriptEnvironment* const workEnvP = envP;
+        busyFlag = true;
+        lock.unlock();
+
+        bool okFlag = true;
+        try
+        {
+            render(dstP, w, count, workEnvP);
+        }
+        catch (...)
+        {
+            okFlag = false;
+        }
+
+        lock.lock();
+        busyFlag = false;
+        if (!okFlag)
+        {
+            activeFlag = false;
+        }
+        else if (activeFlag)
+        {
+            writePos.store(w + count, std::memory_order_release);
+        }
+        cond.notify_all();
+    }
+}
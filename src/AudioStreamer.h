@@ -0,0 +1,81 @@
+/** AudioStreamer
+  *     Renders audio ahead of a sequential consumer into a ring buffer.
+  *
+  *     One background thread (the producer) renders the samples following
+  *     the last ones read, while the consumer reads them. The read and
+  *     write positions are atomic, so the data path takes no lock; the
+  *     mutex is only used to sleep and to restart the stream.
+  *
+  *     The producer calls the renderer with the environment last passed
+  *     to restart(), from its own thread: the clips it reads must be
+  *     MT-safe (MT_NICE_FILTER).
+  */
+
+#ifndef AUDIOSTREAMER_H
+#define AUDIOSTREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <avisynth.h>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class AudioStreamer
+{
+public:
+    // Renders <count> interleaved samples starting at <start> into <dst>.
+    typedef std::function<void (SFLOAT* dst, int64_t start, int64_t count, IScriptEnvironment* envP)> Renderer;
+
+    AudioStreamer(int channels, int capacity, int64_t limit, const Renderer& render);
+    ~AudioStreamer();
+
+    bool read(SFLOAT* dst, int64_t start, int64_t count);
+    void restart(int64_t start, IScriptEnvironment* envP);
+    void stop();
+
+private:
+    const int channels;
+
+    // ring size, in samples
+    const int64_t capacity;
+
+    // end of the stream (exclusive)
+    const int64_t limit;
+
+    const Renderer render;
+
+    std::vector<SFLOAT> ring;
+
+    // absolute sample positions; the ring holds [readPos, writePos)
+    std::atomic<int64_t> readPos;
+    std::atomic<int64_t> writePos;
+    std::atomic<bool> activeFlag;
+
+    // set while the producer checks for room or waits for it, so read()
+    // only signals it then
+    std::atomic<bool> producerWaitingFlag;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool busyFlag;
+    bool stopFlag;
+    IScriptEnvironment* envP;
+
+    std::thread producer;
+
+    void waitIdle(std::unique_lock<std::mutex>& lock);
+    void producerLoop();
+
+    AudioStreamer(const AudioStreamer&);
+    AudioStreamer& operator=(const AudioStreamer&);
+};
+
+
+#endif // AUDIOSTREAMER_H
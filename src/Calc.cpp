@@ -23,6 +23,8 @@
 #include <cassert>
 #include <cctype>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 
 
@@ -30,36 +32,67 @@
 
 
 
+// Indexed by Op. Read-only, so several Calc objects can be built and
+// evaluated concurrently. Defined before the constructor, which checks it.
+constexpr Calc::OpInfo  Calc::_op_info [Op_NBR_ELT] =
+{
+    OpInfo (0, 0),          // Op_LIT
+    OpInfo (0, 0),          // Op_VAR
+    OpInfo (1, "neg"),      // Op_NEG
+    OpInfo (1, "!"),        // Op_NOT
+    OpInfo (1, "abs"),      // Op_ABS
+    OpInfo (1, "round"),    // Op_ROUND
+    OpInfo (1, "floor"),    // Op_FLOOR
+    OpInfo (1, "ceil"),     // Op_CEIL
+    OpInfo (2, "+"),        // Op_ADD
+    OpInfo (2, "-"),        // Op_SUB
+    OpInfo (2, "*"),        // Op_MUL
+    OpInfo (2, "/"),        // Op_DIV
+    OpInfo (2, "mod"),      // Op_MOD
+    OpInfo (2, "min"),      // Op_MIN
+    OpInfo (2, "max"),      // Op_MAX
+    OpInfo (2, "=="),       // OP_EQ
+    OpInfo (2, "!="),       // OP_NE
+    OpInfo (2, ">"),        // OP_GT
+    OpInfo (2, ">="),       // OP_GE
+    OpInfo (2, "<"),        // OP_LT
+    OpInfo (2, "<="),       // OP_LE
+    OpInfo (2, "&&"),       // OP_BAND
+    OpInfo (2, "||"),       // OP_BOR
+    OpInfo (2, "^^"),       // OP_BXOR
+    OpInfo (3, "clip"),     // Op_CLIP
+    OpInfo (3, "\?")        // Op_IFELSE
+};
+
+
+
+// Checked at compile time by the constructor.
+constexpr bool	Calc::is_op_info_valid ()
+{
+    for (int op = 0; op < Op_NBR_ELT; ++op)
+    {
+        const OpInfo &  info = _op_info [op];
+        if (   info._nbr_arg < 0
+            || (info._nbr_arg > 0) != (info._txt_0 != 0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
 Calc::Calc ()
-:   _node_list ()
-,   _input_arr ()
+:   _node_arr ()
+,   _root (-1)
+,   _nbr_var (0)
 {
-    _op_info [Op_LIT   ] = OpInfo (0, 0);
-    _op_info [Op_VAR   ] = OpInfo (0, 0);
-    _op_info [Op_NEG   ] = OpInfo (1, "neg");
-    _op_info [Op_NOT   ] = OpInfo (1, "!");
-    _op_info [Op_ABS   ] = OpInfo (1, "abs");
-    _op_info [Op_ROUND ] = OpInfo (1, "round");
-    _op_info [Op_FLOOR ] = OpInfo (1, "floor");
-    _op_info [Op_CEIL  ] = OpInfo (1, "ceil");
-    _op_info [Op_ADD   ] = OpInfo (2, "+");
-    _op_info [Op_SUB   ] = OpInfo (2, "-");
-    _op_info [Op_MUL   ] = OpInfo (2, "*");
-    _op_info [Op_DIV   ] = OpInfo (2, "/");
-    _op_info [Op_MOD   ] = OpInfo (2, "mod");
-    _op_info [Op_MIN   ] = OpInfo (2, "min");
-    _op_info [Op_MAX   ] = OpInfo (2, "max");
-    _op_info [OP_EQ    ] = OpInfo (2, "==");
-    _op_info [OP_NE    ] = OpInfo (2, "!=");
-    _op_info [OP_GT    ] = OpInfo (2, ">");
-    _op_info [OP_GE    ] = OpInfo (2, ">=");
-    _op_info [OP_LT    ] = OpInfo (2, "<");
-    _op_info [OP_LE    ] = OpInfo (2, "<=");
-    _op_info [OP_BAND  ] = OpInfo (2, "&&");
-    _op_info [OP_BOR   ] = OpInfo (2, "||");
-    _op_info [OP_BXOR  ] = OpInfo (2, "^^");
-    _op_info [Op_CLIP  ] = OpInfo (3, "clip");
-    _op_info [Op_IFELSE] = OpInfo (3, "\?");
+    static_assert (
+        is_op_info_valid (),
+        "Calc::_op_info: operators need a name and arguments, other nodes neither"
+    );
 }
 
 
@@ -70,40 +103,38 @@ int	Calc::parse (const std::string &expr, const std::string &var_list)
     assert (&expr != 0);
     assert (&var_list != 0);
 
-    const int       nbr_var = int (var_list.length ());
-    _input_arr.resize (nbr_var);
-    for (int v = 0; v < nbr_var; ++v)
+    _nbr_var = int (var_list.length ());
+    for (int v = 0; v < _nbr_var; ++v)
     {
         assert (isalpha (var_list [v]));
-
-        NodeSPtr        var_sptr (new CalcNode);
-        var_sptr->_op = Op_VAR;
-        var_sptr->_content._index = v;
-
-        _input_arr [v] = var_sptr;
     }
 
     TokList         tok_list;
     tokenize (tok_list, expr);
 
-    _node_list.clear ();
-    NodeSPtr        root_sptr;
+    // Each token creates at most one node, so the arena is never
+    // reallocated during the parsing.
+    _node_arr.clear ();
+    _node_arr.reserve (tok_list.size ());
+    _root = -1;
+
+    int             root_idx = -1;
     TokList::size_type  pos = tok_list.size ();
-    int             ret_val = parse_rec (tok_list, var_list, root_sptr, pos);
+    int             ret_val = parse_rec (tok_list, var_list, root_idx, pos);
     assert (pos >= 0);
 
     if (ret_val == 0 && pos > 0)
     {
         ret_val = -1;
     }
-    if (root_sptr.get () == 0 || root_sptr->_op == Op_INVALID)
+    if (root_idx < 0 || _node_arr [root_idx]._op == Op_INVALID)
     {
         ret_val = -1;
     }
 
     if (ret_val == 0)
     {
-        _node_list.push_back (root_sptr);
+        _root = root_idx;
     }
 
     return (ret_val);
@@ -113,9 +144,9 @@ int	Calc::parse (const std::string &expr, const std::string &var_list)
 
 double	Calc::eval (const double in_arr []) const
 {
-    assert (! _node_list.empty ());
+    assert (_root >= 0);
 
-    const double    result = eval_node_rec (*(_node_list.back ()), in_arr);
+    const double    result = eval_node_rec (_root, in_arr);
 
     return (result);
 }
@@ -130,33 +161,12 @@ double	Calc::eval (const double in_arr []) const
 
 
 
-Calc::OpInfo::OpInfo ()
-:   _nbr_arg (-1)
-,   _txt_0 (0)
-{
-    // Nothing
-}
-
-
-
-Calc::OpInfo::OpInfo (int nbr_arg, const char *txt_0)
-:   _nbr_arg (nbr_arg)
-,   _txt_0 (txt_0)
-{
-	assert (nbr_arg >= 0);
-	assert (nbr_arg > 0 || txt_0 == 0);
-	assert (txt_0 != 0 || nbr_arg == 0);
-}
-
-
-
 // Could be replaced with a better parser (natural expression writing) to
 // construct the Abstract Syntax Tree.
-int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, NodeSPtr &node_sptr, TokList::size_type &pos)
+int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, int &node_idx, TokList::size_type &pos)
 {
     assert (&tok_list != 0);
     assert (&var_list != 0);
-    assert (&node_sptr != 0);
     assert (pos >= 0);
     assert (pos <= tok_list.size ());
 
@@ -171,15 +181,16 @@ int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, NodeS
         -- pos;
         const Tok &     tok = tok_list [pos];
         bool            recog_flag = false;
-        node_sptr = NodeSPtr (new CalcNode);
+        node_idx = int (_node_arr.size ());
+        _node_arr.push_back (CalcNode ());
 
         // Litteral?
         const char *    start_0 = tok._val.c_str ();
         char *          stop_0;
-        node_sptr->_content._val = strtod (start_0, &stop_0);
+        _node_arr [node_idx]._content._val = strtod (start_0, &stop_0);
         if (stop_0 != start_0)
         {
-            node_sptr->_op = Op_LIT;
+            _node_arr [node_idx]._op = Op_LIT;
             recog_flag = true;
         }
 
@@ -193,8 +204,8 @@ int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, NodeS
                 const char      c = tolower (var_list [scan_pos]);
                 if (tok._val [0] == c)
                 {
-                    node_sptr->_op = Op_VAR;
-                    node_sptr->_content._index = int (scan_pos);
+                    _node_arr [node_idx]._op = Op_VAR;
+                    _node_arr [node_idx]._content._index = int (scan_pos);
                     recog_flag = true;
                 }
             }
@@ -210,21 +221,20 @@ int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, NodeS
                 const OpInfo &  op = _op_info [scan_pos];
                 if (op._txt_0 != 0 && strcmp (tok._val.c_str (), op._txt_0) == 0)
                 {
-                    node_sptr->_op = static_cast <Op> (scan_pos);
-
-                    const size_t        arg_pos = _node_list.size ();
-                    _node_list.resize (arg_pos + op._nbr_arg);
+                    _node_arr [node_idx]._op = static_cast <Op> (scan_pos);
 
+                    // Children are appended to the arena after their
+                    // parent. Indexes are used because push_back may move
+                    // the nodes.
                     for (int arg_cnt = op._nbr_arg - 1
                     ;   arg_cnt >= 0 && ret_val == 0
                     ;   -- arg_cnt)
                     {
-                        NodeSPtr        arg_sptr;
-                        ret_val = parse_rec (tok_list, var_list, arg_sptr, pos);
+                        int             arg_idx = -1;
+                        ret_val = parse_rec (tok_list, var_list, arg_idx, pos);
                         if (ret_val == 0)
                         {
-                            _node_list.push_back (arg_sptr);
-                            node_sptr->_content._children_ptr [arg_cnt] = arg_sptr.get ();
+                            _node_arr [node_idx]._content._child_arr [arg_cnt] = arg_idx;
                         }
                     }
 
@@ -244,16 +254,18 @@ int	Calc::parse_rec (const TokList &tok_list, const std::string &var_list, NodeS
 
 
 
-double	Calc::eval_node_rec (CalcNode &node, const double in_arr []) const
+double	Calc::eval_node_rec (int node_idx, const double in_arr []) const
 {
-    assert (&node != 0);
+    assert (node_idx >= 0);
+    assert (node_idx < int (_node_arr.size ()));
     assert (in_arr != 0);
 
+    const CalcNode &    node = _node_arr [node_idx];
     double          val = 0;
     double          tmp [3];
     for (int i = 0; i < _op_info [node._op]._nbr_arg; ++i)
     {
-        tmp [i] = eval_node_rec (*(node._content._children_ptr [i]), in_arr);
+        tmp [i] = eval_node_rec (node._content._child_arr [i], in_arr);
     }
 
     switch (node._op)
@@ -264,7 +276,7 @@ double	Calc::eval_node_rec (CalcNode &node, const double in_arr []) const
 
     case Op_VAR:
         assert (node._content._index >= 0);
-        assert (node._content._index < int (_input_arr.size ()));
+        assert (node._content._index < _nbr_var);
         val = in_arr [node._content._index];
         break;
 
@@ -388,9 +400,4 @@ void	Calc::trim_wspaces (std::string &s)
 
 
 
-// Initialised in the constructor
-Calc::OpInfo    Calc::_op_info [Op_NBR_ELT];
-
-
-
 /*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
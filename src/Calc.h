@@ -19,8 +19,7 @@
 
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
-#include "SharedPtr.h"
-
+#include <string>
 #include <vector>
 
 
@@ -38,6 +37,9 @@ public:
     int             parse (const std::string &expr, const std::string &var_list);
     double          eval (const double in_arr []) const;
 
+    // Once parse() has returned, a Calc object is never modified by eval()
+    // and can be shared read-only between threads.
+
 
 
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -93,12 +95,10 @@ private:
         {
             double          _val;               // Only for Op_LIT
             int             _index;             // Only for Op_VAR
-            CalcNode *      _children_ptr [3];
+            int             _child_arr [3];     // Indexes in _node_arr
         }               _content;
     };
 
-    typedef SharedPtr <CalcNode> NodeSPtr;
-
     class Tok
     {
     public:
@@ -110,26 +110,31 @@ private:
     class OpInfo
     {
     public:
-        explicit        OpInfo ();
-        explicit        OpInfo (int nbr_arg, const char *txt_0);
+        constexpr       OpInfo (int nbr_arg, const char *txt_0)
+                        :   _nbr_arg (nbr_arg)
+                        ,   _txt_0 (txt_0)
+                        {}
         int             _nbr_arg;   // 0 if not an operator.
         const char *    _txt_0;     // Operator name. Lower case. 0 if it isn't an operator.
     };
 
     typedef std::vector <Tok> TokList;
 
-    int             parse_rec (const TokList &tok_list, const std::string &var_list, NodeSPtr &node_sptr, TokList::size_type &pos);
-    double          eval_node_rec (CalcNode &node, const double in_arr []) const;
+    int             parse_rec (const TokList &tok_list, const std::string &var_list, int &node_idx, TokList::size_type &pos);
+    double          eval_node_rec (int node_idx, const double in_arr []) const;
 
     static void     tokenize (TokList &tok_list, const std::string &expr);
     static void     trim_wspaces (std::string &s);
+    static constexpr bool
+                    is_op_info_valid ();
 
-    std::vector <NodeSPtr>
-                    _node_list;
-    std::vector <NodeSPtr>
-                    _input_arr;
+    std::vector <CalcNode>
+                    _node_arr;      // Arena owning all the nodes of the tree
+    int             _root;          // Index of the root node, -1 if not parsed
+    int             _nbr_var;
 
-    static OpInfo   _op_info [Op_NBR_ELT];     // For operators only
+    static const OpInfo
+                    _op_info [Op_NBR_ELT];     // For operators only. Constant, built at compile time.
 
 
 
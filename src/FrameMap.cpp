@@ -0,0 +1,541 @@
+/** FrameMap
+  *     Output-to-source frame index map used by RemapFrames.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cassert>
+
+#include <algorithm>
+#include <iterator>
+
+#include "FrameMap.h"
+
+
+
+// HELPERS -------------------------------------------------------------
+
+static bool runStartLess(int n, const FrameMap::Run& run)
+{
+    return n < run.start;
+}
+
+
+// Blank runs count as identity runs: their output doesn't depend on the
+// position within the run either.
+static bool isIdentityRun(const FrameMap::Run& run)
+{
+    return    run.clipIndex == MapIndex::BLANK_CLIP
+           || (run.step == 1.0 && run.base == run.origin);
+}
+
+
+// Checks whether two runs map their frames with the same formula, so they
+// can be merged when adjacent.
+static bool isSameMapping(const FrameMap::Run& a, const FrameMap::Run& b)
+{
+    if (a.clipIndex != b.clipIndex || a.step != b.step)
+    {
+        return false;
+    }
+
+    return    (isIdentityRun(a) && isIdentityRun(b))
+           || (a.base == b.base && (a.step == 0 || a.origin == b.origin));
+}
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** FrameMap constructor
+  *
+  *     Builds an empty dense map.
+  */
+FrameMap::FrameMap() throw()
+: sparseFlag(false),
+  numFrames(0),
+  srcMax(0),
+  runMap(),
+  runs(),
+  coverBlocks(),
+  coverBits()
+{
+    // Nothing
+}
+
+
+/** initDense
+  *
+  *     Resets the map to an empty dense map. Output frames are added with
+  *     append() and appendRun().
+  *
+  * PARAMETERS:
+  *     srcMax_ - the number of frames of the source clip
+  */
+void FrameMap::initDense(int srcMax_) throw()
+{
+    sparseFlag = false;
+    numFrames = 0;
+    srcMax = srcMax_;
+    runMap.clear();
+    runs.clear();
+    coverBlocks.clear();
+    coverBits.clear();
+}
+
+
+/** initSparse
+  *
+  *     Resets the map to the identity mapping over the base clip.
+  *     Overrides are added with assign(), then freeze() must be called
+  *     before any lookup.
+  *
+  * PARAMETERS:
+  *     numFrames_ - the number of output frames
+  *     srcMax_    - the number of frames of the source clip
+  */
+void FrameMap::initSparse(int numFrames_, int srcMax_) throw()
+{
+    assert(numFrames_ >= 0);
+    assert(srcMax_ > 0);
+
+    sparseFlag = true;
+    numFrames = numFrames_;
+    srcMax = srcMax_;
+    runMap.clear();
+    runs.clear();
+    coverBlocks.clear();
+    coverBits.clear();
+}
+
+
+/** size
+  *
+  * RETURNS:
+  *     the number of output frames
+  */
+int FrameMap::size() const throw()
+{
+    return numFrames;
+}
+
+
+/** isSparse
+  *
+  * RETURNS:
+  *     true if the map is a list of overrides over the identity
+  */
+bool FrameMap::isSparse() const throw()
+{
+    return sparseFlag;
+}
+
+
+/** append
+  *
+  *     Appends an output frame to a dense map. The last run is extended
+  *     when the frame continues it, so sequences of consecutive, repeated
+  *     or descending frames are stored as single runs.
+  *
+  * PARAMETERS:
+  *     IN element - the source frame; must be within the source clip
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void FrameMap::append(const MapIndex& element) throw(std::bad_alloc)
+{
+    assert(!sparseFlag);
+
+    const int n = numFrames;
+    if (!runs.empty() && runs.back().clipIndex == element.clipIndex)
+    {
+        Run& last = runs.back();
+        if (element.clipIndex == MapIndex::BLANK_CLIP)
+        {
+            last.end = n;
+            ++numFrames;
+            return;
+        }
+
+        const int delta = element.frame - last.base;
+        if (last.start == last.end && delta >= -1 && delta <= 1)
+        {
+            // Second frame of the run: sets its direction.
+            last.step = delta;
+            last.end = n;
+            ++numFrames;
+            return;
+        }
+        if (   last.step == int (last.step)
+            && last.base + int (last.step) * (n - last.origin) == element.frame)
+        {
+            last.end = n;
+            ++numFrames;
+            return;
+        }
+    }
+
+    const Run run = { n, n, element.clipIndex, n, element.frame, 0.0 };
+    runs.push_back(run);
+    ++numFrames;
+}
+
+
+/** appendRun
+  *
+  *     Appends output frames to a dense map.
+  *
+  * PARAMETERS:
+  *     IN run - the mapping of the new frames; <start> must be size()
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void FrameMap::appendRun(const Run& run) throw(std::bad_alloc)
+{
+    assert(!sparseFlag);
+    assert(run.start == numFrames && run.start <= run.end);
+
+    if (!runs.empty() && isSameMapping(runs.back(), run))
+    {
+        runs.back().end = run.end;
+    }
+    else
+    {
+        runs.push_back(run);
+    }
+    numFrames = run.end + 1;
+}
+
+
+/** assign
+  *
+  *     Overrides the mapping of the output frames covered by <run>.
+  *     Previous overrides of these frames are discarded.
+  *
+  * PARAMETERS:
+  *     IN run - the new mapping; [start, end] must lie within the map
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void FrameMap::assign(const Run& run) throw(std::bad_alloc)
+{
+    assert(sparseFlag);
+    assert(run.start >= 0 && run.start <= run.end && run.end < numFrames);
+
+    std::map<int, Run>::iterator it = runMap.lower_bound(run.start);
+
+    // Trims the run starting before the new one, splitting it if it spans
+    // the new run entirely.
+    if (it != runMap.begin())
+    {
+        Run& prev = std::prev(it)->second;
+        if (prev.end >= run.start)
+        {
+            if (prev.end > run.end)
+            {
+                Run tail = prev;
+                tail.start = run.end + 1;
+                runMap.insert(std::make_pair(tail.start, tail));
+            }
+            prev.end = run.start - 1;
+        }
+    }
+
+    // Removes the runs starting within the new one, keeping the tail of
+    // the last one if it extends past it.
+    while (it != runMap.end() && it->first <= run.end)
+    {
+        Run old = it->second;
+        runMap.erase(it++);
+        if (old.end > run.end)
+        {
+            old.start = run.end + 1;
+            runMap.insert(std::make_pair(old.start, old));
+            break;
+        }
+    }
+
+    runMap.insert(std::make_pair(run.start, run));
+}
+
+
+/** freeze
+  *
+  *     Compacts the overrides into a sorted array for the lookups,
+  *     merging adjacent runs that share the same mapping.
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void FrameMap::freeze() throw(std::bad_alloc)
+{
+    if (sparseFlag)
+    {
+        runs.clear();
+        runs.reserve(runMap.size());
+        for (std::map<int, Run>::const_iterator it = runMap.begin(); it != runMap.end(); ++it)
+        {
+            const Run& run = it->second;
+            if (   !runs.empty()
+                && runs.back().end + 1 == run.start
+                && isSameMapping(runs.back(), run))
+            {
+                runs.back().end = run.end;
+            }
+            else
+            {
+                runs.push_back(run);
+            }
+        }
+        runMap.clear();
+
+        buildCover();
+    }
+}
+
+
+/** lookup
+  *
+  * PARAMETERS:
+  *     n - the output frame index; must be in [0, size())
+  *
+  * RETURNS:
+  *     the clip and frame the output frame is taken from
+  */
+MapIndex FrameMap::lookup(int n) const throw()
+{
+    assert(n >= 0 && n < size());
+
+    MapIndex element;
+    const Run* runP = (!sparseFlag || isCovered(n)) ? findRun(n) : NULL;
+    if (runP == NULL)
+    {
+        element.clipIndex = 0;
+        element.frame = n;
+    }
+    else
+    {
+        element.clipIndex = runP->clipIndex;
+        element.frame = evalRun(*runP, n);
+    }
+
+    return element;
+}
+
+
+/** findIdentity
+  *
+  *     Checks whether output frame <n> is part of a region where each
+  *     frame is mapped to the same frame number of a single clip, or of
+  *     a region of blank frames (clip MapIndex::BLANK_CLIP).
+  *
+  * PARAMETERS:
+  *     n              - the output frame index; must be in [0, size())
+  *     OUT clipIndexP - on output, the clip of the region
+  *     OUT firstP     - on output, the first output frame of the region
+  *     OUT lastP      - on output, the last output frame of the region
+  *
+  * RETURNS:
+  *     true if such a region was found;
+  *     false otherwise (outputs left untouched)
+  */
+bool FrameMap::findIdentity(int n, int* clipIndexP, int* firstP, int* lastP) const throw()
+{
+    assert(n >= 0 && n < size());
+    assert(clipIndexP != NULL && firstP != NULL && lastP != NULL);
+
+    const Run* runP = (!sparseFlag || isCovered(n)) ? findRun(n) : NULL;
+    if (runP != NULL)
+    {
+        if (!isIdentityRun(*runP))
+        {
+            return false;
+        }
+        if (runP->clipIndex == MapIndex::BLANK_CLIP)
+        {
+            *clipIndexP = runP->clipIndex;
+            *firstP = runP->start;
+            *lastP = runP->end;
+            return true;
+        }
+        if (n >= srcMax)
+        {
+            return false;
+        }
+        *clipIndexP = runP->clipIndex;
+        *firstP = runP->start;
+        *lastP = std::min(runP->end, srcMax - 1);
+        return true;
+    }
+
+    std::vector<Run>::const_iterator next =
+        std::upper_bound(runs.begin(), runs.end(), n, runStartLess);
+    *clipIndexP = 0;
+    *firstP = (next == runs.begin()) ? 0 : std::prev(next)->end + 1;
+    *lastP = (next == runs.end()) ? numFrames - 1 : next->start - 1;
+
+    return true;
+}
+
+
+/** hasBlank
+  *
+  * RETURNS:
+  *     true if some output frames are blank
+  */
+bool FrameMap::hasBlank() const throw()
+{
+    for (std::vector<Run>::const_iterator it = runs.begin(); it != runs.end(); ++it)
+    {
+        if (it->clipIndex == MapIndex::BLANK_CLIP)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** findContiguous
+  *
+  *     Checks whether all the output frames are taken, in order, from
+  *     consecutive frames of a single clip.
+  *
+  * PARAMETERS:
+  *     OUT clipIndexP - on output, the clip
+  *     OUT firstP     - on output, the source frame of output frame 0
+  *
+  * RETURNS:
+  *     true if so;
+  *     false otherwise (outputs left untouched)
+  */
+bool FrameMap::findContiguous(int* clipIndexP, int* firstP) const throw()
+{
+    assert(clipIndexP != NULL && firstP != NULL);
+
+    if (sparseFlag || runs.size() != 1 || numFrames == 0)
+    {
+        // Sparse maps keep the identity outside of the overrides.
+        return false;
+    }
+
+    const Run& run = runs.front();
+    if (run.clipIndex == MapIndex::BLANK_CLIP || (run.step != 1.0 && run.start != run.end))
+    {
+        return false;
+    }
+
+    // The run must not be clipped at either end.
+    const int first = int (run.base + run.step * (run.start - run.origin));
+    const int last = first + (run.end - run.start);
+    if (first < 0 || last >= srcMax || last < first)
+    {
+        return false;
+    }
+
+    *clipIndexP = run.clipIndex;
+    *firstP = first;
+    return true;
+}
+
+
+/** getRuns
+  *
+  * RETURNS:
+  *     the sorted overrides of a frozen sparse map
+  */
+const std::vector<FrameMap::Run>& FrameMap::getRuns() const throw()
+{
+    return runs;
+}
+
+
+/** isCovered
+  *
+  * RETURNS:
+  *     true if output frame <n> of a frozen sparse map is overridden
+  */
+bool FrameMap::isCovered(int n) const throw()
+{
+    const int block = coverBlocks[n >> BLOCK_SHIFT];
+    if (block < 0)
+    {
+        return false;
+    }
+
+    const int bit = n & ((1 << BLOCK_SHIFT) - 1);
+    return ((coverBits[block + (bit >> WORD_SHIFT)] >> (bit & 31)) & 1) != 0;
+}
+
+
+/** buildCover
+  *
+  *     Builds the coverage table from the frozen overrides. Only the
+  *     blocks containing overridden frames get a bitmap.
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+void FrameMap::buildCover() throw(std::bad_alloc)
+{
+    const int wordsPerBlock = 1 << (BLOCK_SHIFT - WORD_SHIFT);
+    const int nbrBlocks = (numFrames + (1 << BLOCK_SHIFT) - 1) >> BLOCK_SHIFT;
+
+    coverBlocks.assign(std::max(nbrBlocks, 1), -1);
+    coverBits.clear();
+
+    for (std::vector<Run>::const_iterator it = runs.begin(); it != runs.end(); ++it)
+    {
+        for (int n = it->start; n <= it->end; ++n)
+        {
+            int& block = coverBlocks[n >> BLOCK_SHIFT];
+            if (block < 0)
+            {
+                block = int (coverBits.size());
+                coverBits.resize(coverBits.size() + wordsPerBlock, 0);
+            }
+            const int bit = n & ((1 << BLOCK_SHIFT) - 1);
+            coverBits[block + (bit >> WORD_SHIFT)] |= 1u << (bit & 31);
+        }
+    }
+}
+
+
+/** findRun
+  *
+  * RETURNS:
+  *     the run covering output frame <n>, or NULL if the frame of a sparse
+  *     map keeps its identity mapping
+  */
+const FrameMap::Run* FrameMap::findRun(int n) const throw()
+{
+    assert(runMap.empty());
+
+    std::vector<Run>::const_iterator it =
+        std::upper_bound(runs.begin(), runs.end(), n, runStartLess);
+    if (it == runs.begin())
+    {
+        return NULL;
+    }
+    --it;
+
+    return (n <= it->end) ? &*it : NULL;
+}
+
+
+/** evalRun
+  *
+  * RETURNS:
+  *     the source frame of output frame <n> within <run>
+  */
+int FrameMap::evalRun(const Run& run, int n) const throw()
+{
+    int j = int (run.base + run.step * (n - run.origin));
+
+    return   (j >= srcMax) ? srcMax - 1
+           : (j <       0) ? 0
+           :                 j;
+}
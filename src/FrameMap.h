@@ -0,0 +1,100 @@
+/** FrameMap
+  *     Output-to-source frame index map used by RemapFrames.
+  *
+  *     The map is either dense (runs covering every output frame, as
+  *     built by the simple mode) or sparse (a sorted list of override runs
+  *     on top of an implicit identity mapping to the base clip).
+  */
+
+#ifndef FRAMEMAP_H
+#define FRAMEMAP_H
+
+#include <map>
+#include <new>
+#include <vector>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+struct MapIndex
+{
+    // clipIndex of the blank frames (black frame, silent audio)
+    enum { BLANK_CLIP = 2 };
+
+    int clipIndex;
+    int frame;
+};
+
+
+class FrameMap
+{
+public:
+    // A run of consecutive output frames [start, end] taken from clip
+    // <clipIndex>. Output frame n maps to source frame
+    //     int (base + step * (n - origin))
+    // clipped to the bounds of the source clip.
+    struct Run
+    {
+        int start;
+        int end;
+        int clipIndex;
+        int origin;
+        int base;
+        double step;
+    };
+
+    FrameMap() throw();
+
+    void initDense(int srcMax) throw();
+    void initSparse(int numFrames, int srcMax) throw();
+
+    int size() const throw();
+    bool isSparse() const throw();
+
+    void append(const MapIndex& element) throw(std::bad_alloc);
+    void appendRun(const Run& run) throw(std::bad_alloc);
+    void assign(const Run& run) throw(std::bad_alloc);
+    void freeze() throw(std::bad_alloc);
+
+    MapIndex lookup(int n) const throw();
+    bool findIdentity(int n, int* clipIndexP, int* firstP, int* lastP) const throw();
+    bool hasBlank() const throw();
+    bool findContiguous(int* clipIndexP, int* firstP) const throw();
+
+    const std::vector<Run>& getRuns() const throw();
+
+private:
+    bool sparseFlag;
+
+    // number of output frames
+    int numFrames;
+
+    // number of frames of the source clip, for clipping
+    int srcMax;
+
+    // Non-overlapping runs sorted on <start>.
+    // Dense mode: contiguous runs covering all the output frames, built
+    // directly in <runs>.
+    // Sparse mode: the overrides; built in <runMap>, then moved to <runs>
+    // by freeze().
+    std::map<int, Run> runMap;
+    std::vector<Run> runs;
+
+    // Two-level coverage table of the overrides, so frames keeping their
+    // identity mapping are detected in constant time. <coverBlocks> has one
+    // entry per block of 2^BLOCK_SHIFT frames: -1 if no frame of the block
+    // is overridden, otherwise the offset of the block bitmap in
+    // <coverBits>.
+    enum { BLOCK_SHIFT = 12, WORD_SHIFT = 5 };
+    std::vector<int> coverBlocks;
+    std::vector<unsigned int> coverBits;
+
+    bool isCovered(int n) const throw();
+    void buildCover() throw(std::bad_alloc);
+    const Run* findRun(int n) const throw();
+    int evalRun(const Run& run, int n) const throw();
+};
+
+
+#endif // FRAMEMAP_H
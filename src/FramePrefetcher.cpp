@@ -0,0 +1,315 @@
+/** FramePrefetcher
+  *     Background fetching of the source frames an output frame sequence
+  *     is about to need.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cassert>
+
+#include <algorithm>
+
+#include "FramePrefetcher.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** FramePrefetcher constructor
+  *
+  * PARAMETERS:
+  *     IN clips     - the clips indexed by MapIndex::clipIndex
+  *     depth        - the number of frames fetched ahead; must be > 0
+  *     nbrThreads   - the number of worker threads; must be > 0
+  */
+FramePrefetcher::FramePrefetcher(const PClip clips_[2], int depth_, int nbrThreads)
+: depth(depth_),
+  mutex(),
+  workCond(),
+  doneCond(),
+  slots(),
+  queue(),
+  envP(NULL),
+  stopFlag(false),
+  workers()
+{
+    assert(depth_ > 0);
+    assert(nbrThreads > 0);
+
+    clips[0] = clips_[0];
+    clips[1] = clips_[1];
+
+    workers.reserve(nbrThreads);
+    for (int i = 0; i < nbrThreads; ++i)
+    {
+        workers.push_back(std::thread(&FramePrefetcher::workerLoop, this));
+    }
+}
+
+
+/** FramePrefetcher destructor
+  *
+  *     Stops the workers. Fetches in progress are completed first.
+  */
+FramePrefetcher::~FramePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+    workCond.notify_all();
+
+    for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+    {
+        it->join();
+    }
+}
+
+
+/** getDepth
+  *
+  * RETURNS:
+  *     the number of frames fetched ahead
+  */
+int FramePrefetcher::getDepth() const throw()
+{
+    return depth;
+}
+
+
+/** get
+  *
+  *     Returns a source frame, from the prefetched ones if available.
+  *     If a worker is fetching it, waits for it; otherwise fetches it in
+  *     the calling thread, so errors are reported to the caller.
+  *
+  * PARAMETERS:
+  *     IN element  - the source frame
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     the frame
+  */
+PVideoFrame FramePrefetcher::get(const MapIndex& element, IScriptEnvironment* envP_)
+{
+    const Key key(element.clipIndex, element.frame);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::map<Key, Slot>::iterator it = slots.find(key);
+    while (it != slots.end() && it->second.state == STATE_RUNNING)
+    {
+        doneCond.wait(lock);
+        it = slots.find(key);
+    }
+
+    if (it == slots.end())
+    {
+        lock.unlock();
+        return clips[element.clipIndex]->GetFrame(element.frame, envP_);
+    }
+    if (it->second.state == STATE_READY)
+    {
+        return it->second.frame;
+    }
+
+    // Queued, or failed in a worker: takes it over.
+    it->second.state = STATE_RUNNING;
+    it->second.cancelFlag = false;
+    lock.unlock();
+
+    PVideoFrame frame;
+    try
+    {
+        frame = clips[element.clipIndex]->GetFrame(element.frame, envP_);
+    }
+    catch (...)
+    {
+        lock.lock();
+        slots.erase(it);
+        doneCond.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    if (it->second.cancelFlag)
+    {
+        slots.erase(it);
+    }
+    else
+    {
+        it->second.state = STATE_READY;
+        it->second.frame = frame;
+    }
+    doneCond.notify_all();
+
+    return frame;
+}
+
+
+/** schedule
+  *
+  *     Sets the source frames to keep ready. Frames that are neither in
+  *     <window> nor being fetched are dropped.
+  *
+  * PARAMETERS:
+  *     IN window   - the source frames, in the order they will be needed
+  *     IN/OUT envP - pointer to the AviSynth scripting environment, used
+  *                     by the workers from their own threads
+  */
+void FramePrefetcher::schedule(const std::vector<MapIndex>& window, IScriptEnvironment* envP_)
+{
+    std::vector<Key> keys;
+    keys.reserve(window.size());
+    for (std::vector<MapIndex>::const_iterator it = window.begin(); it != window.end(); ++it)
+    {
+        keys.push_back(Key(it->clipIndex, it->frame));
+    }
+
+    bool addFlag = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        envP = envP_;
+
+        std::vector<Key> sortedKeys(keys);
+        std::sort(sortedKeys.begin(), sortedKeys.end());
+        dropPending(&sortedKeys);
+
+        for (std::vector<Key>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+        {
+            if (slots.find(*it) == slots.end())
+            {
+                Slot& slot = slots[*it];
+                slot.state = STATE_QUEUED;
+                slot.cancelFlag = false;
+                queue.push_back(*it);
+                addFlag = true;
+            }
+        }
+    }
+
+    if (addFlag)
+    {
+        workCond.notify_all();
+    }
+}
+
+
+/** cancel
+  *
+  *     Drops all the pending and prefetched frames, typically because
+  *     the access pattern stopped being sequential.
+  */
+void FramePrefetcher::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    dropPending(NULL);
+}
+
+
+/** dropPending
+  *
+  *     Drops the slots whose keys are not in <keepP>. Slots being fetched
+  *     are only flagged, and released by their fetcher.
+  *
+  * PARAMETERS:
+  *     IN keepP - sorted keys to keep; may be NULL to drop everything
+  *
+  * PRE:
+  *     <mutex> is locked.
+  */
+void FramePrefetcher::dropPending(const std::vector<Key>* keepP)
+{
+    std::map<Key, Slot>::iterator it = slots.begin();
+    while (it != slots.end())
+    {
+        const bool keepFlag =
+               keepP != NULL
+            && std::binary_search(keepP->begin(), keepP->end(), it->first);
+        if (it->second.state == STATE_RUNNING)
+        {
+            it->second.cancelFlag = !keepFlag;
+            ++it;
+        }
+        else if (keepFlag)
+        {
+            ++it;
+        }
+        else
+        {
+            slots.erase(it++);
+        }
+    }
+
+    std::deque<Key>::iterator dst = queue.begin();
+    for (std::deque<Key>::const_iterator src = queue.begin(); src != queue.end(); ++src)
+    {
+        std::map<Key, Slot>::const_iterator slotIt = slots.find(*src);
+        if (slotIt != slots.end() && slotIt->second.state == STATE_QUEUED)
+        {
+            *dst++ = *src;
+        }
+    }
+    queue.erase(dst, queue.end());
+}
+
+
+/** workerLoop
+  *
+  *     Worker thread body: fetches the queued frames in order.
+  */
+void FramePrefetcher::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;)
+    {
+        while (!stopFlag && queue.empty())
+        {
+            workCond.wait(lock);
+        }
+        if (stopFlag)
+        {
+            return;
+        }
+
+        const Key key = queue.front();
+        queue.pop_front();
+
+        std::map<Key, Slot>::iterator it = slots.find(key);
+        if (it == slots.end() || it->second.state != STATE_QUEUED)
+        {
+            continue;
+        }
+        it->second.state = STATE_RUNNING;
+        IScriptEnvironment* const workEnvP = envP;
+        lock.unlock();
+
+        // Errors are not reported here; get() fetches the frame again in
+        // the caller thread.
+        PVideoFrame frame;
+        bool okFlag = true;
+        try
+        {
+            frame = clips[key.first]->GetFrame(key.second, workEnvP);
+        }
+        catch (...)
+        {
+            okFlag = false;
+        }
+
+        lock.lock();
+        if (it->second.cancelFlag)
+        {
+            slots.erase(it);
+        }
+        else
+        {
+            it->second.state = okFlag ? STATE_READY : STATE_FAILED;
+            it->second.frame = frame;
+        }
+        doneCond.notify_all();
+    }
+}
@@ -0,0 +1,83 @@
+/** FramePrefetcher
+  *     Background fetching of the source frames an output frame sequence
+  *     is about to need.
+  *
+  *     RemapFrames knows in advance which source frames the next output
+  *     frames map to. While the caller processes frame n, the workers
+  *     fetch the source frames of n+1..n+depth, so their decoding
+  *     overlaps with the processing of the current frame.
+  *
+  *     The workers call the clips with the environment last passed to
+  *     schedule(), from their own threads: the clips must be MT-safe
+  *     (MT_NICE_FILTER).
+  */
+
+#ifndef FRAMEPREFETCHER_H
+#define FRAMEPREFETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <avisynth.h>
+
+#include "FrameMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class FramePrefetcher
+{
+public:
+    FramePrefetcher(const PClip clips[2], int depth, int nbrThreads);
+    ~FramePrefetcher();
+
+    int getDepth() const throw();
+
+    PVideoFrame get(const MapIndex& element, IScriptEnvironment* envP);
+    void schedule(const std::vector<MapIndex>& window, IScriptEnvironment* envP);
+    void cancel();
+
+private:
+    typedef std::pair<int, int> Key;    // (clipIndex, frame)
+
+    enum State { STATE_QUEUED, STATE_RUNNING, STATE_READY, STATE_FAILED };
+
+    struct Slot
+    {
+        State state;
+
+        // set when the slot is dropped while a worker is fetching it;
+        // the worker discards the frame when done
+        bool cancelFlag;
+
+        PVideoFrame frame;
+    };
+
+    PClip clips[2];
+    int depth;
+
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    std::map<Key, Slot> slots;
+    std::deque<Key> queue;
+    IScriptEnvironment* envP;
+    bool stopFlag;
+
+    std::vector<std::thread> workers;
+
+    void dropPending(const std::vector<Key>* keepP);
+    void workerLoop();
+
+    FramePrefetcher(const FramePrefetcher&);
+    FramePrefetcher& operator=(const FramePrefetcher&);
+};
+
+
+#endif // FRAMEPREFETCHER_H
@@ -0,0 +1,129 @@
+/** InverseFrameMap
+  *     Source-to-output frame index of a FrameMap.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cstddef>
+
+#include "InverseFrameMap.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** InverseFrameMap constructor
+  *
+  *     Inverts <map> with a counting sort of its output frames on their
+  *     source frames: a first pass counts the uses of each frame, a
+  *     second one stores the output frames, in ascending order.
+  *
+  * PARAMETERS:
+  *     IN map     - the frozen output-to-source map
+  *     mergeFlag_ - tells if the base and source clips (clip indices 0
+  *                    and 1) are the same clip
+  *
+  * THROWS:
+  *     std::bad_alloc - insufficient memory
+  */
+InverseFrameMap::InverseFrameMap(const FrameMap& map, bool mergeFlag_) throw(std::bad_alloc)
+: mergeFlag(mergeFlag_)
+{
+    // Uses of frame k, counted in first[k + 1]
+    for (int n = 0; n < map.size(); ++n)
+    {
+        const MapIndex element = map.lookup(n);
+        if (element.clipIndex == MapIndex::BLANK_CLIP)
+        {
+            continue;
+        }
+
+        std::vector<int>& first = rows[rowOf(element.clipIndex)].first;
+        if (int (first.size()) < element.frame + 2)
+        {
+            first.resize(element.frame + 2, 0);
+        }
+        ++first[element.frame + 1];
+    }
+
+    std::vector<int> next[2];
+    for (int c = 0; c < 2; ++c)
+    {
+        std::vector<int>& first = rows[c].first;
+        for (size_t k = 1; k < first.size(); ++k)
+        {
+            first[k] += first[k - 1];
+        }
+        rows[c].outputs.resize(first.empty() ? 0 : first.back());
+        next[c] = first;
+    }
+
+    for (int n = 0; n < map.size(); ++n)
+    {
+        const MapIndex element = map.lookup(n);
+        if (element.clipIndex != MapIndex::BLANK_CLIP)
+        {
+            const int row = rowOf(element.clipIndex);
+            rows[row].outputs[next[row][element.frame]++] = n;
+        }
+    }
+}
+
+
+/** countUses
+  *
+  * PARAMETERS:
+  *     clipIndex - the clip (MapIndex::clipIndex)
+  *     frame     - the frame of the clip
+  *
+  * RETURNS:
+  *     the number of output frames taken from <frame> of clip
+  *       <clipIndex>, or of either clip if they are the same; 0 for the
+  *       frames out of range
+  */
+int InverseFrameMap::countUses(int clipIndex, int frame) const throw()
+{
+    if (clipIndex < 0 || clipIndex > 1)
+    {
+        return 0;
+    }
+
+    const std::vector<int>& first = rows[rowOf(clipIndex)].first;
+    return (frame >= 0 && frame + 1 < int (first.size()))
+           ? first[frame + 1] - first[frame]
+           : 0;
+}
+
+
+/** getUses
+  *
+  * PARAMETERS:
+  *     clipIndex - the clip (MapIndex::clipIndex)
+  *     frame     - the frame of the clip
+  *
+  * RETURNS:
+  *     the countUses() output frames taken from <frame> of clip
+  *       <clipIndex>, in ascending order;
+  *     NULL if there are none
+  */
+const int* InverseFrameMap::getUses(int clipIndex, int frame) const throw()
+{
+    if (countUses(clipIndex, frame) == 0)
+    {
+        return NULL;
+    }
+
+    const Rows& row = rows[rowOf(clipIndex)];
+    return &row.outputs[row.first[frame]];
+}
+
+
+/** rowOf
+  *
+  * RETURNS:
+  *     the index of the rows of clip <clipIndex> (0 or 1)
+  */
+int InverseFrameMap::rowOf(int clipIndex) const throw()
+{
+    return mergeFlag ? 1 : clipIndex;
+}
@@ -0,0 +1,49 @@
+/** InverseFrameMap
+  *     Source-to-output frame index of a FrameMap: the output frames
+  *     taken from each frame of the base and source clips, for the
+  *     RemapFramesUsesOf and RemapFramesUseCount script functions.
+  */
+
+#ifndef INVERSEFRAMEMAP_H
+#define INVERSEFRAMEMAP_H
+
+#include <new>
+#include <vector>
+
+#include "FrameMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class InverseFrameMap
+{
+public:
+    InverseFrameMap(const FrameMap& map, bool mergeFlag_) throw(std::bad_alloc);
+
+    int countUses(int clipIndex, int frame) const throw();
+    const int* getUses(int clipIndex, int frame) const throw();
+
+private:
+    // Compressed sparse rows, one set per clip (MapIndex::clipIndex 0
+    // and 1; the blank frames aren't indexed). The output frames taken
+    // from frame k are
+    //     outputs[first[k]] to outputs[first[k + 1] - 1]
+    // in ascending order. <first> has an entry per frame up to the last
+    // one used, plus one.
+    struct Rows
+    {
+        std::vector<int> first;
+        std::vector<int> outputs;
+    };
+
+    // Tells if the base and source clips are the same clip; their frames
+    // are then indexed together, in rows[1].
+    bool mergeFlag;
+    Rows rows[2];
+
+    int rowOf(int clipIndex) const throw();
+};
+
+
+#endif // INVERSEFRAMEMAP_H
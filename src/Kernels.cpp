@@ -0,0 +1,136 @@
+/** Kernels
+  *     The inner loops of the audio rendering and of the parser: the
+  *     scalar set and the selection of a set.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cstring>
+
+#include <avs/config.h>
+#include <avs/cpuid.h>
+#ifdef AVS_POSIX
+#include <avs/posix.h>
+#endif
+
+#include "KernelsImpl.h"
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+static const Kernels kernelsScalar[Kernels::NBR_LAYOUTS] =
+    KERNELS_TABLE(Kernels::LEVEL_SCALAR, "scalar", Scalar);
+
+
+// Names of the levels, as accepted by parseLevel()
+static const char* const levelNames[] = { "scalar", "sse2", "avx2", "avx512" };
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+// Index in the tables of the set specialized for <channels>; 0, the
+// generic set, if there is none (see KERNELS_TABLE)
+static int layoutOf(int channels)
+{
+    switch (channels)
+    {
+        case 1:     return 1;
+        case 2:     return 2;
+        case 6:     return 3;
+        case 8:     return 4;
+        default:    return 0;
+    }
+}
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** get
+  *
+  * PARAMETERS:
+  *     level    - the instruction set
+  *     channels - the number of channels of the samples the audio
+  *                  kernels will be given
+  *
+  * RETURNS:
+  *     the kernels built for <level>, specialized for <channels> when
+  *       there is such a set, generic otherwise; the scalar ones when
+  *       the SIMD versions aren't built for the target
+  */
+const Kernels& Kernels::get(level_t level, int channels) throw()
+{
+    const int layout = layoutOf(channels);
+
+#ifdef REMAPFRAMES_SIMD_KERNELS
+    switch (level)
+    {
+        case LEVEL_SSE2:    return kernelsSSE2[layout];
+        case LEVEL_AVX2:    return kernelsAVX2[layout];
+        case LEVEL_AVX512:  return kernelsAVX512[layout];
+        default:            break;
+    }
+#endif
+
+    return kernelsScalar[layout];
+}
+
+
+/** bestLevel
+  *
+  * PARAMETERS:
+  *     cpuFlags - the CPUF_* flags of the processor, from
+  *                  IScriptEnvironment::GetCPUFlags()
+  *
+  * RETURNS:
+  *     the fastest level the processor runs
+  */
+Kernels::level_t Kernels::bestLevel(int cpuFlags) throw()
+{
+#ifdef REMAPFRAMES_SIMD_KERNELS
+    if ((cpuFlags & (CPUF_AVX512F | CPUF_AVX512BW)) == (CPUF_AVX512F | CPUF_AVX512BW))
+    {
+        return LEVEL_AVX512;
+    }
+    if (cpuFlags & CPUF_AVX2)
+    {
+        return LEVEL_AVX2;
+    }
+    if (cpuFlags & CPUF_SSE2)
+    {
+        return LEVEL_SSE2;
+    }
+#else
+    (void)cpuFlags;
+#endif
+
+    return LEVEL_SCALAR;
+}
+
+
+/** parseLevel
+  *
+  * PARAMETERS:
+  *     IN nameP  - "scalar", "sse2", "avx2" or "avx512" (case
+  *                   insensitive)
+  *     OUT levelP - on output, the level named <nameP>;
+  *                  left untouched if the name is unknown
+  *
+  * RETURNS:
+  *     true if the name is known;
+  *     false otherwise
+  */
+bool Kernels::parseLevel(const char* nameP, level_t* levelP) throw()
+{
+    for (int i = 0; i < (int)(sizeof levelNames / sizeof *levelNames); ++i)
+    {
+        if (_stricmp(nameP, levelNames[i]) == 0)
+        {
+            *levelP = (level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
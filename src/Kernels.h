@@ -0,0 +1,87 @@
+/** Kernels
+  *     The inner loops of the audio rendering and of the parser, in
+  *     scalar, SSE2, AVX2 and AVX-512 versions. The audio kernels of each
+  *     level are also specialized for 1, 2, 6 and 8 channels, beside a
+  *     generic version. Each filter instance picks one set when it is
+  *     created, from the CPU flags of the AviSynth environment and the
+  *     channels of its clip (see RemapFrames::selectKernels()).
+  *
+  *     All the versions give the same results, bit for bit.
+  */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <avs/config.h>
+
+
+
+// MACROS --------------------------------------------------------------
+
+// The SIMD versions are built for x86 targets only; elsewhere, every
+// level gets the scalar set.
+#if defined(X86_64) || defined(X86_32)
+#define REMAPFRAMES_SIMD_KERNELS
+#endif
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+// A set of kernels, all built for one instruction set. The samples are
+// interleaved floats (SFLOAT).
+struct Kernels
+{
+    typedef enum { LEVEL_SCALAR, LEVEL_SSE2, LEVEL_AVX2, LEVEL_AVX512 } level_t;
+
+    // Number of sets per level: the generic one, then one for each of 1,
+    // 2, 6 and 8 channels
+    enum { NBR_LAYOUTS = 5 };
+
+    level_t level;
+    const char* nameP;
+
+    // Number of channels the audio kernels are specialized for; 0 if they
+    // are the generic ones. A specialized set ignores the <channels>
+    // argument of its audio kernels.
+    int channels;
+
+    // Copies <frames> sample frames of <channels> samples.
+    void (*copyFrames)(float* dstP, const float* srcP, int frames, int channels);
+
+    // Copies <frames> sample frames in reverse order: the last frame of
+    // <srcP> first.
+    void (*reverseFrames)(float* dstP, const float* srcP, int frames, int channels);
+
+    // Blends two runs of sample frames; for each sample of frame i:
+    //     dst = (float)(mainWeights[i] * (double)main + mixWeights[i] * (double)mix)
+    // with the products and the sum rounded to double, as written.
+    // <dstP> may be <mainP>.
+    void (*blendFrames)(float* dstP, const float* mainP, const float* mixP,
+                        const double* mainWeightsP, const double* mixWeightsP, int frames, int channels);
+
+    // Return the first character of [p, endP) that isn't whitespace
+    // (as isspace() in the "C" locale), respectively a decimal digit;
+    // <endP> if there is none.
+    const char* (*skipSpaces)(const char* p, const char* endP);
+    const char* (*skipDigits)(const char* p, const char* endP);
+
+    static const Kernels& get(level_t level, int channels) throw();
+    static level_t bestLevel(int cpuFlags) throw();
+    static bool parseLevel(const char* nameP, level_t* levelP) throw();
+};
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+#ifdef REMAPFRAMES_SIMD_KERNELS
+// Defined in KernelsSSE2.cpp, KernelsAVX2.cpp and KernelsAVX512.cpp,
+// each compiled for its instruction set.
+extern const Kernels kernelsSSE2[Kernels::NBR_LAYOUTS];
+extern const Kernels kernelsAVX2[Kernels::NBR_LAYOUTS];
+extern const Kernels kernelsAVX512[Kernels::NBR_LAYOUTS];
+#endif
+
+
+#endif // KERNELS_H
@@ -0,0 +1,229 @@
+/** KernelsAVX2
+  *     The AVX2 kernels.
+  *
+  *     Only <immintrin.h> and KernelsImpl.h may be included here: the
+  *     inline functions of any other header would be compiled for AVX2
+  *     too, and could be picked by the linker for the other modules.
+  */
+
+#pragma warning (4 : 4290)
+
+#include "KernelsImpl.h"
+
+#ifdef REMAPFRAMES_SIMD_KERNELS
+
+#include <immintrin.h>
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+template <int CHANNELS>
+static void copyFramesAVX2(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int count = frames * ((CHANNELS != 0) ? CHANNELS : channelsArg);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m256 a = _mm256_loadu_ps(srcP + i);
+        const __m256 b = _mm256_loadu_ps(srcP + i + 8);
+        _mm256_storeu_ps(dstP + i, a);
+        _mm256_storeu_ps(dstP + i + 8, b);
+    }
+    copyFramesScalar<1>(dstP + i, srcP + i, count - i, 1);
+}
+
+
+template <int CHANNELS>
+static void reverseFramesAVX2(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1 || channels == 2)
+    {
+        // Whole vectors taken from the end, their frames swapped
+        const __m256i order = (channels == 1) ? _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)
+                                              : _mm256_setr_epi32(6, 7, 4, 5, 2, 3, 0, 1);
+        const int count = frames * channels;
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(srcP + count - i - 8);
+            _mm256_storeu_ps(dstP + i, _mm256_permutevar8x32_ps(v, order));
+        }
+        reverseFramesScalar<CHANNELS>(dstP + i, srcP, (count - i) / channels, channels);
+        return;
+    }
+
+    // A frame at a time: one vector for 8 channels, a half vector and a
+    // pair for 6
+    const float* frameP = srcP + (frames - 1) * channels;
+    for (int i = 0; i < frames; ++i, dstP += channels, frameP -= channels)
+    {
+        int j = 0;
+        for (; j + 8 <= channels; j += 8)
+        {
+            _mm256_storeu_ps(dstP + j, _mm256_loadu_ps(frameP + j));
+        }
+        if (j + 4 <= channels)
+        {
+            _mm_storeu_ps(dstP + j, _mm_loadu_ps(frameP + j));
+            j += 4;
+        }
+        if (j + 2 <= channels)
+        {
+            _mm_storel_epi64((__m128i*)(dstP + j), _mm_loadl_epi64((const __m128i*)(frameP + j)));
+            j += 2;
+        }
+        copyFramesScalar<1>(dstP + j, frameP + j, channels - j, 1);
+    }
+}
+
+
+// (float)(w * main + v * mix) on four doubles
+static inline __m128 blendAVX2(__m128 main, __m128 mix, __m256d w, __m256d v)
+{
+    const __m256d mainProduct = _mm256_mul_pd(w, _mm256_cvtps_pd(main));
+    const __m256d mixProduct = _mm256_mul_pd(v, _mm256_cvtps_pd(mix));
+    return _mm256_cvtpd_ps(_mm256_add_pd(mainProduct, mixProduct));
+}
+
+
+template <int CHANNELS>
+static void blendFramesAVX2(float* dstP, const float* mainP, const float* mixP,
+                            const double* mainWeightsP, const double* mixWeightsP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1 || channels == 2)
+    {
+        // Four samples per vector: four frames, or two with their
+        // weights repeated
+        const int framesPerVector = 4 / channels;
+        int i = 0;
+        for (; i + framesPerVector <= frames; i += framesPerVector)
+        {
+            __m256d w, v;
+            if (channels == 1)
+            {
+                w = _mm256_loadu_pd(mainWeightsP + i);
+                v = _mm256_loadu_pd(mixWeightsP + i);
+            }
+            else
+            {
+                w = _mm256_permute4x64_pd(_mm256_castpd128_pd256(_mm_loadu_pd(mainWeightsP + i)), 0x50);
+                v = _mm256_permute4x64_pd(_mm256_castpd128_pd256(_mm_loadu_pd(mixWeightsP + i)), 0x50);
+            }
+            const int k = i * channels;
+            _mm_storeu_ps(dstP + k, blendAVX2(_mm_loadu_ps(mainP + k), _mm_loadu_ps(mixP + k), w, v));
+        }
+        const int k = i * channels;
+        blendFramesScalar<CHANNELS>(dstP + k, mainP + k, mixP + k, mainWeightsP + i, mixWeightsP + i, frames - i, channels);
+        return;
+    }
+
+    int i = 0;
+    if (channels == 6)
+    {
+        // Two frames per three vectors, the middle one straddling them
+        for (; i + 2 <= frames; i += 2)
+        {
+            const __m256d w0 = _mm256_set1_pd(mainWeightsP[i]);
+            const __m256d w1 = _mm256_set1_pd(mainWeightsP[i + 1]);
+            const __m256d v0 = _mm256_set1_pd(mixWeightsP[i]);
+            const __m256d v1 = _mm256_set1_pd(mixWeightsP[i + 1]);
+            const int k = i * 6;
+            _mm_storeu_ps(dstP + k, blendAVX2(_mm_loadu_ps(mainP + k), _mm_loadu_ps(mixP + k), w0, v0));
+            _mm_storeu_ps(dstP + k + 4, blendAVX2(_mm_loadu_ps(mainP + k + 4), _mm_loadu_ps(mixP + k + 4),
+                                                  _mm256_blend_pd(w0, w1, 0xC), _mm256_blend_pd(v0, v1, 0xC)));
+            _mm_storeu_ps(dstP + k + 8, blendAVX2(_mm_loadu_ps(mainP + k + 8), _mm_loadu_ps(mixP + k + 8), w1, v1));
+        }
+    }
+
+    // Four samples of a frame per vector; with a fixed count, the loop
+    // over them unrolls
+    for (; i < frames; ++i)
+    {
+        const __m256d w = _mm256_set1_pd(mainWeightsP[i]);
+        const __m256d v = _mm256_set1_pd(mixWeightsP[i]);
+        const int k = i * channels;
+        int j = 0;
+        for (; j + 4 <= channels; j += 4)
+        {
+            _mm_storeu_ps(dstP + k + j, blendAVX2(_mm_loadu_ps(mainP + k + j), _mm_loadu_ps(mixP + k + j), w, v));
+        }
+        blendFramesScalar<0>(dstP + k + j, mainP + k + j, mixP + k + j, mainWeightsP + i, mixWeightsP + i, 1, channels - j);
+    }
+}
+
+
+// Bit mask of the characters of the 32 at <p> that aren't whitespace
+static inline unsigned int nonSpacesAVX2(const char* p)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    // '\t' to '\r': v - '\t' <= 4, unsigned
+    const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    const __m256i spaces = _mm256_or_si256(controls, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    return ~(unsigned int)_mm256_movemask_epi8(spaces);
+}
+
+
+// Bit mask of the characters of the 32 at <p> that aren't digits
+static inline unsigned int nonDigitsAVX2(const char* p)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    const __m256i digits = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(9)), shifted);
+    return ~(unsigned int)_mm256_movemask_epi8(digits);
+}
+
+
+static const char* skipSpacesAVX2(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipSpacesScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 32; p += 32)
+    {
+        const unsigned int mask = nonSpacesAVX2(p);
+        if (mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+    return skipSpacesScalar(p, endP);
+}
+
+
+static const char* skipDigitsAVX2(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipDigitsScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 32; p += 32)
+    {
+        const unsigned int mask = nonDigitsAVX2(p);
+        if (mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+    return skipDigitsScalar(p, endP);
+}
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+extern const Kernels kernelsAVX2[Kernels::NBR_LAYOUTS] =
+    KERNELS_TABLE(Kernels::LEVEL_AVX2, "avx2", AVX2);
+
+
+#endif // REMAPFRAMES_SIMD_KERNELS
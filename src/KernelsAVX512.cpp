@@ -0,0 +1,242 @@
+/** KernelsAVX512
+  *     The AVX-512 kernels (AVX512F and AVX512BW).
+  *
+  *     Only <immintrin.h> and KernelsImpl.h may be included here: the
+  *     inline functions of any other header would be compiled for
+  *     AVX-512 too, and could be picked by the linker for the other
+  *     modules.
+  */
+
+#pragma warning (4 : 4290)
+
+#include "KernelsImpl.h"
+
+#ifdef REMAPFRAMES_SIMD_KERNELS
+
+#include <immintrin.h>
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+template <int CHANNELS>
+static void copyFramesAVX512(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int count = frames * ((CHANNELS != 0) ? CHANNELS : channelsArg);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m512 a = _mm512_loadu_ps(srcP + i);
+        const __m512 b = _mm512_loadu_ps(srcP + i + 16);
+        _mm512_storeu_ps(dstP + i, a);
+        _mm512_storeu_ps(dstP + i + 16, b);
+    }
+    copyFramesScalar<1>(dstP + i, srcP + i, count - i, 1);
+}
+
+
+// Mask of the first <count> lanes of a vector; <count> must be below 16
+static inline __mmask16 firstLanes(int count)
+{
+    return (__mmask16)((1u << count) - 1);
+}
+
+
+template <int CHANNELS>
+static void reverseFramesAVX512(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1 || channels == 2 || channels == 8)
+    {
+        // Whole vectors taken from the end, their frames swapped
+        const __m512i order = (channels == 1)
+                              ? _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+                              : (channels == 2)
+                              ? _mm512_setr_epi32(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1)
+                              : _mm512_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+        const int count = frames * channels;
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m512 v = _mm512_loadu_ps(srcP + count - i - 16);
+            _mm512_storeu_ps(dstP + i, _mm512_permutexvar_ps(order, v));
+        }
+        reverseFramesScalar<CHANNELS>(dstP + i, srcP, (count - i) / channels, channels);
+        return;
+    }
+
+    // A frame at a time, the samples past the last whole vector moved
+    // under a mask
+    const float* frameP = srcP + (frames - 1) * channels;
+    for (int i = 0; i < frames; ++i, dstP += channels, frameP -= channels)
+    {
+        int j = 0;
+        for (; j + 16 <= channels; j += 16)
+        {
+            _mm512_storeu_ps(dstP + j, _mm512_loadu_ps(frameP + j));
+        }
+        if (j < channels)
+        {
+            const __mmask16 mask = firstLanes(channels - j);
+            _mm512_mask_storeu_ps(dstP + j, mask, _mm512_maskz_loadu_ps(mask, frameP + j));
+        }
+    }
+}
+
+
+// (float)(w * main + v * mix) on eight doubles
+static inline __m256 blendAVX512(__m256 main, __m256 mix, __m512d w, __m512d v)
+{
+    const __m512d mainProduct = _mm512_mul_pd(w, _mm512_cvtps_pd(main));
+    const __m512d mixProduct = _mm512_mul_pd(v, _mm512_cvtps_pd(mix));
+    return _mm512_cvtpd_ps(_mm512_add_pd(mainProduct, mixProduct));
+}
+
+
+template <int CHANNELS>
+static void blendFramesAVX512(float* dstP, const float* mainP, const float* mixP,
+                              const double* mainWeightsP, const double* mixWeightsP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1 || channels == 2)
+    {
+        // Eight samples per vector: eight frames, or four with their
+        // weights repeated
+        const __m512i pairs = _mm512_setr_epi64(0, 0, 1, 1, 2, 2, 3, 3);
+        const int framesPerVector = 8 / channels;
+        int i = 0;
+        for (; i + framesPerVector <= frames; i += framesPerVector)
+        {
+            __m512d w, v;
+            if (channels == 1)
+            {
+                w = _mm512_loadu_pd(mainWeightsP + i);
+                v = _mm512_loadu_pd(mixWeightsP + i);
+            }
+            else
+            {
+                w = _mm512_permutexvar_pd(pairs, _mm512_castpd256_pd512(_mm256_loadu_pd(mainWeightsP + i)));
+                v = _mm512_permutexvar_pd(pairs, _mm512_castpd256_pd512(_mm256_loadu_pd(mixWeightsP + i)));
+            }
+            const int k = i * channels;
+            _mm256_storeu_ps(dstP + k, blendAVX512(_mm256_loadu_ps(mainP + k), _mm256_loadu_ps(mixP + k), w, v));
+        }
+        const int k = i * channels;
+        blendFramesScalar<CHANNELS>(dstP + k, mainP + k, mixP + k, mainWeightsP + i, mixWeightsP + i, frames - i, channels);
+        return;
+    }
+
+    int i = 0;
+    if (channels == 6)
+    {
+        // Four frames per three vectors, the weights spread over their
+        // samples
+        const __m512i spread0 = _mm512_setr_epi64(0, 0, 0, 0, 0, 0, 1, 1);
+        const __m512i spread1 = _mm512_setr_epi64(1, 1, 1, 1, 2, 2, 2, 2);
+        const __m512i spread2 = _mm512_setr_epi64(2, 2, 3, 3, 3, 3, 3, 3);
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m512d w = _mm512_castpd256_pd512(_mm256_loadu_pd(mainWeightsP + i));
+            const __m512d v = _mm512_castpd256_pd512(_mm256_loadu_pd(mixWeightsP + i));
+            const int k = i * 6;
+            _mm256_storeu_ps(dstP + k, blendAVX512(_mm256_loadu_ps(mainP + k), _mm256_loadu_ps(mixP + k),
+                                                   _mm512_permutexvar_pd(spread0, w), _mm512_permutexvar_pd(spread0, v)));
+            _mm256_storeu_ps(dstP + k + 8, blendAVX512(_mm256_loadu_ps(mainP + k + 8), _mm256_loadu_ps(mixP + k + 8),
+                                                       _mm512_permutexvar_pd(spread1, w), _mm512_permutexvar_pd(spread1, v)));
+            _mm256_storeu_ps(dstP + k + 16, blendAVX512(_mm256_loadu_ps(mainP + k + 16), _mm256_loadu_ps(mixP + k + 16),
+                                                        _mm512_permutexvar_pd(spread2, w), _mm512_permutexvar_pd(spread2, v)));
+        }
+    }
+
+    // Eight samples of a frame per vector, the rest under a mask
+    for (; i < frames; ++i)
+    {
+        const __m512d w = _mm512_set1_pd(mainWeightsP[i]);
+        const __m512d v = _mm512_set1_pd(mixWeightsP[i]);
+        const int k = i * channels;
+        int j = 0;
+        for (; j + 8 <= channels; j += 8)
+        {
+            _mm256_storeu_ps(dstP + k + j, blendAVX512(_mm256_loadu_ps(mainP + k + j), _mm256_loadu_ps(mixP + k + j), w, v));
+        }
+        if (j < channels)
+        {
+            const __mmask16 mask = firstLanes(channels - j);
+            const __m256 main = _mm512_castps512_ps256(_mm512_maskz_loadu_ps(mask, mainP + k + j));
+            const __m256 mix = _mm512_castps512_ps256(_mm512_maskz_loadu_ps(mask, mixP + k + j));
+            _mm512_mask_storeu_ps(dstP + k + j, mask, _mm512_castps256_ps512(blendAVX512(main, mix, w, v)));
+        }
+    }
+}
+
+
+// Bit mask of the characters of the 64 at <p> that aren't whitespace
+static inline unsigned long long nonSpacesAVX512(const char* p)
+{
+    const __m512i v = _mm512_loadu_si512((const void*)p);
+    // '\t' to '\r': v - '\t' <= 4, unsigned
+    const __mmask64 controls = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8('\t')), _mm512_set1_epi8(4));
+    const __mmask64 spaces = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '));
+    return ~(unsigned long long)(controls | spaces);
+}
+
+
+// Bit mask of the characters of the 64 at <p> that aren't digits
+static inline unsigned long long nonDigitsAVX512(const char* p)
+{
+    const __m512i v = _mm512_loadu_si512((const void*)p);
+    const __mmask64 digits = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8('0')), _mm512_set1_epi8(9));
+    return ~(unsigned long long)digits;
+}
+
+
+static const char* skipSpacesAVX512(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipSpacesScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 64; p += 64)
+    {
+        const unsigned long long mask = nonSpacesAVX512(p);
+        if (mask != 0)
+        {
+            return p + lowestBit64(mask);
+        }
+    }
+    return skipSpacesScalar(p, endP);
+}
+
+
+static const char* skipDigitsAVX512(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipDigitsScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 64; p += 64)
+    {
+        const unsigned long long mask = nonDigitsAVX512(p);
+        if (mask != 0)
+        {
+            return p + lowestBit64(mask);
+        }
+    }
+    return skipDigitsScalar(p, endP);
+}
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+extern const Kernels kernelsAVX512[Kernels::NBR_LAYOUTS] =
+    KERNELS_TABLE(Kernels::LEVEL_AVX512, "avx512", AVX512);
+
+
+#endif // REMAPFRAMES_SIMD_KERNELS
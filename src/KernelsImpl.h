@@ -0,0 +1,159 @@
+/** KernelsImpl
+  *     Scalar loops shared by the kernel sets: the scalar set itself, and
+  *     the remainders of the SIMD loops.
+  *
+  *     Only included by the Kernels*.cpp modules. Everything here has
+  *     internal linkage, so each module keeps its own copy, compiled for
+  *     its instruction set: no function built for AVX2 may end up called
+  *     from the other sets.
+  */
+
+#ifndef KERNELSIMPL_H
+#define KERNELSIMPL_H
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "Kernels.h"
+
+
+
+// MACROS --------------------------------------------------------------
+
+// The kernel sets of one level, in the order of the tables declared in
+// Kernels.h: generic, then 1, 2, 6 and 8 channels. <SUFFIX> completes the
+// names of the functions, as in copyFrames##SUFFIX.
+#define KERNELS_SET(LEVEL, NAME, SUFFIX, CHANNELS)                          \
+    { LEVEL, NAME, CHANNELS,                                                \
+      copyFrames##SUFFIX<CHANNELS>, reverseFrames##SUFFIX<CHANNELS>,       \
+      blendFrames##SUFFIX<CHANNELS>, skipSpaces##SUFFIX, skipDigits##SUFFIX }
+
+#define KERNELS_TABLE(LEVEL, NAME, SUFFIX)                                  \
+    {                                                                       \
+        KERNELS_SET(LEVEL, NAME, SUFFIX, 0),                                \
+        KERNELS_SET(LEVEL, NAME, SUFFIX, 1),                                \
+        KERNELS_SET(LEVEL, NAME, SUFFIX, 2),                                \
+        KERNELS_SET(LEVEL, NAME, SUFFIX, 6),                                \
+        KERNELS_SET(LEVEL, NAME, SUFFIX, 8),                                \
+    }
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+// The audio kernels are templates on the number of channels: 0 for the
+// generic versions, which take it from <channelsArg>; a fixed count lets
+// the compiler unroll the loops over the samples of a frame.
+template <int CHANNELS>
+static inline void copyFramesScalar(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int count = frames * ((CHANNELS != 0) ? CHANNELS : channelsArg);
+    for (int i = 0; i < count; ++i)
+    {
+        dstP[i] = srcP[i];
+    }
+}
+
+
+template <int CHANNELS>
+static inline void reverseFramesScalar(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    const float* frameP = srcP + (frames - 1) * channels;
+    for (int i = 0; i < frames; ++i, dstP += channels, frameP -= channels)
+    {
+        for (int j = 0; j < channels; ++j)
+        {
+            dstP[j] = frameP[j];
+        }
+    }
+}
+
+
+template <int CHANNELS>
+static inline void blendFramesScalar(float* dstP, const float* mainP, const float* mixP,
+                                     const double* mainWeightsP, const double* mixWeightsP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    for (int i = 0; i < frames; ++i)
+    {
+        const double mainWeight = mainWeightsP[i];
+        const double mixWeight = mixWeightsP[i];
+        for (int j = 0; j < channels; ++j)
+        {
+            const int k = i * channels + j;
+            const double mainProduct = mainWeight * (double)mainP[k];
+            const double mixProduct = mixWeight * (double)mixP[k];
+            dstP[k] = (float)(mainProduct + mixProduct);
+        }
+    }
+}
+
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Characters the SIMD tokenizers scan one by one before their vector
+// loops: most gaps and numbers of the mappings are shorter, and a
+// vector costs more than a few predictable compares.
+enum { SHORT_RUN = 8 };
+
+
+static inline const char* skipSpacesScalar(const char* p, const char* endP)
+{
+    while (p < endP && isSpace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+static inline const char* skipDigitsScalar(const char* p, const char* endP)
+{
+    while (p < endP && isDigit(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+// Index of the lowest set bit of <mask>; must not be 0
+static inline int lowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+
+static inline int lowestBit64(unsigned long long mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#elif defined(_MSC_VER)
+    return ((unsigned int)mask != 0) ? lowestBit((unsigned int)mask) : 32 + lowestBit((unsigned int)(mask >> 32));
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+
+#endif // KERNELSIMPL_H
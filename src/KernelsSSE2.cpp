@@ -0,0 +1,193 @@
+/** KernelsSSE2
+  *     The SSE2 kernels.
+  *
+  *     Only <immintrin.h> and KernelsImpl.h may be included here: the
+  *     inline functions of any other header would be compiled for SSE2
+  *     too, and could be picked by the linker for the other modules.
+  */
+
+#pragma warning (4 : 4290)
+
+#include "KernelsImpl.h"
+
+#ifdef REMAPFRAMES_SIMD_KERNELS
+
+#include <immintrin.h>
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+template <int CHANNELS>
+static void copyFramesSSE2(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int count = frames * ((CHANNELS != 0) ? CHANNELS : channelsArg);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 a = _mm_loadu_ps(srcP + i);
+        const __m128 b = _mm_loadu_ps(srcP + i + 4);
+        _mm_storeu_ps(dstP + i, a);
+        _mm_storeu_ps(dstP + i + 4, b);
+    }
+    copyFramesScalar<1>(dstP + i, srcP + i, count - i, 1);
+}
+
+
+template <int CHANNELS>
+static void reverseFramesSSE2(float* dstP, const float* srcP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1 || channels == 2)
+    {
+        // Whole vectors taken from the end, their frames swapped
+        const int count = frames * channels;
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(srcP + count - i - 4);
+            _mm_storeu_ps(dstP + i, (channels == 1) ? _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3))
+                                                    : _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+        reverseFramesScalar<CHANNELS>(dstP + i, srcP, (count - i) / channels, channels);
+        return;
+    }
+
+    const float* frameP = srcP + (frames - 1) * channels;
+    for (int i = 0; i < frames; ++i, dstP += channels, frameP -= channels)
+    {
+        int j = 0;
+        for (; j + 4 <= channels; j += 4)
+        {
+            _mm_storeu_ps(dstP + j, _mm_loadu_ps(frameP + j));
+        }
+        if (j + 2 <= channels)
+        {
+            _mm_storel_epi64((__m128i*)(dstP + j), _mm_loadl_epi64((const __m128i*)(frameP + j)));
+            j += 2;
+        }
+        copyFramesScalar<1>(dstP + j, frameP + j, channels - j, 1);
+    }
+}
+
+
+// (float)(w * main + v * mix) on two doubles
+static inline __m128 blendSSE2(__m128d main, __m128d mix, __m128d w, __m128d v)
+{
+    return _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(w, main), _mm_mul_pd(v, mix)));
+}
+
+
+template <int CHANNELS>
+static void blendFramesSSE2(float* dstP, const float* mainP, const float* mixP,
+                            const double* mainWeightsP, const double* mixWeightsP, int frames, int channelsArg)
+{
+    const int channels = (CHANNELS != 0) ? CHANNELS : channelsArg;
+    if (channels == 1)
+    {
+        // Two frames per vector
+        int i = 0;
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 main = _mm_loadu_ps(mainP + i);
+            const __m128 mix = _mm_loadu_ps(mixP + i);
+            const __m128 lo = blendSSE2(_mm_cvtps_pd(main), _mm_cvtps_pd(mix),
+                                        _mm_loadu_pd(mainWeightsP + i), _mm_loadu_pd(mixWeightsP + i));
+            const __m128 hi = blendSSE2(_mm_cvtps_pd(_mm_movehl_ps(main, main)), _mm_cvtps_pd(_mm_movehl_ps(mix, mix)),
+                                        _mm_loadu_pd(mainWeightsP + i + 2), _mm_loadu_pd(mixWeightsP + i + 2));
+            _mm_storeu_ps(dstP + i, _mm_movelh_ps(lo, hi));
+        }
+        blendFramesScalar<1>(dstP + i, mainP + i, mixP + i, mainWeightsP + i, mixWeightsP + i, frames - i, 1);
+        return;
+    }
+
+    // Two samples of a frame per vector; with a fixed count, the loop
+    // over them unrolls
+    for (int i = 0; i < frames; ++i, dstP += channels, mainP += channels, mixP += channels)
+    {
+        const __m128d w = _mm_set1_pd(mainWeightsP[i]);
+        const __m128d v = _mm_set1_pd(mixWeightsP[i]);
+        int j = 0;
+        for (; j + 2 <= channels; j += 2)
+        {
+            const __m128 main = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(mainP + j)));
+            const __m128 mix = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(mixP + j)));
+            _mm_storel_epi64((__m128i*)(dstP + j), _mm_castps_si128(blendSSE2(_mm_cvtps_pd(main), _mm_cvtps_pd(mix), w, v)));
+        }
+        blendFramesScalar<0>(dstP + j, mainP + j, mixP + j, mainWeightsP + i, mixWeightsP + i, 1, channels - j);
+    }
+}
+
+
+// Bit mask of the characters of the 16 at <p> that aren't whitespace
+static inline unsigned int nonSpacesSSE2(const char* p)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+    // '\t' to '\r': v - '\t' <= 4, unsigned
+    const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    const __m128i spaces = _mm_or_si128(controls, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    return ~(unsigned int)_mm_movemask_epi8(spaces) & 0xFFFF;
+}
+
+
+// Bit mask of the characters of the 16 at <p> that aren't digits
+static inline unsigned int nonDigitsSSE2(const char* p)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+    const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    const __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(9)), shifted);
+    return ~(unsigned int)_mm_movemask_epi8(digits) & 0xFFFF;
+}
+
+
+static const char* skipSpacesSSE2(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipSpacesScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 16; p += 16)
+    {
+        const unsigned int mask = nonSpacesSSE2(p);
+        if (mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+    return skipSpacesScalar(p, endP);
+}
+
+
+static const char* skipDigitsSSE2(const char* p, const char* endP)
+{
+    const char* shortEndP = (endP - p > SHORT_RUN) ? p + SHORT_RUN : endP;
+    p = skipDigitsScalar(p, shortEndP);
+    if (p < shortEndP || p == endP)
+    {
+        return p;
+    }
+
+    for (; endP - p >= 16; p += 16)
+    {
+        const unsigned int mask = nonDigitsSSE2(p);
+        if (mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+    return skipDigitsScalar(p, endP);
+}
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+extern const Kernels kernelsSSE2[Kernels::NBR_LAYOUTS] =
+    KERNELS_TABLE(Kernels::LEVEL_SSE2, "sse2", SSE2);
+
+
+#endif // REMAPFRAMES_SIMD_KERNELS
@@ -0,0 +1,189 @@
+/** PerfStats
+  *     Per-instance performance counters and latency histograms.
+  */
+
+#ifdef REMAPFRAMES_STATS
+
+#include <cstdio>
+
+#include "PerfStats.h"
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const char* const counterNames[PerfStats::NBR_COUNTERS] =
+{
+    "getFrameCalls",
+    "getAudioCalls",
+    "samplesRequested",
+    "childFrameCalls",
+    "childAudioCalls",
+    "childSamples",
+    "blendWindows",
+    "reverseSpans",
+    "streamHits",
+    "streamMisses"
+};
+
+static const char* const histogramNames[PerfStats::NBR_HISTOGRAMS] =
+{
+    "getFrameMicros",
+    "getAudioMicros"
+};
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** Timer destructor
+  */
+PerfStats::Timer::~Timer()
+{
+    const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    stats.record(histogram, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+
+/** PerfStats constructor
+  */
+PerfStats::PerfStats()
+{
+    for (int i = 0; i < NBR_COUNTERS; ++i)
+    {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+    for (int h = 0; h < NBR_HISTOGRAMS; ++h)
+    {
+        for (int b = 0; b < NBR_BUCKETS; ++b)
+        {
+            buckets[h][b].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+/** record
+  *
+  *     Adds a latency to a histogram.
+  *
+  * PARAMETERS:
+  *     histogram - the histogram
+  *     micros    - the latency, in microseconds
+  */
+void PerfStats::record(Histogram histogram, int64_t micros) throw()
+{
+    int b = 0;
+    while (micros > 0 && b < NBR_BUCKETS - 1)
+    {
+        micros >>= 1;
+        ++b;
+    }
+
+    buckets[histogram][b].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/** format
+  *
+  * PARAMETERS:
+  *     IN cacheStatsP - the audio block cache counters to add;
+  *                      may be NULL
+  *
+  * RETURNS:
+  *     the counters and the non-empty histogram buckets, one per line
+  */
+std::string PerfStats::format(const AudioBlockCache::Stats* cacheStatsP) const
+{
+    std::string text;
+    char line[256];
+
+    for (int i = 0; i < NBR_COUNTERS; ++i)
+    {
+        sprintf(line, "%s: %lld\n", counterNames[i], (long long) counters[i].load(std::memory_order_relaxed));
+        text += line;
+    }
+
+    const int64_t requested = counters[SAMPLES_REQUESTED].load(std::memory_order_relaxed);
+    if (requested > 0)
+    {
+        sprintf(line, "audioAmplification: %.3f\n",
+                double (counters[CHILD_SAMPLES].load(std::memory_order_relaxed)) / requested);
+        text += line;
+    }
+
+    if (cacheStatsP != NULL)
+    {
+        sprintf(line, "audioCache: %lld hits, %lld misses, %lld evictions, %d/%d blocks\n",
+                (long long) cacheStatsP->hits, (long long) cacheStatsP->misses,
+                (long long) cacheStatsP->evictions, cacheStatsP->blocks, cacheStatsP->capacity);
+        text += line;
+    }
+
+    for (int h = 0; h < NBR_HISTOGRAMS; ++h)
+    {
+        text += histogramNames[h];
+        text += ":";
+        for (int b = 0; b < NBR_BUCKETS; ++b)
+        {
+            const int64_t n = buckets[h][b].load(std::memory_order_relaxed);
+            if (n != 0)
+            {
+                sprintf(line, " <%lld:%lld", 1LL << b, (long long) n);
+                text += line;
+            }
+        }
+        text += "\n";
+    }
+
+    return text;
+}
+
+
+/** formatJson
+  *
+  * PARAMETERS:
+  *     IN cacheStatsP - the audio block cache counters to add;
+  *                      may be NULL
+  *
+  * RETURNS:
+  *     the counters and the histograms as a JSON object, on one line;
+  *     histograms are arrays of NBR_BUCKETS counts
+  */
+std::string PerfStats::formatJson(const AudioBlockCache::Stats* cacheStatsP) const
+{
+    std::string text = "{";
+    char item[256];
+
+    for (int i = 0; i < NBR_COUNTERS; ++i)
+    {
+        sprintf(item, "%s\"%s\":%lld", (i == 0) ? "" : ",",
+                counterNames[i], (long long) counters[i].load(std::memory_order_relaxed));
+        text += item;
+    }
+
+    if (cacheStatsP != NULL)
+    {
+        sprintf(item, ",\"audioCache\":{\"hits\":%lld,\"misses\":%lld,\"evictions\":%lld,\"blocks\":%d,\"capacity\":%d}",
+                (long long) cacheStatsP->hits, (long long) cacheStatsP->misses,
+                (long long) cacheStatsP->evictions, cacheStatsP->blocks, cacheStatsP->capacity);
+        text += item;
+    }
+
+    for (int h = 0; h < NBR_HISTOGRAMS; ++h)
+    {
+        sprintf(item, ",\"%s\":[", histogramNames[h]);
+        text += item;
+        for (int b = 0; b < NBR_BUCKETS; ++b)
+        {
+            sprintf(item, "%s%lld", (b == 0) ? "" : ",", (long long) buckets[h][b].load(std::memory_order_relaxed));
+            text += item;
+        }
+        text += "]";
+    }
+
+    return text + "}";
+}
+
+
+#endif // REMAPFRAMES_STATS
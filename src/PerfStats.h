@@ -0,0 +1,107 @@
+/** PerfStats
+  *     Per-instance performance counters and latency histograms.
+  *
+  *     Only compiled in when REMAPFRAMES_STATS is defined. Otherwise the
+  *     STATS_* macros expand to nothing, so the instrumented code costs
+  *     nothing.
+  */
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#ifdef REMAPFRAMES_STATS
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <avisynth.h>
+
+#include "AudioBlockCache.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class PerfStats
+{
+public:
+    enum Counter
+    {
+        GET_FRAME_CALLS,
+        GET_AUDIO_CALLS,
+        SAMPLES_REQUESTED,
+        CHILD_FRAME_CALLS,
+        CHILD_AUDIO_CALLS,
+        CHILD_SAMPLES,      // samples fetched from the audio clips
+        BLEND_WINDOWS,      // frame boundaries blended by renderRemapped
+        REVERSE_SPANS,      // runs of samples played backwards
+        STREAM_HITS,        // requests served by the render-ahead stream
+        STREAM_MISSES,
+        NBR_COUNTERS
+    };
+
+    enum Histogram
+    {
+        GET_FRAME_LATENCY,
+        GET_AUDIO_LATENCY,
+        NBR_HISTOGRAMS
+    };
+
+    // Bucket b counts the latencies in [2^(b-1), 2^b) microseconds;
+    // bucket 0 those below 1 microsecond.
+    enum { NBR_BUCKETS = 32 };
+
+    // Records the lifetime of the object into a latency histogram.
+    class Timer
+    {
+    public:
+        Timer(PerfStats& stats_, Histogram histogram_)
+        : stats(stats_), histogram(histogram_), start(std::chrono::steady_clock::now()) { }
+        ~Timer();
+
+    private:
+        PerfStats& stats;
+        const Histogram histogram;
+        const std::chrono::steady_clock::time_point start;
+
+        Timer(const Timer&);
+        Timer& operator=(const Timer&);
+    };
+
+    PerfStats();
+
+    void add(Counter counter, int64_t n) throw()
+    {
+        counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    void record(Histogram histogram, int64_t micros) throw();
+
+    std::string format(const AudioBlockCache::Stats* cacheStatsP) const;
+    std::string formatJson(const AudioBlockCache::Stats* cacheStatsP) const;
+
+private:
+    std::atomic<int64_t> counters[NBR_COUNTERS];
+    std::atomic<int64_t> buckets[NBR_HISTOGRAMS][NBR_BUCKETS];
+
+    PerfStats(const PerfStats&);
+    PerfStats& operator=(const PerfStats&);
+};
+
+
+
+// MACROS --------------------------------------------------------------
+
+// Both expect a PerfStats named <stats> in scope.
+#define STATS_ADD(counter, n) stats.add(PerfStats::counter, (n))
+#define STATS_TIMER(histogram) PerfStats::Timer statsTimer(stats, PerfStats::histogram)
+
+#else // !REMAPFRAMES_STATS
+
+#define STATS_ADD(counter, n) ((void) 0)
+#define STATS_TIMER(histogram) ((void) 0)
+
+#endif // REMAPFRAMES_STATS
+
+
+#endif // PERFSTATS_H
@@ -35,19 +35,25 @@
 
 #define NOMINMAX
 #define NOGDI
-#define WIN32_LEAN_AND_MEAN
 
 #include <algorithm>
 
 #include <cassert>
 #include <cctype>
+#include <cstdint>
 #include <cstdio>
-
-#include <iostream>
-
-#include <fstream>
-
-#include "windows.h"
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "avs/config.h"
+#ifdef AVS_WINDOWS
+#include "avs/win.h"
+#endif
 #include "avisynth.h"
 
 #include "ScopeGuard.h"
@@ -58,6 +64,16 @@
 
 
 
+// GLOBALS -------------------------------------------------------------
+
+// Live instances by identifier, so CreateSimple can find the instance
+// behind a clip (see RemapFrames::findInstance()).
+static std::mutex instanceMutex;
+static std::unordered_map<int, const RemapFrames*> instances;
+static int lastInstanceId = 0;
+
+
+
 // CLASS DEFINITIONS ---------------------------------------------------
 
 bool RemapFrames::is_empty_string (const char *str_0)
@@ -79,9 +95,9 @@ bool RemapFrames::is_empty_string (const char *str_0)
 
 
 
-/** initSimpleMode
+/** parseSimpleMappings
   *
-  *     Initializer for RemapFramesSimple.
+  *     Reads the mappings of RemapFramesSimple.
   *
   * PARAMETERS:
   *     IN filenameP - the name of the text file containing the frame
@@ -89,15 +105,19 @@ bool RemapFrames::is_empty_string (const char *str_0)
   *                    may be NULL
   *     IN mappingsP - string containing additional frame mappings;
   *                    may be NULL
+  *     IN tol_flag  - indicates if we tolerate out-of-range indices
+  *     srcFrames    - the number of frames of the source clip
+  *     IN kernels   - the kernels scanning the mappings
+  *     OUT mapP     - receives the mappings, as a dense map
   *     IN/OUT envP  - pointer to the AviSynth scripting environment
   *
   * PRE:
   *     Either filenameP or mappingsP must be NULL, but not both.
   */
-void RemapFrames::initSimpleMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,
-                                 bool tol_flag, IScriptEnvironment* envP)
+void RemapFrames::parseSimpleMappings(const char* filenameP, const char* mappingsP, bool tol_flag, int srcFrames,
+                                      const Kernels& kernels, FrameMap* mapP, IScriptEnvironment* envP)
 {
-    audioBlendSamples = audioBlendSamplesArg;
+    mapP->initDense(srcFrames);
     if (filenameP == NULL && mappingsP == NULL)
     {
         if (tol_flag)
@@ -118,10 +138,10 @@ void RemapFrames::initSimpleMode(const char* filenameP, const char* mappingsP, c
     {
         if (mappingsP != NULL)
         {
-            RemapFramesParser parser(mappingsP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+            RemapFramesParser parser(mappingsP, mapP, srcFrames, tol_flag, kernels);
             try
             {
-                vi.num_frames = parser.parseSimple();
+                parser.parseSimple();
             }
             catch (RemapFramesParser::MalformedException&)
             {
@@ -153,10 +173,10 @@ void RemapFrames::initSimpleMode(const char* filenameP, const char* mappingsP, c
             }
             else
             {
-                RemapFramesParser parser(fileP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+                RemapFramesParser parser(fileP, mapP, srcFrames, tol_flag, kernels);
                 try
                 {
-                    vi.num_frames = parser.parseSimple();
+                    parser.parseSimple();
                 }
                 catch (RemapFramesParser::MalformedException&)
                 {
@@ -186,9 +206,25 @@ void RemapFrames::initSimpleMode(const char* filenameP, const char* mappingsP, c
 }
 
 
+/** initSimpleMode
+  *
+  *     Initializer for RemapFramesSimple.
+  *
+  * PARAMETERS:
+  *     IN/OUT simpleMapP - the mappings read by parseSimpleMappings();
+  *                           taken over (left empty)
+  */
+void RemapFrames::initSimpleMode(FrameMap* simpleMapP, const int audioBlendSamplesArg)
+{
+    audioBlendSamples = audioBlendSamplesArg;
+    std::swap(frameMap, *simpleMapP);
+    vi.num_frames = frameMap.size();
+}
+
+
 /** initReplaceSimpleMode
   *
-  *     Initializer for RemapFrames.
+  *     Initializer for ReplaceFramesSimple.
   *
   * PARAMETERS:
   *     IN filenameP - the name of the text file containing the frame
@@ -196,15 +232,21 @@ void RemapFrames::initSimpleMode(const char* filenameP, const char* mappingsP, c
   *                    may be NULL
   *     IN mappingsP - string containing additional frame mappings;
   *                    may be NULL
+  *     IN audioBlendSamplesArg - number of samples blended on each side of
+  *                    a frame boundary
+  *     IN tol_flag  - indicates if we tolerate out-of-range indices
   *     IN/OUT envP  - pointer to the AviSynth scripting environment
   *
   * PRE:
   *     At least one of filenameP or mappingsP must not be NULL.
+  *
+  *     Only the replaced ranges are stored; lookups of the other frames
+  *     are answered from the coverage table of the map.
   */
-/*
-void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappingsP,
+void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,
                                         bool tol_flag, IScriptEnvironment* envP)
 {
+    audioBlendSamples = audioBlendSamplesArg;
     if (filenameP == NULL && mappingsP == NULL)
     {
         if (tol_flag)
@@ -219,14 +261,8 @@ void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappi
 
     try
     {
-        // Initialize the values in indices.
         // Each frame by default gets mapped to itself.
-        indices.resize(vi.num_frames);
-        for (int i = 0; i < vi.num_frames; i++)
-        {
-            indices[i].clipIndex = 0;
-            indices[i].frame = i;
-        }
+        frameMap.initSparse(vi.num_frames, sourceClip->GetVideoInfo().num_frames);
 
         if (filenameP != NULL)
         {
@@ -239,7 +275,7 @@ void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappi
             }
             else
             {
-                RemapFramesParser parser(fileP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+                RemapFramesParser parser(fileP, &frameMap, sourceClip->GetVideoInfo().num_frames, tol_flag, *kernelsP);
                 try
                 {
                     parser.parseReplaceSimple();
@@ -267,7 +303,7 @@ void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappi
 
         if (mappingsP != NULL)
         {
-            RemapFramesParser parser(mappingsP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+            RemapFramesParser parser(mappingsP, &frameMap, sourceClip->GetVideoInfo().num_frames, tol_flag, *kernelsP);
             try
             {
                 parser.parseReplaceSimple();
@@ -291,13 +327,14 @@ void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappi
                                  e.val, parser.getLineNumber());
             }
         }
+
+        frameMap.freeze();
     }
     catch (std::bad_alloc&)
     {
         envP->ThrowError("ReplaceFramesSimple: insufficient memory");
     }
 }
-*/
 
 /** initAdvancedMode
   *
@@ -309,14 +346,21 @@ void RemapFrames::initReplaceSimpleMode(const char* filenameP, const char* mappi
   *                    may be NULL
   *     IN mappingsP - string containing additional frame mappings;
   *                    may be NULL
+  *     IN audioBlendSamplesArg - number of samples blended on each side of
+  *                    a frame boundary
+  *     IN tol_flag  - indicates if we tolerate out-of-range indices
   *     IN/OUT envP  - pointer to the AviSynth scripting environment
   *
   * PRE:
   *     At least one of filenameP or mappingsP must not be NULL.
-  *//*
-void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
+  *
+  *     Only the overridden frames are stored; the other ones keep their
+  *     identity mapping to the base clip.
+  */
+void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,
                                    bool tol_flag, IScriptEnvironment* envP)
 {
+    audioBlendSamples = audioBlendSamplesArg;
     if (filenameP == NULL && mappingsP == NULL)
     {
         if (tol_flag)
@@ -331,14 +375,8 @@ void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
 
     try
     {
-        // Initialize the values in indices.
         // Each frame by default gets mapped to itself.
-        indices.resize(vi.num_frames);
-        for (int i = 0; i < vi.num_frames; i++)
-        {
-            indices[i].clipIndex = 0;
-            indices[i].frame = i;
-        }
+        frameMap.initSparse(vi.num_frames, sourceClip->GetVideoInfo().num_frames);
 
         if (filenameP != NULL)
         {
@@ -351,7 +389,7 @@ void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
             }
             else
             {
-                RemapFramesParser parser(fileP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+                RemapFramesParser parser(fileP, &frameMap, sourceClip->GetVideoInfo().num_frames, tol_flag, *kernelsP);
                 try
                 {
                     parser.parse();
@@ -379,7 +417,7 @@ void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
 
         if (mappingsP != NULL)
         {
-            RemapFramesParser parser(mappingsP, &indices, sourceClip->GetVideoInfo().num_frames, tol_flag);
+            RemapFramesParser parser(mappingsP, &frameMap, sourceClip->GetVideoInfo().num_frames, tol_flag, *kernelsP);
             try
             {
                 parser.parse();
@@ -403,13 +441,92 @@ void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
                                  e.val, parser.getLineNumber());
             }
         }
+
+        frameMap.freeze();
     }
     catch (std::bad_alloc&)
     {
         envP->ThrowError("RemapFrames: insufficient memory");
     }
 }
-*/
+
+/** makeBlankFrame
+  *
+  * RETURNS:
+  *     a new black frame in format <vi>
+  */
+static PVideoFrame makeBlankFrame(const VideoInfo& vi, IScriptEnvironment* envP)
+{
+    PVideoFrame frame = envP->NewVideoFrame(vi);
+
+    if (vi.IsYUY2())
+    {
+        const int rowSize = frame->GetRowSize();
+        BYTE* rowP = frame->GetWritePtr();
+        for (int y = 0; y < frame->GetHeight(); ++y, rowP += frame->GetPitch())
+        {
+            for (int x = 0; x < rowSize; x += 2)
+            {
+                rowP[x] = 16;
+                rowP[x + 1] = 128;
+            }
+        }
+    }
+    else if (vi.IsPlanar() && (vi.IsYUV() || vi.IsYUVA()))
+    {
+        const int planes[4] = { PLANAR_Y, PLANAR_U, PLANAR_V, PLANAR_A };
+        const int nbrPlanes = vi.IsY() ? 1 : vi.IsYUVA() ? 4 : 3;
+        const int bits = vi.BitsPerComponent();
+        for (int p = 0; p < nbrPlanes; ++p)
+        {
+            const int plane = planes[p];
+            BYTE* rowP = frame->GetWritePtr(plane);
+            const int rowSize = frame->GetRowSize(plane);
+            const int height = frame->GetHeight(plane);
+            const int pitch = frame->GetPitch(plane);
+
+            // Luma at the bottom of the limited range, chroma centered,
+            // alpha transparent. Float chroma is centered on 0.
+            const int level =   (plane == PLANAR_Y) ? 16
+                              : (plane == PLANAR_A) ? 0
+                              :                       128;
+            for (int y = 0; y < height; ++y, rowP += pitch)
+            {
+                if (bits == 32)
+                {
+                    const float val = (plane == PLANAR_Y) ? 16.0f / 255 : 0.0f;
+                    std::fill((float*)rowP, (float*)(rowP + rowSize), val);
+                }
+                else if (bits > 8)
+                {
+                    std::fill((uint16_t*)rowP, (uint16_t*)(rowP + rowSize), (uint16_t)(level << (bits - 8)));
+                }
+                else
+                {
+                    memset(rowP, level, rowSize);
+                }
+            }
+        }
+    }
+    else
+    {
+        // RGB: all zero
+        const int planes[4] = { PLANAR_G, PLANAR_B, PLANAR_R, PLANAR_A };
+        const int nbrPlanes = !vi.IsPlanar() ? 1 : vi.IsPlanarRGBA() ? 4 : 3;
+        for (int p = 0; p < nbrPlanes; ++p)
+        {
+            const int plane = vi.IsPlanar() ? planes[p] : 0;
+            BYTE* rowP = frame->GetWritePtr(plane);
+            for (int y = 0; y < frame->GetHeight(plane); ++y, rowP += frame->GetPitch(plane))
+            {
+                memset(rowP, 0, frame->GetRowSize(plane));
+            }
+        }
+    }
+
+    return frame;
+}
+
 
 /** RemapFrames constructor
   *
@@ -423,314 +540,1711 @@ void RemapFrames::initAdvancedMode(const char* filenameP, const char* mappingsP,
   *                      may be NULL
   *     IN mappingsP   - string containing additional frame mappings;
   *                      may be NULL
+  *     IN audioBlendSamplesArg - number of samples blended on each side
+  *                      of a frame boundary
+  *     IN options     - optional performance parameters
+  *     IN/OUT simpleMapP - the mappings, read by parseSimpleMappings()
+  *                        (simple mode only; taken over);
+  *                      may be NULL
+  *     IN innerP      - the RemapFrames instance <child_> is the output
+  *                        of, to fuse the mappings with (simple mode
+  *                        only);
+  *                      may be NULL
+  *     IN tol_flag    - indicates if we tolerate out-of-range indices
   *     IN/OUT envP    - pointer to the AviSynth scripting environment
   */
 RemapFrames::RemapFrames(PClip child_, PClip sourceClip_, mode_t mode,
                          const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,
+                         const Options& options, FrameMap* simpleMapP, const RemapFrames* innerP,
                          bool tol_flag, IScriptEnvironment* envP)
 : GenericVideoFilter(child_),
   sourceClip(sourceClip_),
-  indices()
+  audioBlendSamples(0),
+  kernelsP(&selectKernels(options.cpuP, vi.AudioChannels(), envP)),
+  frameMap(),
+  audioMap(),
+  audioMapP(&frameMap),
+  inverseMapP(),
+  instanceId(0),
+  blankFrame(),
+  framePropsFlag(false),
+  traceP(),
+  prefetcherP(),
+  lastRequested(-1),
+  gopLength(0),
+  keyframes(),
+  warmedGopStart(-1),
+  audioPrefetchFlag(options.audioPrefetchFlag),
+  audioPoolP(),
+  blockCacheP(),
+  streamerP(),
+  streamMutex(),
+  lastAudioEnd(-1)
 {
     assert(vi.num_frames > 0);
     assert(sourceClip->GetVideoInfo().num_frames > 0);
 
+    const VideoInfo& srcVi = sourceClip->GetVideoInfo();
+    const bool srcAudioFlag = (   srcVi.HasAudio()
+                               && srcVi.SampleType() == vi.SampleType()
+                               && srcVi.AudioChannels() == vi.AudioChannels()
+                               && srcVi.audio_samples_per_second == vi.audio_samples_per_second);
+    audioClips[0] = child;
+    audioClips[1] = srcAudioFlag ? sourceClip : child;
 
     switch (mode)
     {
         case MODE_SIMPLE:
-            initSimpleMode(filenameP, mappingsP, audioBlendSamplesArg, tol_flag, envP);
+            assert(simpleMapP != NULL);
+            initSimpleMode(simpleMapP, audioBlendSamplesArg);
             break;
-/*
+
         case MODE_REPLACE_SIMPLE:
-            initReplaceSimpleMode(filenameP, mappingsP, tol_flag, envP);
+            initReplaceSimpleMode(filenameP, mappingsP, audioBlendSamplesArg, tol_flag, envP);
             break;
 
         case MODE_ADVANCED:
-            initAdvancedMode(filenameP, mappingsP, tol_flag, envP);
+            initAdvancedMode(filenameP, mappingsP, audioBlendSamplesArg, tol_flag, envP);
             break;
-            */
+
         default:
             assert(false);
     }
-}
-
 
-/** GetFrame
-  *
-  * PARAMETERS:
-  *     n           - the index of the frame to retrieve
-  *     IN/OUT envP - pointer to the AviSynth scripting environment
-  *
-  * RETURNS:
-  *     the specified video frame
-  */
-PVideoFrame __stdcall RemapFrames::GetFrame(int n, IScriptEnvironment* envP)
-{
-    const int     n_c = std::min (std::max (n, 0), int (indices.size () - 1));
-    MapIndex& element = indices [n_c];
-    return ((element.clipIndex == 0)
-            ? child
-            : sourceClip)->GetFrame(element.frame, envP);
-}
+    if (innerP != NULL)
+    {
+        assert(mode == MODE_SIMPLE);
+        fuseWith(*innerP);
+    }
 
+    initPrefetch(options.prefetchDepth, options.prefetchThreads, envP);
+    initGop(options.gopLength, options.keyframesP, envP);
+    if (frameMap.hasBlank())
+    {
+        blankFrame = makeBlankFrame(vi, envP);
+    }
 
-struct RemapFrames::remappedAudioSample {
-    long long audioSample;
-    long long realFrame;
-    bool backwards;
-};
+    initAudioCache(options.audioCacheSamples, envP);
+    initAudioThreads(options.audioThreads, options.audioStreamSamples, envP);
 
-void __stdcall RemapFrames::GetAudio(void* buf, __int64 start, __int64 count, IScriptEnvironment* env) {
-    
-    int channels = vi.AudioChannels();
+    if (options.statsFileP != NULL)
+    {
+#ifdef REMAPFRAMES_STATS
+        statsFile = options.statsFileP;
+#else
+        envP->ThrowError("RemapFrames: statsFile requires a build with REMAPFRAMES_STATS defined");
+#endif
+    }
 
-    VideoInfo videoInfo = child->GetVideoInfo();
-    long double videoFramerate = (long double)videoInfo.fps_numerator / (long double)videoInfo.fps_denominator;
-    long double audioSampleRate = videoInfo.audio_samples_per_second;
+    initTrace(options.traceFileP, envP);
+    initFrameProps(options.framePropsFlag, envP);
+    initInverseIndex(options.inverseIndexFlag, envP);
 
-    // get video frame range
-    long double seconds, frame;
-    int whichFrame,frameNext,framePrevious; 
-    bool frameRunBackwards;
-    long double frameOffset;
-    long double samplesPerFrame = audioSampleRate / videoFramerate;
-    long double invertedFrameOffset;
-    __int64 sampleToGet = 0;
-    long double actualFrameToGet;
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    do
+    {
+        lastInstanceId = (lastInstanceId == std::numeric_limits<int>::max()) ? 1 : lastInstanceId + 1;
+    } while (instances.count(lastInstanceId) != 0);
+    instanceId = lastInstanceId;
+    instances[instanceId] = this;
+}
 
-    
-    /*std::ofstream myfile;
-    myfile.open("blah.txt", std::ios::out | std::ios::app);
-    myfile <<  videoFramerate << "\n";
-    myfile << audioSampleRate << "\n";
-    myfile << audioBlendSamples << "\n";
-    myfile.close();*/
-    
-    // Audio sample related variables
-    long double framePlace;
-    long double roundedFramePlace;
-    long double distanceFromFrameBoundary;
-    long double mainSampleIntensity;
-    long double foreignSampleIntensity;
-    long double mixSamplePosition;
-    remappedAudioSample nextFrameSample, lastFrameSample, mainSample;
 
-    SFLOAT* singleSampleBuffer = new SFLOAT[vi.AudioChannels()];
-    SFLOAT* singleMixSampleBuffer = new SFLOAT[vi.AudioChannels()];
+/** RemapFrames destructor
+  */
+RemapFrames::~RemapFrames()
+{
+    if (instanceId != 0)
+    {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        instances.erase(instanceId);
+    }
 
-    __int64 absolutePlace;
-    if (vi.SampleType() == SAMPLE_FLOAT) {
-        SFLOAT* samples = (SFLOAT*)buf;
-        for (int i = 0; i < count; i++) {
-            
-            // "Straightforward" just get the sample we want
-            if (audioBlendSamples == 0) {
-
-                // Calculate correct source sample
-                absolutePlace = start + i;
-                seconds = absolutePlace / audioSampleRate;
-                frame = seconds * videoFramerate;
-                whichFrame = std::min(std::max((int)frame, 0), int(indices.size() - 1));
-                frameNext = std::min(std::max(whichFrame+1, 0), int(indices.size() - 1));
-                framePrevious = std::min(std::max(whichFrame -1, 0), int(indices.size() - 1));
-
-                // Determine if audio should run backwards.
-                frameRunBackwards = indices[frameNext].frame < indices[whichFrame].frame && indices[framePrevious].frame > indices[whichFrame].frame;
-
-                // Determine proper sample
-                frameOffset = frame - (long double)whichFrame;
-                invertedFrameOffset = 1.0 - frameOffset;
-            
-                actualFrameToGet = (frameRunBackwards ? (long double)indices[whichFrame].frame + invertedFrameOffset : (long double)indices[whichFrame].frame + frameOffset);
-                sampleToGet = std::min(vi.num_audio_samples, std::max((__int64)0, (__int64)(0.5+actualFrameToGet/videoFramerate*audioSampleRate)));
-                child->GetAudio(singleSampleBuffer, sampleToGet, 1, env);
-            
-                /*works: sampleToGet = start + (__int64)i;
-            
-                child->GetAudio(singleSampleBuffer, sampleToGet, 1, env);*/
-            
-                for (int j = 0; j < channels; j++) {
-                    samples[i * channels + j] = singleSampleBuffer[j];
-                }
+#ifdef REMAPFRAMES_STATS
+    if (!statsFile.empty())
+    {
+        FILE* fileP = fopen(statsFile.c_str(), "a");
+        if (fileP != NULL)
+        {
+            AudioBlockCache::Stats cacheStats;
+            if (blockCacheP)
+            {
+                cacheStats = blockCacheP->getStats();
             }
-            // Or do blending ...
-            else {
-                // Calculate correct source sample
-                absolutePlace = start + i;
-                
-                framePlace = ((long double)absolutePlace / samplesPerFrame);
-                roundedFramePlace = round((long double)absolutePlace / samplesPerFrame);
-                distanceFromFrameBoundary = abs( framePlace - roundedFramePlace) * samplesPerFrame;
-                
-                
-                mainSample = remapAudioSample(absolutePlace, audioSampleRate, videoFramerate);
-                
-                if (distanceFromFrameBoundary > audioBlendSamples || roundedFramePlace == 0) {
-                    // All good. No blending needed.
-                    sampleToGet = mainSample.audioSample;
-                    child->GetAudio(singleSampleBuffer, sampleToGet, 1, env);
-
-                }
-                else {
-                    mainSampleIntensity = (long double)0.5 + ((long double)0.5 *  (distanceFromFrameBoundary / (long double)audioBlendSamples)); // 0.5 because we only blend half way, the other half is blended in the other frame.
-                    foreignSampleIntensity = 1 - mainSampleIntensity;
-                    if (roundedFramePlace > framePlace) {
-                        nextFrameSample = remapAudioSample(absolutePlace + samplesPerFrame, audioSampleRate, videoFramerate);
-                        mixSamplePosition = nextFrameSample.audioSample - (nextFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
-                    }
-                    else {
-                        lastFrameSample = remapAudioSample(absolutePlace - samplesPerFrame, audioSampleRate, videoFramerate);
-                        mixSamplePosition = lastFrameSample.audioSample + (lastFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
-                    }
-                    child->GetAudio(singleSampleBuffer, mainSample.audioSample, 1, env);
+            fprintf(fileP, "%s\n", stats.formatJson(blockCacheP ? &cacheStats : NULL).c_str());
+            fclose(fileP);
+        }
+    }
+#endif
+}
 
-                    // No need to blend the same sample with itself, that's ridiculous.
-                    if(mainSample.audioSample != mixSamplePosition){
-
-                        child->GetAudio(singleMixSampleBuffer, mixSamplePosition, 1, env);
-                        /*for (int j = 0; j < channels; j++) {
-                            singleSampleBuffer[j] = mainSampleIntensity *singleSampleBuffer[j] + foreignSampleIntensity*singleMixSampleBuffer[j];
-                        }*/
-                        for (int j = 0; j < channels; j++) {
-                            singleSampleBuffer[j] = sqrt(mainSampleIntensity) *singleSampleBuffer[j] + sqrt(foreignSampleIntensity)*singleMixSampleBuffer[j];
-                        }
-                    }
-                    /*
-                    std::ofstream myfile;
-                    myfile.open("blah.txt", std::ios::out | std::ios::app);
-                    myfile << distanceFromFrameBoundary << "\n";
-                    myfile << mainSampleIntensity << "\n";
-                    myfile << foreignSampleIntensity << "\n";
-                    myfile << mainSample.realFrame << "\n";
-                    if (roundedFramePlace > framePlace) {
 
-                        myfile << "next " << nextFrameSample.realFrame << "\n";
-                        myfile << "next is backwards " << nextFrameSample.backwards << "\n";
-                        myfile << "here " << mainSample.audioSample << " next " << nextFrameSample.audioSample << " mixsampleposition " <<  mixSamplePosition << "\n";
-                    }
-                    else {
+/** isFusable
+  *
+  *     Fusing skips our GetFrame(), so it is only done when no per-frame
+  *     feature depends on it.
+  *
+  * RETURNS:
+  *     true if an outer filter may fetch our frames from our clips
+  *     directly (see fuseWith())
+  */
+bool RemapFrames::isFusable() const
+{
+#ifdef REMAPFRAMES_STATS
+    if (!statsFile.empty())
+    {
+        return false;
+    }
+#endif
+    return (   !framePropsFlag
+            && !traceP
+            && !prefetcherP
+            && gopLength == 0
+            && keyframes.empty());
+}
 
-                        myfile << "last " << lastFrameSample.realFrame << "\n";
-                        myfile << "last is backwards " << lastFrameSample.backwards << "\n";
-                        myfile << "here " << mainSample.audioSample << " last " << nextFrameSample.audioSample << " mixsampleposition " << mixSamplePosition << "\n";
-                    }
-                    myfile << "\n\n";
-                    myfile.close();*/
-                }
 
-                /*works: sampleToGet = start + (__int64)i;
+/** fuseWith
+  *
+  *     Composes the mappings with those of <inner>, the instance the base
+  *     clip is the output of, so the video frames are fetched from the
+  *     clips of <inner> directly, without going through it.
+  *
+  *     The audio is still read from the base clip with the unfused
+  *     mappings: the per-sample remapping (direction detection, rounding
+  *     and blending at the frame boundaries) does not compose exactly.
+  *
+  * PARAMETERS:
+  *     IN inner - the RemapFrames instance behind the base clip
+  */
+void RemapFrames::fuseWith(const RemapFrames& inner)
+{
+    assert(!frameMap.isSparse());
 
-                child->GetAudio(singleSampleBuffer, sampleToGet, 1, env);*/
+    FrameMap fused;
+    fused.initDense(std::max(inner.child->GetVideoInfo().num_frames,
+                             inner.sourceClip->GetVideoInfo().num_frames));
+    for (int n = 0; n < frameMap.size(); ++n)
+    {
+        const MapIndex element = frameMap.lookup(n);
+        fused.append(  (element.clipIndex == MapIndex::BLANK_CLIP)
+                     ? element
+                     : inner.lookupFrame(element.frame));
+    }
 
-                for (int j = 0; j < channels; j++) {
-                    samples[i * channels + j] = singleSampleBuffer[j];
-                }
-            }
-        }
+    if (vi.HasAudio())
+    {
+        std::swap(audioMap, frameMap);
+        audioMapP = &audioMap;
     }
+    std::swap(frameMap, fused);
+
+    child = inner.child;
+    sourceClip = inner.sourceClip;
 }
 
 
-inline RemapFrames::remappedAudioSample RemapFrames::remapAudioSample(long long originalAudioSample, long double audioSampleRate, long double videoFramerate) {
-    
-    long double seconds, frame;
-    int whichFrame, frameNext, framePrevious;
-    bool frameRunBackwards;
-    long double frameOffset;
-    long double samplesPerFrame = audioSampleRate / videoFramerate;
-    long double invertedFrameOffset;
-    __int64 sampleToGet = 0;
-    long double actualFrameToGet;
+/** getModuleKey
+  *
+  * RETURNS:
+  *     a key identifying this copy of the plug-in, so the instances of
+  *     another copy (with another registry) are not mistaken for ours
+  */
+int RemapFrames::getModuleKey()
+{
+    return int (reinterpret_cast<uintptr_t>(&instances) >> 4) | 1;
+}
 
-    seconds = originalAudioSample / audioSampleRate;
-    frame = seconds * videoFramerate;
-    whichFrame = std::min(std::max((int)frame, 0), int(indices.size() - 1));
-    frameNext = std::min(std::max(whichFrame + 1, 0), int(indices.size() - 1));
-    framePrevious = std::min(std::max(whichFrame - 1, 0), int(indices.size() - 1));
 
-    // Determine if audio should run backwards.
-    frameRunBackwards = indices[frameNext].frame < indices[whichFrame].frame&& indices[framePrevious].frame > indices[whichFrame].frame;
+/** findInstance
+  *
+  *     Finds the RemapFrames instance behind a clip. The query goes
+  *     through SetCacheHints, which the AviSynth+ cache forwards to the
+  *     filter it wraps.
+  *
+  * PARAMETERS:
+  *     IN clip - the clip; must be held by the caller while the returned
+  *                 instance is used
+  *
+  * RETURNS:
+  *     the instance, or NULL if <clip> is not the output of one
+  */
+const RemapFrames* RemapFrames::findInstance(const PClip& clip)
+{
+    const int id = clip->SetCacheHints(CACHE_GET_REMAPFRAMES_ID, getModuleKey());
+    if (id <= 0)
+    {
+        return NULL;
+    }
 
-    // Determine proper sample
-    frameOffset = frame - (long double)whichFrame;
-    invertedFrameOffset = 1.0 - frameOffset;
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    std::unordered_map<int, const RemapFrames*>::const_iterator it = instances.find(id);
 
-    actualFrameToGet = (frameRunBackwards ? (long double)indices[whichFrame].frame + invertedFrameOffset : (long double)indices[whichFrame].frame + frameOffset);
-    sampleToGet = std::min(vi.num_audio_samples, std::max((__int64)0, (__int64)(0.5 + actualFrameToGet / videoFramerate * audioSampleRate)));
-    remappedAudioSample returnValue;
-    returnValue.audioSample = sampleToGet;
-    returnValue.backwards = frameRunBackwards;
-    returnValue.realFrame = whichFrame;
-    return returnValue;
+    return (it != instances.end()) ? it->second : NULL;
 }
 
-/** GetParity
+
+/** findOutput
+  *
+  *     Same as findInstance(), for the script query functions.
   *
   * PARAMETERS:
-  *     n - the index of the frame
+  *     IN clip      - the queried clip
+  *     IN functionP - the name of the script function, for the error
+  *                      message
+  *     IN/OUT envP  - pointer to the AviSynth scripting environment
   *
   * RETURNS:
-  *     the parity of the specified video frame
+  *     the instance
+  *
+  * THROWS:
+  *     AvisynthError - <clip> is not the output of RemapFrames
   */
-bool __stdcall RemapFrames::GetParity(int n)
+const RemapFrames& RemapFrames::findOutput(const PClip& clip, const char* functionP, IScriptEnvironment* envP)
 {
-    const int     n_c = std::min (std::max (n, 0), int (indices.size () - 1));
-    MapIndex& element = indices [n_c];
-    return ((element.clipIndex == 0)
-            ? child
-            : sourceClip)->GetParity(element.frame);
+    const RemapFrames* filterP = findInstance(clip);
+    if (filterP == NULL)
+    {
+        envP->ThrowError("%s: the clip is not the output of RemapFrames", functionP);
+    }
+    return *filterP;
 }
 
 
-/** Create
-  *
-  *     Creates a new instance of this filter.
+/** isThreadSafe
   *
-  *     Callback passed to the scripting environment.
-  *
-  * PARAMETERS:
-  *     args             - the array of arguments passed to this filter
-  *                          from the script;
-  *                        see filter documentation for details
-  *     IN/OUT userDataP - (unused)
-  *     IN/OUT envP      - pointer to the AviSynth scripting environment
+  *     Our background threads call the input clips with the environment
+  *     of the thread that created them, since there is no way to get one
+  *     of their own through IScriptEnvironment. This is only safe for
+  *     filters that can be called concurrently (MT_NICE_FILTER). Only
+  *     the clips we call directly are checked.
   *
   * RETURNS:
-  *     the new video clip
+  *     true if <clip> declares itself MT_NICE_FILTER
   */
-/*
-AVSValue __cdecl RemapFrames::Create(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+static bool isThreadSafe(const PClip& clip)
 {
-    const int       i_f = (userDataP == 0) ? 1 : 2;
-    const int       i_m = (userDataP == 0) ? 2 : 1;
-
-    //const PClip& clip = args[0].AsClip();
-    AVSValue CA_args[3] = { args[0], SAMPLE_FLOAT, SAMPLE_FLOAT };
-    const PClip& clip = envP->Invoke("ConvertAudio", AVSValue(CA_args, 3)).AsClip();
+    return clip->SetCacheHints(CACHE_GET_MTMODE, 0) == MT_NICE_FILTER;
+}
 
-    const char* filenameP = args[i_f].Defined () ? args[i_f].AsString() : 0;
-    const char* mappingsP = args[i_m].Defined () ? args[i_m].AsString() : 0;
-    const PClip& sourceClip = args[3].Defined()
-                              ? args[3].AsClip()
-                              : clip;
 
+/** initAudioCache
+  *
+  *     Creates the rendered audio block cache, if enabled.
+  *
+  * PARAMETERS:
+  *     nbrSamples  - the cache size, in samples; rounded up to whole
+  *                     blocks; 0 disables the cache
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initAudioCache(int nbrSamples, IScriptEnvironment* envP)
+{
+    const int blockSamples = 4096;
 
-    if (   clip->GetVideoInfo().num_frames == 0
-        || sourceClip->GetVideoInfo().num_frames == 0
-        || (userDataP != 0 && is_empty_string (filenameP) && is_empty_string (mappingsP)))
+    if (nbrSamples < 0)
     {
-        // nothing to do; return the base clip unaltered
-        return (args [0]);
+        envP->ThrowError("RemapFrames: audioCache must be >= 0");
     }
 
-    return (AVSValue (new RemapFrames (
-        clip, sourceClip, MODE_ADVANCED, filenameP, mappingsP, (userDataP != 0), envP
-    )));
-}*/
+    if (nbrSamples > 0 && vi.HasAudio() && vi.SampleType() == SAMPLE_FLOAT)
+    {
+        const int nbrBlocks = int ((nbrSamples + (int64_t)blockSamples - 1) / blockSamples);
+        blockCacheP.reset(new AudioBlockCache(vi.AudioChannels(), blockSamples, nbrBlocks));
+    }
+}
 
 
-AVSValue __cdecl RemapFrames::CreateSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+/** initAudioThreads
+  *
+  *     Starts the audio rendering pool and the audio streamer, if
+  *     enabled and the audio clips are thread-safe (see isThreadSafe());
+  *     otherwise the audio is rendered on demand in the calling thread.
+  *
+  * PARAMETERS:
+  *     nbrThreads    - number of threads rendering audio; 1 renders in
+  *                       the calling thread only
+  *     streamSamples - size of the audio streamer ring, in samples; 0
+  *                       disables the streamer
+  *     IN/OUT envP   - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initAudioThreads(int nbrThreads, int streamSamples, IScriptEnvironment* envP)
+{
+    if (nbrThreads < 1)
+    {
+        envP->ThrowError("RemapFrames: audioThreads must be > 0");
+    }
+    if (streamSamples < 0)
+    {
+        envP->ThrowError("RemapFrames: audioStream must be >= 0");
+    }
+
+    const bool threadFlag = (   vi.HasAudio() && vi.SampleType() == SAMPLE_FLOAT
+                             && isThreadSafe(audioClips[0]) && isThreadSafe(audioClips[1]));
+
+    try
+    {
+        if (threadFlag && nbrThreads > 1)
+        {
+            audioPoolP.reset(new WorkerPool(nbrThreads));
+        }
+        if (threadFlag && streamSamples > 0)
+        {
+            streamerP.reset(new AudioStreamer(
+                vi.AudioChannels(), streamSamples, vi.num_audio_samples,
+                [this](SFLOAT* dst, int64_t start, int64_t count, IScriptEnvironment* env) {
+                    renderRequest(dst, start, count, env);
+                }));
+        }
+    }
+    catch (std::bad_alloc&)
+    {
+        envP->ThrowError("RemapFrames: insufficient memory");
+    }
+    catch (std::exception&)
+    {
+        envP->ThrowError("RemapFrames: cannot start the audio threads");
+    }
+}
+
+
+/** initPrefetch
+  *
+  *     Starts the prefetching threads, if enabled and the input clips
+  *     are thread-safe (see isThreadSafe()); otherwise the frames are
+  *     fetched on demand in the calling thread.
+  *
+  * PARAMETERS:
+  *     depth       - number of source frames fetched ahead; 0 disables
+  *                     the prefetching
+  *     nbrThreads  - number of prefetching threads
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initPrefetch(int depth, int nbrThreads, IScriptEnvironment* envP)
+{
+    if (depth < 0)
+    {
+        envP->ThrowError("RemapFrames: prefetch must be >= 0");
+    }
+    if (nbrThreads < 1)
+    {
+        envP->ThrowError("RemapFrames: prefetchThreads must be > 0");
+    }
+
+    if (depth > 0 && isThreadSafe(child) && isThreadSafe(sourceClip))
+    {
+        const PClip clips[2] = { child, sourceClip };
+        try
+        {
+            prefetcherP.reset(new FramePrefetcher(clips, depth, nbrThreads));
+        }
+        catch (std::exception&)
+        {
+            envP->ThrowError("RemapFrames: cannot start the prefetching threads");
+        }
+    }
+}
+
+
+/** initGop
+  *
+  *     Sets up the seek smoothing, if enabled. It applies to the source
+  *     clip, and to the base clip when it is the same clip.
+  *
+  * PARAMETERS:
+  *     gopLength_   - fixed GOP length of the source; 0 if unknown
+  *     IN keyframesP - list of the keyframes of the source, separated by
+  *                      spaces or commas; may be NULL. Takes precedence
+  *                      over <gopLength_>.
+  *     IN/OUT envP  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initGop(int gopLength_, const char* keyframesP, IScriptEnvironment* envP)
+{
+    if (gopLength_ < 0)
+    {
+        envP->ThrowError("RemapFrames: gop must be >= 0");
+    }
+    gopLength = gopLength_;
+
+    if (keyframesP != NULL)
+    {
+        const char* curP = keyframesP;
+        for (;;)
+        {
+            while (isspace(*curP) || *curP == ',')
+            {
+                ++curP;
+            }
+            if (*curP == '\0')
+            {
+                break;
+            }
+
+            char* endP;
+            const long frame = strtol(curP, &endP, 10);
+            if (endP == curP || frame < 0 || frame > std::numeric_limits<int>::max())
+            {
+                envP->ThrowError("RemapFrames: parse error in <keyframes> string "
+                                 "(column %u)", unsigned (curP - keyframesP + 1));
+            }
+            keyframes.push_back(int (frame));
+            curP = endP;
+        }
+
+        std::sort(keyframes.begin(), keyframes.end());
+        keyframes.erase(std::unique(keyframes.begin(), keyframes.end()), keyframes.end());
+    }
+
+    gopClipFlags[0] = (child.operator->() == sourceClip.operator->());
+    gopClipFlags[1] = true;
+}
+
+
+/** initTrace
+  *
+  *     Starts recording the access trace, if enabled. The header
+  *     describes the output clip and the clips read, so the trace can be
+  *     replayed on mock clips of the same formats.
+  *
+  * PARAMETERS:
+  *     IN filenameP - the name of the trace file; NULL disables the trace
+  *     IN/OUT envP  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initTrace(const char* filenameP, IScriptEnvironment* envP)
+{
+    if (filenameP == NULL)
+    {
+        return;
+    }
+
+    TraceRecorder::ClipInfo clips[TraceRecorder::NBR_CLIPS];
+    clips[TraceRecorder::OUTPUT_CLIP] = TraceRecorder::describe(vi);
+    clips[TraceRecorder::BASE_CLIP] = TraceRecorder::describe(child->GetVideoInfo());
+    clips[TraceRecorder::SOURCE_CLIP] = TraceRecorder::describe(sourceClip->GetVideoInfo());
+
+    const int flags = (child.operator->() == sourceClip.operator->()) ? TraceRecorder::SOURCE_IS_BASE : 0;
+    traceP.reset(TraceRecorder::create(filenameP, clips, flags));
+    if (!traceP)
+    {
+        envP->ThrowError("RemapFrames: cannot create the trace file \"%s\"", filenameP);
+    }
+}
+
+
+/** initFrameProps
+  *
+  *     Enables the source frame properties, if asked for. They need the
+  *     frame property functions of the version 8 interface (AviSynth+
+  *     3.6 and later).
+  *
+  * PARAMETERS:
+  *     flag        - the frameProps parameter
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initFrameProps(bool flag, IScriptEnvironment* envP)
+{
+    if (!flag)
+    {
+        return;
+    }
+
+    try
+    {
+        envP->CheckVersion(8);
+    }
+    catch (const AvisynthError&)
+    {
+        envP->ThrowError("RemapFrames: frameProps requires AviSynth+ 3.6 or later");
+    }
+    framePropsFlag = true;
+}
+
+
+/** initInverseIndex
+  *
+  *     Builds the inverse of the (fused) frame map, if asked for.
+  *
+  * PARAMETERS:
+  *     flag        - the inverseIndex parameter
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::initInverseIndex(bool flag, IScriptEnvironment* envP)
+{
+    if (!flag)
+    {
+        return;
+    }
+
+    try
+    {
+        inverseMapP.reset(new InverseFrameMap(frameMap, child.operator->() == sourceClip.operator->()));
+    }
+    catch (const std::bad_alloc&)
+    {
+        envP->ThrowError("RemapFrames: insufficient memory");
+    }
+}
+
+
+/** reportedClipIndex
+  *
+  *     The clip index of a source frame, as reported to the scripts:
+  *     when the base and source clips are the same clip (no sourceClip,
+  *     or RemapFramesSimple), the frames left in place and the remapped
+  *     ones are all reported as taken from clip 1.
+  *
+  * PARAMETERS:
+  *     IN element - the source frame
+  *
+  * RETURNS:
+  *     0 for the base clip, 1 for the source clip, -1 for a blank frame
+  */
+int RemapFrames::reportedClipIndex(const MapIndex& element) const
+{
+    if (element.clipIndex == MapIndex::BLANK_CLIP)
+    {
+        return -1;
+    }
+    return (child.operator->() == sourceClip.operator->()) ? 1 : element.clipIndex;
+}
+
+
+/** lookupFrame
+  *
+  * PARAMETERS:
+  *     n - the index of an output frame; clipped to the clip bounds
+  *
+  * RETURNS:
+  *     the clip and frame output frame <n> is taken from
+  */
+MapIndex RemapFrames::lookupFrame(int n) const
+{
+    const int     n_c = std::min (std::max (n, 0), frameMap.size () - 1);
+    return (frameMap.lookup (n_c));
+}
+
+
+/** lookupAudioFrame
+  *
+  *     Same as lookupFrame(), for the audio remapping.
+  */
+MapIndex RemapFrames::lookupAudioFrame(int n) const
+{
+    const int     n_c = std::min (std::max (n, 0), audioMapP->size () - 1);
+    return (audioMapP->lookup (n_c));
+}
+
+
+/** GetFrame
+  *
+  * PARAMETERS:
+  *     n           - the index of the frame to retrieve
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     the specified video frame
+  */
+PVideoFrame __stdcall RemapFrames::GetFrame(int n, IScriptEnvironment* envP)
+{
+    STATS_TIMER(GET_FRAME_LATENCY);
+    STATS_ADD(GET_FRAME_CALLS, 1);
+    if (traceP)
+    {
+        traceP->record(TraceRecorder::GET_FRAME, -1, n, 0);
+    }
+
+    const MapIndex element = lookupFrame (n);
+    if (element.clipIndex == MapIndex::BLANK_CLIP)
+    {
+        return framePropsFlag ? setSourceProps(blankFrame, element, envP) : blankFrame;
+    }
+
+    smoothSeek(element, envP);
+
+    STATS_ADD(CHILD_FRAME_CALLS, 1);
+    if (traceP)
+    {
+        traceP->record(TraceRecorder::CHILD_FRAME, element.clipIndex, element.frame, 0);
+    }
+    const PVideoFrame frame = prefetcherP
+                              ? getPrefetched(n, element, envP)
+                              : ((element.clipIndex == 0)
+                                 ? child
+                                 : sourceClip)->GetFrame(element.frame, envP);
+
+    return framePropsFlag ? setSourceProps(frame, element, envP) : frame;
+}
+
+
+/** setSourceProps
+  *
+  *     Tags an output frame with where it was taken from:
+  *         _RemapSourceFrame - the frame number in its clip
+  *         _RemapSourceClip  - 0 for the base clip, 1 for the source
+  *                               clip (see reportedClipIndex())
+  *     Both are -1 for the blank frames. When the mappings were fused
+  *     with those of an inner RemapFramesSimple (see fuseWith()), the
+  *     clips are those of the inner filter.
+  *
+  *     The input frames may be shared (by the caches, or between output
+  *     frames), so the properties are written to a new frame over the
+  *     same pixels, as MakePropertyWritable() does in later versions of
+  *     the interface. Only called when framePropsFlag is set, which
+  *     guarantees the version 8 interface.
+  *
+  * PARAMETERS:
+  *     IN frame    - the frame to tag
+  *     IN element  - the source of <frame>
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     a copy of the frame header, with the properties of <frame> and the
+  *       two above
+  */
+PVideoFrame RemapFrames::setSourceProps(const PVideoFrame& frame, const MapIndex& element, IScriptEnvironment* envP) const
+{
+    PVideoFrame tagged;
+    if (frame->GetPitch(PLANAR_A) != 0)
+    {
+        tagged = envP->SubframePlanarA(frame, 0, frame->GetPitch(), frame->GetRowSize(), frame->GetHeight(),
+                                       0, 0, frame->GetPitch(PLANAR_U), 0);
+    }
+    else if (frame->GetPitch(PLANAR_U) != 0)
+    {
+        tagged = envP->SubframePlanar(frame, 0, frame->GetPitch(), frame->GetRowSize(), frame->GetHeight(),
+                                      0, 0, frame->GetPitch(PLANAR_U));
+    }
+    else
+    {
+        tagged = envP->Subframe(frame, 0, frame->GetPitch(), frame->GetRowSize(), frame->GetHeight());
+    }
+
+    const bool blankFlag = (element.clipIndex == MapIndex::BLANK_CLIP);
+    AVSMap* const propsP = envP->getFramePropsRW(tagged);
+    envP->propSetInt(propsP, "_RemapSourceFrame", blankFlag ? -1 : element.frame, PROPAPPENDMODE_REPLACE);
+    envP->propSetInt(propsP, "_RemapSourceClip", reportedClipIndex(element), PROPAPPENDMODE_REPLACE);
+
+    return tagged;
+}
+
+
+/** getPrefetched
+  *
+  *     GetFrame with prefetching: schedules the source frames of the
+  *     following output frames before retrieving frame <n>. The pending
+  *     fetches are cancelled when the access is not sequential (not within
+  *     the look-ahead window following the previous request).
+  *
+  * PARAMETERS:
+  *     n           - the index of the frame to retrieve
+  *     IN element  - the source frame of <n>
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     the specified video frame
+  */
+PVideoFrame RemapFrames::getPrefetched(int n, const MapIndex& element, IScriptEnvironment* envP)
+{
+    const int depth = prefetcherP->getDepth();
+    const int prev = lastRequested.exchange(n);
+    if (n <= prev || n > prev + depth)
+    {
+        prefetcherP->cancel();
+    }
+
+    const int last = std::min(n + depth, frameMap.size() - 1);
+    std::vector<MapIndex> window;
+    window.reserve(depth + 1);
+    window.push_back(element);
+    for (int k = n + 1; k <= last; ++k)
+    {
+        const MapIndex next = lookupFrame(k);
+        if (next.clipIndex != MapIndex::BLANK_CLIP)
+        {
+            window.push_back(next);
+        }
+    }
+    prefetcherP->schedule(window, envP);
+
+    return prefetcherP->get(element, envP);
+}
+
+
+/** findGopStart
+  *
+  * RETURNS:
+  *     the keyframe starting the GOP of source frame <frame>
+  */
+int RemapFrames::findGopStart(int frame) const
+{
+    if (!keyframes.empty())
+    {
+        std::vector<int>::const_iterator it =
+            std::upper_bound(keyframes.begin(), keyframes.end(), frame);
+        return (it == keyframes.begin()) ? 0 : *(it - 1);
+    }
+
+    return frame - frame % gopLength;
+}
+
+
+/** smoothSeek
+  *
+  *     Handles the jumps of the mapping on long-GOP sources. The first
+  *     time a source frame is requested in a GOP other than the last one
+  *     warmed, the frames from the start of its GOP are requested first
+  *     in ascending order. The decoder then decodes the GOP once
+  *     sequentially and the upstream cache holds the frames that a
+  *     reversed or out-of-order mapping, or the prefetching threads,
+  *     would otherwise each get with a new seek. The other frames of the
+  *     GOP, before or after, are then requested as is.
+  *
+  *     The GOP is claimed with an atomic exchange, so concurrent requests
+  *     in the same GOP warm it once.
+  *
+  * PARAMETERS:
+  *     IN element  - the source frame about to be retrieved
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::smoothSeek(const MapIndex& element, IScriptEnvironment* envP)
+{
+    if (   (gopLength == 0 && keyframes.empty())
+        || !gopClipFlags[element.clipIndex])
+    {
+        return;
+    }
+
+    const int frame = element.frame;
+    const int gopStart = findGopStart(frame);
+    if (warmedGopStart.exchange(gopStart) == gopStart)
+    {
+        // Already warmed, or being warmed by another thread
+        return;
+    }
+
+    const PClip& clip = (element.clipIndex == 0) ? child : sourceClip;
+    for (int f = gopStart; f < frame; ++f)
+    {
+        STATS_ADD(CHILD_FRAME_CALLS, 1);
+        if (traceP)
+        {
+            traceP->record(TraceRecorder::CHILD_FRAME, element.clipIndex, f, 0);
+        }
+        clip->GetFrame(f, envP);
+    }
+}
+
+
+struct RemapFrames::remappedAudioSample {
+    long long audioSample;
+    long long realFrame;
+    bool backwards;
+    int clipIndex;
+};
+
+
+/** frameOfSample
+  *
+  * RETURNS:
+  *     the position of output audio sample <sample> on the output frame
+  *     axis
+  */
+long double RemapFrames::frameOfSample(int64_t sample) const
+{
+    const long double videoFramerate = (long double)vi.fps_numerator / (long double)vi.fps_denominator;
+    const long double audioSampleRate = vi.audio_samples_per_second;
+    const long double seconds = sample / audioSampleRate;
+    return seconds * videoFramerate;
+}
+
+
+/** firstSampleOfFrame
+  *
+  * RETURNS:
+  *     the first output audio sample belonging to output frame <n>,
+  *     consistently with frameOfSample()
+  */
+int64_t RemapFrames::firstSampleOfFrame(int n) const
+{
+    const long double samplesPerFrame =
+        (long double)vi.audio_samples_per_second * vi.fps_denominator / vi.fps_numerator;
+    int64_t sample = (int64_t)ceil(n * samplesPerFrame);
+    while (sample > 0 && (int)frameOfSample(sample - 1) >= n)
+    {
+        --sample;
+    }
+    while ((int)frameOfSample(sample) < n)
+    {
+        ++sample;
+    }
+    return sample;
+}
+
+
+/** findAudioSpan
+  *
+  *     Finds how far the output audio starting at <pos> can be rendered
+  *     the same way.
+  *
+  *     Inside a region of output frames mapped to the same frame numbers
+  *     of one clip, output samples are the clip samples and can be
+  *     fetched in one call. The first and last frames of such a region
+  *     (plus the blending window) still go through the per-sample
+  *     remapping, since their direction and blending depend on the
+  *     neighbouring frames, as do the blending windows of the other
+  *     frames when a frame doesn't last a whole number of samples. The
+  *     same holds for regions of blank frames, which read silence.
+  *
+  * PARAMETERS:
+  *     pos            - the first output sample of the span
+  *     OUT clipIndexP - on output, the clip to read the span from as is,
+  *                        or -1 if the span must be remapped
+  *
+  * RETURNS:
+  *     the end of the span (exclusive); always greater than <pos>
+  */
+int64_t RemapFrames::findAudioSpan(int64_t pos, int* clipIndexP) const
+{
+    const int64_t infinite = std::numeric_limits<int64_t>::max();
+
+    *clipIndexP = -1;
+
+    const int lastFrame = audioMapP->size() - 1;
+    if (lastFrame < 0)
+    {
+        return infinite;
+    }
+    const int n = std::min(std::max((int)frameOfSample(pos), 0), lastFrame);
+
+    int clipIndex, first, last;
+    if (audioMapP->findIdentity(n, &clipIndex, &first, &last))
+    {
+        const int64_t margin = audioBlendSamples + 1;
+        int64_t lo = (first == 0) ? 0 : firstSampleOfFrame(first + 1) + margin;
+        // The last frame of the clip has no next frame, but its end is
+        // still blended per sample.
+        int64_t hi = (last == lastFrame) ? firstSampleOfFrame(last + 1) - margin : firstSampleOfFrame(last) - margin;
+
+        // With a fractional number of samples per frame, the blending
+        // also mixes neighbouring samples around the frame boundaries
+        // inside the region; only the middle of each frame is copied.
+        const long double samplesPerFrame = (long double)vi.audio_samples_per_second
+                                            / ((long double)vi.fps_numerator / (long double)vi.fps_denominator);
+        if (audioBlendSamples > 0 && samplesPerFrame != std::floor(samplesPerFrame))
+        {
+            lo = std::max(lo, (n == 0) ? 0 : firstSampleOfFrame(n) + margin);
+            hi = std::min(hi, firstSampleOfFrame(n + 1) - margin);
+        }
+
+        if (pos >= lo && pos < hi)
+        {
+            *clipIndexP = clipIndex;
+            return hi;
+        }
+        if (pos < lo)
+        {
+            return std::min(lo, firstSampleOfFrame(n + 1));
+        }
+    }
+
+    return (n == lastFrame) ? infinite : firstSampleOfFrame(n + 1);
+}
+
+
+void __stdcall RemapFrames::GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    if (vi.SampleType() != SAMPLE_FLOAT) {
+        return;
+    }
+
+    STATS_TIMER(GET_AUDIO_LATENCY);
+    STATS_ADD(GET_AUDIO_CALLS, 1);
+    STATS_ADD(SAMPLES_REQUESTED, count);
+    if (traceP) {
+        traceP->record(TraceRecorder::GET_AUDIO, -1, start, count);
+    }
+
+    SFLOAT* samples = (SFLOAT*)buf;
+    const bool sequentialFlag = (start == lastAudioEnd.exchange(start + count));
+
+    std::unique_lock<std::mutex> streamLock(streamMutex, std::defer_lock);
+    if (streamerP && streamLock.try_lock()) {
+        if (streamerP->read(samples, start, count)) {
+            STATS_ADD(STREAM_HITS, 1);
+        }
+        else {
+            STATS_ADD(STREAM_MISSES, 1);
+
+            // Not the continuation of the stream: renders the request
+            // alone, and streams what follows it if the access looks
+            // sequential.
+            streamerP->stop();
+            renderRequest(samples, start, count, env);
+            if (sequentialFlag && start >= 0) {
+                streamerP->restart(start + count, env);
+            }
+        }
+    }
+    else {
+        renderRequest(samples, start, count, env);
+    }
+
+    if (audioPrefetchFlag) {
+        // Assumes the next request follows this one, with the same size.
+        prefetchAudio(start + count, count);
+    }
+}
+
+
+/** renderRequest
+  *
+  *     Computes output samples through the block cache, if enabled.
+  *
+  *     Cached blocks are copied; each run of missing blocks is rendered
+  *     whole, in one call so large requests keep their parallelism, and
+  *     stored. Requests reaching out of the clip bypass the cache.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample
+  *     count       - the number of samples
+  *     IN/OUT env  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::renderRequest(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    const int64_t end = start + count;
+    if (!blockCacheP || start < 0 || end > vi.num_audio_samples) {
+        renderUncached(samples, start, count, env);
+        return;
+    }
+
+    const int channels = vi.AudioChannels();
+    const int64_t blockSamples = blockCacheP->getBlockSamples();
+    const int64_t lastBlock = (end - 1) / blockSamples;
+
+    std::vector<SFLOAT> runSamples;
+    for (int64_t block = start / blockSamples; block <= lastBlock; ) {
+        const int64_t blockStart = block * blockSamples;
+        const int64_t segStart = std::max(start, blockStart);
+        const int64_t segEnd = std::min(end, blockStart + blockSamples);
+        if (blockCacheP->fetch(block, samples + (segStart - start) * channels,
+                               int(segStart - blockStart), int(segEnd - segStart))) {
+            ++block;
+            continue;
+        }
+
+        int64_t lastMissing = block;
+        while (lastMissing < lastBlock && !blockCacheP->contains(lastMissing + 1)) {
+            ++lastMissing;
+        }
+
+        const int64_t runEnd = std::min((lastMissing + 1) * blockSamples, vi.num_audio_samples);
+        runSamples.resize(size_t(runEnd - blockStart) * channels);
+        renderUncached(&runSamples[0], blockStart, runEnd - blockStart, env);
+
+        for (int64_t b = block; b <= lastMissing; ++b) {
+            const int64_t offset = (b - block) * blockSamples;
+            blockCacheP->store(b, &runSamples[size_t(offset) * channels],
+                               int(std::min(blockSamples, runEnd - blockStart - offset)));
+        }
+
+        const int64_t copyEnd = std::min(end, runEnd);
+        memcpy(samples + (segStart - start) * channels,
+               &runSamples[size_t(segStart - blockStart) * channels],
+               size_t(copyEnd - segStart) * channels * sizeof(SFLOAT));
+
+        block = lastMissing + 1;
+    }
+}
+
+
+/** renderUncached
+  *
+  *     Computes output samples, on the audio pool if enabled.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample
+  *     count       - the number of samples
+  *     IN/OUT env  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::renderUncached(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    if (audioPoolP && start >= 0) {
+        renderParallel(samples, start, count, env);
+    }
+    else {
+        renderAudio(samples, start, count, env);
+    }
+}
+
+
+/** renderAudio
+  *
+  *     Computes output samples, span by span.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample
+  *     count       - the number of samples
+  *     IN/OUT env  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::renderAudio(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    const int channels = vi.AudioChannels();
+
+    const int64_t end = start + count;
+    int64_t pos = start;
+    while (pos < end) {
+        int clipIndex;
+        const int64_t spanEnd = std::min(findAudioSpan(pos, &clipIndex), end);
+        SFLOAT* dstP = samples + (pos - start) * channels;
+        if (clipIndex >= 0) {
+            // Identity region: straight copy of the clip audio
+            readAudio(clipIndex, dstP, pos, spanEnd - pos, env);
+        }
+        else {
+            renderRemapped(dstP, pos, spanEnd - pos, env);
+        }
+        pos = spanEnd;
+    }
+}
+
+
+/** renderParallel
+  *
+  *     Splits a large request at output frame boundaries into segments
+  *     rendered concurrently on the audio pool, each one directly into its
+  *     own slice of <samples>. Small requests are rendered in place. The
+  *     pool threads use <env>, which is why the pool only runs over
+  *     thread-safe clips.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample; must be >= 0
+  *     count       - the number of samples
+  *     IN/OUT env  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::renderParallel(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    // Below this, the split overhead outweighs the gain.
+    const int64_t minSegmentSamples = 1 << 14;
+
+    const int64_t nbrSegments = std::min((int64_t)audioPoolP->getNbrThreads() * 4, count / minSegmentSamples);
+    if (nbrSegments < 2) {
+        renderAudio(samples, start, count, env);
+        return;
+    }
+
+    const int64_t end = start + count;
+    std::vector<int64_t> bounds;
+    bounds.reserve((size_t)nbrSegments + 1);
+    bounds.push_back(start);
+    for (int64_t i = 1; i < nbrSegments; ++i) {
+        const int64_t target = start + count * i / nbrSegments;
+        const int64_t bound = firstSampleOfFrame((int)frameOfSample(target));
+        if (bound > bounds.back() && bound < end) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(end);
+
+    const int channels = vi.AudioChannels();
+    audioPoolP->run(int(bounds.size() - 1), [&](int i) {
+        renderAudio(samples + (bounds[i] - start) * channels, bounds[i], bounds[i + 1] - bounds[i], env);
+    });
+}
+
+
+/** readAudio
+  *
+  *     GetAudio on an audio clip. Blank frames read silence.
+  */
+void RemapFrames::readAudio(int clipIndex, void* buf, int64_t start, int64_t count, IScriptEnvironment* env) {
+
+    if (clipIndex == MapIndex::BLANK_CLIP) {
+        memset(buf, 0, size_t(count) * vi.AudioChannels() * sizeof(SFLOAT));
+        return;
+    }
+
+    STATS_ADD(CHILD_AUDIO_CALLS, 1);
+    STATS_ADD(CHILD_SAMPLES, count);
+    if (traceP) {
+        traceP->record(TraceRecorder::CHILD_AUDIO, clipIndex, start, count);
+    }
+    audioClips[clipIndex]->GetAudio(buf, start, count, env);
+}
+
+
+// Source audio needed by a range of output samples
+struct SourceSpan
+{
+    int clipIndex;
+    int64_t start;
+    int64_t end;    // exclusive
+};
+
+
+// Adds a source range to <spans>, extending the last one when they are
+// contiguous or overlapping.
+static void addSourceSpan(std::vector<SourceSpan>& spans, int clipIndex, int64_t start, int64_t end)
+{
+    if (clipIndex == MapIndex::BLANK_CLIP)
+    {
+        // Silence, nothing to read
+        return;
+    }
+
+    if (   !spans.empty()
+        && spans.back().clipIndex == clipIndex
+        && start <= spans.back().end
+        && end >= spans.back().start)
+    {
+        spans.back().start = std::min(spans.back().start, start);
+        spans.back().end = std::max(spans.back().end, end);
+        return;
+    }
+
+    SourceSpan span = { clipIndex, start, end };
+    spans.push_back(span);
+}
+
+
+/** prefetchAudio
+  *
+  *     Predicts from the mapping the source audio needed by output samples
+  *     [start, start + count) and submits it to the caches of the audio
+  *     clips as prefetch requests (CACHE_PREFETCH_AUDIO_* protocol).
+  *     Upstream caches supporting it can then fill it ahead of demand;
+  *     the others ignore these hints.
+  *
+  * PARAMETERS:
+  *     start - the first output sample
+  *     count - the number of samples
+  */
+void RemapFrames::prefetchAudio(int64_t start, int64_t count) const
+{
+    // Bounds the work spent on heavily fragmented mappings.
+    const size_t maxSpans = 64;
+
+    const int64_t end = std::min(start + count, vi.num_audio_samples);
+    if (start >= end) {
+        return;
+    }
+
+    const int lastFrame = audioMapP->size() - 1;
+    const int64_t margin = audioBlendSamples + 1;
+
+    std::vector<SourceSpan> spans;
+    int64_t pos = start;
+    while (pos < end && spans.size() < maxSpans) {
+        int clipIndex;
+        const int64_t spanEnd = std::min(findAudioSpan(pos, &clipIndex), end);
+        if (clipIndex >= 0) {
+            addSourceSpan(spans, clipIndex, pos, spanEnd);
+        }
+        else {
+            const int first = std::min(std::max((int)frameOfSample(pos), 0), lastFrame);
+            const int last = std::min(std::max((int)frameOfSample(spanEnd - 1), 0), lastFrame);
+            for (int n = first; n <= last && spans.size() < maxSpans; ++n) {
+                const MapIndex element = lookupAudioFrame(n);
+                addSourceSpan(spans, element.clipIndex,
+                              std::max(firstSampleOfFrame(element.frame) - margin, (int64_t)0),
+                              firstSampleOfFrame(element.frame + 1) + margin);
+            }
+        }
+        pos = spanEnd;
+    }
+
+    bool usedFlags[2] = { false, false };
+    for (std::vector<SourceSpan>::const_iterator it = spans.begin(); it != spans.end(); ++it) {
+        const PClip& clip = audioClips[it->clipIndex];
+        const int64_t spanCount = std::min(it->end - it->start, (int64_t)std::numeric_limits<int>::max());
+        clip->SetCacheHints(CACHE_PREFETCH_AUDIO_BEGIN, 0);
+        clip->SetCacheHints(CACHE_PREFETCH_AUDIO_STARTLO, (int)(it->start & 0xFFFFFFFF));
+        clip->SetCacheHints(CACHE_PREFETCH_AUDIO_STARTHI, (int)(it->start >> 32));
+        clip->SetCacheHints(CACHE_PREFETCH_AUDIO_COUNT, (int)spanCount);
+        clip->SetCacheHints(CACHE_PREFETCH_AUDIO_COMMIT, 0);
+        usedFlags[it->clipIndex] = true;
+    }
+
+    // Both indices may refer to the same clip; starts it only once.
+    const IClip* startedP = NULL;
+    for (int i = 0; i < 2; ++i) {
+        if (usedFlags[i] && audioClips[i].operator->() != startedP) {
+            audioClips[i]->SetCacheHints(CACHE_PREFETCH_AUDIO_GO, 0);
+            startedP = audioClips[i].operator->();
+        }
+    }
+}
+
+
+/** gatherAudio
+  *
+  *     Reads single input samples scattered over the audio clips: each
+  *     run of samples close to each other in one clip is read in one
+  *     call, and copied out by stretches of consecutive positions, either
+  *     way.
+  *
+  * PARAMETERS:
+  *     OUT samples     - receives <count> interleaved float samples;
+  *                       left untouched where <clipIndices> is negative
+  *     IN clipIndices  - the clip of each sample (MapIndex::clipIndex);
+  *                       negative for no sample
+  *     IN positions    - the position of each sample in its clip
+  *     count           - the number of samples
+  *     IN/OUT windowP  - scratch buffer for the samples read; owned by the
+  *                       caller, as the reads may re-enter this filter
+  *                       through a stacked instance
+  *     IN/OUT env      - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::gatherAudio(SFLOAT* samples, const int* clipIndices, const int64_t* positions, int count,
+                              std::vector<SFLOAT>* windowP, IScriptEnvironment* env) {
+
+    // Bounds the span of a read
+    const int64_t maxWindowSamples = 1 << 13;
+
+    const int channels = vi.AudioChannels();
+
+    std::vector<SFLOAT>& window = *windowP;
+
+    int i = 0;
+    while (i < count) {
+        const int clipIndex = clipIndices[i];
+        if (clipIndex < 0) {
+            ++i;
+            continue;
+        }
+
+        int64_t lo = positions[i];
+        int64_t hi = positions[i];
+        int end = i + 1;
+        while (end < count && clipIndices[end] == clipIndex) {
+            const int64_t newLo = std::min(lo, positions[end]);
+            const int64_t newHi = std::max(hi, positions[end]);
+            if (newHi - newLo >= maxWindowSamples) {
+                break;
+            }
+            lo = newLo;
+            hi = newHi;
+            ++end;
+        }
+
+        window.resize(size_t(hi - lo + 1) * channels);
+        readAudio(clipIndex, &window[0], lo, hi - lo + 1, env);
+
+        for (int j = i; j < end; ) {
+            int k = j + 1;
+            if (k < end && positions[k] == positions[j] - 1) {
+                // Played backwards
+                while (k < end && positions[k] == positions[k - 1] - 1) {
+                    ++k;
+                }
+                kernelsP->reverseFrames(samples + size_t(j) * channels,
+                                        &window[size_t(positions[k - 1] - lo) * channels], k - j, channels);
+            }
+            else {
+                while (k < end && positions[k] == positions[k - 1] + 1) {
+                    ++k;
+                }
+                kernelsP->copyFrames(samples + size_t(j) * channels,
+                                     &window[size_t(positions[j] - lo) * channels], k - j, channels);
+            }
+            j = k;
+        }
+
+        i = end;
+    }
+}
+
+
+// Per-sample plan of renderRemapped(): where each output sample is read,
+// and what it is blended with
+struct RemapPlan
+{
+    std::vector<int> mainClips;
+    std::vector<int64_t> mainPositions;
+    std::vector<int> mixClips;          // -1 where not blended
+    std::vector<int64_t> mixPositions;
+    std::vector<double> mainWeights;
+    std::vector<double> mixWeights;
+    std::vector<SFLOAT> mixSamples;
+    std::vector<SFLOAT> window;         // see gatherAudio()
+
+    void resize(size_t count, int channels)
+    {
+        mainClips.resize(count);
+        mainPositions.resize(count);
+        mixClips.resize(count);
+        mixPositions.resize(count);
+        mainWeights.resize(count);
+        mixWeights.resize(count);
+        mixSamples.resize(count * channels);
+    }
+};
+
+
+/** renderRemapped
+  *
+  *     Computes output samples from the mapping, by chunks: the input
+  *     sample of each output sample, and the one it is blended with, are
+  *     found one by one, then read in runs and blended.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample
+  *     count       - the number of samples
+  *     IN/OUT env  - pointer to the AviSynth scripting environment
+  */
+void RemapFrames::renderRemapped(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env) {
+    
+    const int chunkSamples = 4096;
+
+    int channels = vi.AudioChannels();
+    assert(kernelsP->channels == 0 || kernelsP->channels == channels);
+
+    long double videoFramerate = (long double)vi.fps_numerator / (long double)vi.fps_denominator;
+    long double audioSampleRate = vi.audio_samples_per_second;
+
+    long double samplesPerFrame = audioSampleRate / videoFramerate;
+
+    // Audio sample related variables
+    long double framePlace;
+    long double roundedFramePlace;
+    long double distanceFromFrameBoundary;
+    long double mainSampleIntensity;
+    long double foreignSampleIntensity;
+    long double mixSamplePosition;
+    int mixClipIndex;
+    remappedAudioSample nextFrameSample, lastFrameSample, mainSample;
+
+    // Scratch of this call only: reading the input clips may re-enter
+    // renderRemapped(), on this thread, through a stacked instance
+    RemapPlan plan;
+    plan.resize((size_t)std::min(count, (int64_t)chunkSamples), channels);
+
+#ifdef REMAPFRAMES_STATS
+    // last samples blended and played backwards, to count their runs
+    int64_t lastBlended = start - 2;
+    int64_t lastBackwards = start - 2;
+#endif
+
+    for (int64_t chunkStart = 0; chunkStart < count; chunkStart += chunkSamples) {
+
+        const int chunkCount = (int)std::min(count - chunkStart, (int64_t)chunkSamples);
+        bool blendFlag = false;
+
+        int64_t absolutePlace;
+        for (int i = 0; i < chunkCount; i++) {
+
+            absolutePlace = start + chunkStart + i;
+            mainSample = remapAudioSample(absolutePlace, audioSampleRate, videoFramerate);
+
+#ifdef REMAPFRAMES_STATS
+            if (mainSample.backwards) {
+                if (lastBackwards != absolutePlace - 1) {
+                    STATS_ADD(REVERSE_SPANS, 1);
+                }
+                lastBackwards = absolutePlace;
+            }
+#endif
+
+            // "Straightforward" just get the sample we want
+            plan.mainClips[i] = mainSample.clipIndex;
+            plan.mainPositions[i] = mainSample.audioSample;
+            plan.mixClips[i] = -1;
+
+            // Or do blending ...
+            if (audioBlendSamples != 0) {
+                framePlace = ((long double)absolutePlace / samplesPerFrame);
+                roundedFramePlace = std::round((long double)absolutePlace / samplesPerFrame);
+                distanceFromFrameBoundary = std::abs(framePlace - roundedFramePlace) * samplesPerFrame;
+
+                // Otherwise, all good. No blending needed.
+                if (distanceFromFrameBoundary <= audioBlendSamples && roundedFramePlace != 0) {
+#ifdef REMAPFRAMES_STATS
+                    if (lastBlended != absolutePlace - 1) {
+                        STATS_ADD(BLEND_WINDOWS, 1);
+                    }
+                    lastBlended = absolutePlace;
+#endif
+                    mainSampleIntensity = (long double)0.5 + ((long double)0.5 *  (distanceFromFrameBoundary / (long double)audioBlendSamples)); // 0.5 because we only blend half way, the other half is blended in the other frame.
+                    foreignSampleIntensity = 1 - mainSampleIntensity;
+                    if (roundedFramePlace > framePlace) {
+                        nextFrameSample = remapAudioSample(absolutePlace + samplesPerFrame, audioSampleRate, videoFramerate);
+                        mixSamplePosition = nextFrameSample.audioSample - (nextFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
+                        mixClipIndex = nextFrameSample.clipIndex;
+                    }
+                    else {
+                        lastFrameSample = remapAudioSample(absolutePlace - samplesPerFrame, audioSampleRate, videoFramerate);
+                        mixSamplePosition = lastFrameSample.audioSample + (lastFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
+                        mixClipIndex = lastFrameSample.clipIndex;
+                    }
+
+                    // No need to blend the same sample with itself, that's ridiculous.
+                    if(mainSample.audioSample != mixSamplePosition || mainSample.clipIndex != mixClipIndex){
+                        plan.mixClips[i] = mixClipIndex;
+                        plan.mixPositions[i] = (int64_t)mixSamplePosition;
+                        // The weights are rounded to double, as the
+                        // blend is computed (see Kernels::blendFrames)
+                        plan.mainWeights[i] = std::sqrt((double)mainSampleIntensity);
+                        plan.mixWeights[i] = std::sqrt((double)foreignSampleIntensity);
+                        blendFlag = true;
+                    }
+                }
+            }
+        }
+
+        SFLOAT* chunkP = samples + chunkStart * channels;
+        gatherAudio(chunkP, &plan.mainClips[0], &plan.mainPositions[0], chunkCount, &plan.window, env);
+        if (!blendFlag) {
+            continue;
+        }
+
+        gatherAudio(&plan.mixSamples[0], &plan.mixClips[0], &plan.mixPositions[0], chunkCount, &plan.window, env);
+        for (int i = 0; i < chunkCount; ) {
+            if (plan.mixClips[i] < 0) {
+                ++i;
+                continue;
+            }
+            int end = i + 1;
+            while (end < chunkCount && plan.mixClips[end] >= 0) {
+                ++end;
+            }
+            SFLOAT* dstP = chunkP + size_t(i) * channels;
+            kernelsP->blendFrames(dstP, dstP, &plan.mixSamples[size_t(i) * channels],
+                                  &plan.mainWeights[i], &plan.mixWeights[i], end - i, channels);
+            i = end;
+        }
+    }
+}
+
+
+inline RemapFrames::remappedAudioSample RemapFrames::remapAudioSample(long long originalAudioSample, long double audioSampleRate, long double videoFramerate) {
+    
+    long double seconds, frame;
+    int whichFrame;
+    bool frameRunBackwards;
+    long double frameOffset;
+    long double invertedFrameOffset;
+    int64_t sampleToGet = 0;
+    long double actualFrameToGet;
+
+    seconds = originalAudioSample / audioSampleRate;
+    frame = seconds * videoFramerate;
+    whichFrame = std::min(std::max((int)frame, 0), audioMapP->size() - 1);
+    const MapIndex current = lookupAudioFrame(whichFrame);
+    const MapIndex next = lookupAudioFrame(whichFrame + 1);
+    const MapIndex previous = lookupAudioFrame(whichFrame - 1);
+
+    // Determine if audio should run backwards. The blank frames (numbered
+    // 0) are not part of a run.
+    frameRunBackwards =    next.clipIndex != MapIndex::BLANK_CLIP
+                        && previous.clipIndex != MapIndex::BLANK_CLIP
+                        && next.frame < current.frame && previous.frame > current.frame;
+
+    // Determine proper sample
+    frameOffset = frame - (long double)whichFrame;
+    invertedFrameOffset = 1.0 - frameOffset;
+
+    actualFrameToGet = (frameRunBackwards ? (long double)current.frame + invertedFrameOffset : (long double)current.frame + frameOffset);
+    sampleToGet = std::min(vi.num_audio_samples, std::max((int64_t)0, (int64_t)(0.5 + actualFrameToGet / videoFramerate * audioSampleRate)));
+    remappedAudioSample returnValue;
+    returnValue.audioSample = sampleToGet;
+    returnValue.backwards = frameRunBackwards;
+    returnValue.realFrame = whichFrame;
+    returnValue.clipIndex = current.clipIndex;
+    return returnValue;
+}
+
+/** GetParity
+  *
+  * PARAMETERS:
+  *     n - the index of the frame
+  *
+  * RETURNS:
+  *     the parity of the specified video frame
+  */
+bool __stdcall RemapFrames::GetParity(int n)
+{
+    const MapIndex element = lookupFrame (n);
+    return ((element.clipIndex == 0)
+            ? child
+            : sourceClip)->GetParity(element.frame);
+}
+
+
+/** SetCacheHints
+  *
+  *     Answers the AviSynth+ cache and MT queries.
+  *
+  *     GetFrame and GetParity are lookups in a map that is read-only after
+  *     construction and GetAudio only uses per-thread scratch buffers, so
+  *     a single instance can be called from several threads at once.
+  *
+  * PARAMETERS:
+  *     cachehints  - the query
+  *     frame_range - (unused)
+  *
+  * RETURNS:
+  *     the answer to the query, or 0 if not handled
+  */
+int __stdcall RemapFrames::SetCacheHints(int cachehints, int frame_range)
+{
+    switch (cachehints)
+    {
+        case CACHE_GET_MTMODE:
+            return MT_NICE_FILTER;
+
+        case CACHE_GETCHILD_COST:
+            return CACHE_COST_ZERO;
+
+        case CACHE_GETCHILD_ACCESS_COST:
+            return CACHE_ACCESS_RAND;
+
+        case CACHE_GET_REMAPFRAMES_ID:
+            return (frame_range == getModuleKey()) ? instanceId : 0;
+
+        default:
+            return 0;
+    }
+}
+
+
+/** convertAudio
+  *
+  * RETURNS:
+  *     <clip> with its audio converted to float samples, which is the
+  *     only sample type the audio remapping works on
+  */
+PClip RemapFrames::convertAudio(const AVSValue& clip, IScriptEnvironment* envP)
+{
+    if (!clip.AsClip()->GetVideoInfo().HasAudio())
+    {
+        return clip.AsClip();
+    }
+
+    AVSValue CA_args[3] = { clip, SAMPLE_FLOAT, SAMPLE_FLOAT };
+    return envP->Invoke("ConvertAudio", AVSValue(CA_args, 3)).AsClip();
+}
+
+
+/** readOptions
+  *
+  * PARAMETERS:
+  *     args  - the array of arguments passed to the filter
+  *     first - the index of the first parameter of OPTIONS_SIGNATURE
+  *
+  * RETURNS:
+  *     the optional performance parameters, with their default values
+  *       when not given
+  */
+RemapFrames::Options RemapFrames::readOptions(const AVSValue& args, int first)
+{
+    Options options;
+    options.prefetchDepth = args[first].AsInt(0);
+    options.prefetchThreads = args[first + 1].AsInt(1);
+    options.gopLength = args[first + 2].AsInt(0);
+    options.keyframesP = args[first + 3].Defined() ? args[first + 3].AsString() : NULL;
+    options.audioPrefetchFlag = args[first + 4].AsBool(true);
+    options.audioThreads = args[first + 5].AsInt(1);
+    options.audioStreamSamples = args[first + 6].AsInt(0);
+    options.audioCacheSamples = args[first + 7].AsInt(0);
+    options.statsFileP = args[first + 8].Defined() ? args[first + 8].AsString() : NULL;
+    options.traceFileP = args[first + 9].Defined() ? args[first + 9].AsString() : NULL;
+    options.cpuP = args[first + 10].Defined() ? args[first + 10].AsString() : NULL;
+    options.framePropsFlag = args[first + 11].AsBool(false);
+    options.inverseIndexFlag = args[first + 12].AsBool(false);
+
+    return options;
+}
+
+
+/** selectKernels
+  *
+  *     Picks the kernels for the processor, as given by the CPU flags of
+  *     the environment, or as forced by the cpu parameter; their audio
+  *     loops are the ones specialized for <channels>, if any.
+  *
+  * PARAMETERS:
+  *     IN cpuP     - the cpu parameter: "auto", "scalar", "sse2", "avx2"
+  *                     or "avx512";
+  *                   may be NULL (same as "auto")
+  *     channels    - the number of audio channels of the clip
+  *     IN/OUT envP - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     the kernels to use
+  */
+const Kernels& RemapFrames::selectKernels(const char* cpuP, int channels, IScriptEnvironment* envP)
+{
+    const Kernels::level_t bestLevel = Kernels::bestLevel(envP->GetCPUFlags());
+    if (cpuP == NULL || _stricmp(cpuP, "auto") == 0)
+    {
+        return Kernels::get(bestLevel, channels);
+    }
+
+    Kernels::level_t level;
+    if (!Kernels::parseLevel(cpuP, &level))
+    {
+        envP->ThrowError("RemapFrames: cpu must be \"auto\", \"scalar\", \"sse2\", \"avx2\" or \"avx512\"");
+    }
+    if (level > bestLevel)
+    {
+        envP->ThrowError("RemapFrames: cpu=\"%s\" is not supported by this processor", cpuP);
+    }
+
+    return Kernels::get(level, channels);
+}
+
+
+/** Create
+  *
+  *     Creates a new instance of this filter.
+  *
+  *     Callback passed to the scripting environment.
+  *
+  * PARAMETERS:
+  *     args             - the array of arguments passed to this filter
+  *                          from the script;
+  *                        see filter documentation for details
+  *     IN/OUT userDataP - (unused)
+  *     IN/OUT envP      - pointer to the AviSynth scripting environment
+  *
+  * RETURNS:
+  *     the new video clip
+  */
+AVSValue __cdecl RemapFrames::Create(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const int       i_f = (userDataP == 0) ? 1 : 2;
+    const int       i_m = (userDataP == 0) ? 2 : 1;
+
+    const PClip clip = convertAudio(args[0], envP);
+
+    const char* filenameP = args[i_f].Defined () ? args[i_f].AsString() : 0;
+    const char* mappingsP = args[i_m].Defined () ? args[i_m].AsString() : 0;
+    const int audioBlendSamplesArg = args[4].Defined () ? args[4].AsInt() : 0;
+    const Options options = readOptions(args, 5);
+
+    const PClip sourceClip = args[3].Defined()
+                             ? convertAudio(args[3], envP)
+                             : clip;
+
+    if (   clip->GetVideoInfo().num_frames == 0
+        || sourceClip->GetVideoInfo().num_frames == 0
+        || (userDataP != 0 && is_empty_string (filenameP) && is_empty_string (mappingsP)))
+    {
+        // nothing to do; return the base clip unaltered
+        return (args [0]);
+    }
+
+    return (AVSValue (new RemapFrames (
+        clip, sourceClip, MODE_ADVANCED, filenameP, mappingsP, audioBlendSamplesArg,
+        options, NULL, NULL, (userDataP != 0), envP
+    )));
+}
+
+
+AVSValue __cdecl RemapFrames::CreateSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP)
 {
     const int       i_f = (userDataP == 0) ? 1 : 2;
     const int       i_m = (userDataP == 0) ? 2 : 1;
@@ -743,14 +2257,7 @@ AVSValue __cdecl RemapFrames::CreateSimple(AVSValue args, void* userDataP, IScri
     const char* filenameP = args[i_f].Defined () ? args[i_f].AsString() : 0;
     const char* mappingsP = args[i_m].Defined () ? args[i_m].AsString() : 0;
     const int audioBlendSamplesArg = args[3].Defined () ? args[3].AsInt() : 0;
-
-
-
-    /*std::ofstream myfile;
-    myfile.open("blah.txt", std::ios::out | std::ios::app);
-    myfile << args[3].Defined() << "\n";
-    myfile << audioBlendSamplesArg << "\n";
-    myfile.close();*/
+    const Options options = readOptions(args, 4);
 
     if (   clip->GetVideoInfo().num_frames == 0
         || (userDataP != 0 && is_empty_string (filenameP) && is_empty_string (mappingsP)))
@@ -759,20 +2266,56 @@ AVSValue __cdecl RemapFrames::CreateSimple(AVSValue args, void* userDataP, IScri
         return (args [0]);
     }
 
+    FrameMap simpleMap;
+    parseSimpleMappings(filenameP, mappingsP, (userDataP != 0), clip->GetVideoInfo().num_frames,
+                        selectKernels(options.cpuP, clip->GetVideoInfo().AudioChannels(), envP), &simpleMap, envP);
+
+    // Mappings taking consecutive frames in order are a plain copy or cut,
+    // unless the frames must be tagged with their source or the result
+    // queried. Their audio is converted like that of the other mappings,
+    // so the output format doesn't depend on the mappings.
+    int clipIndex;
+    int first;
+    if (   !options.framePropsFlag
+        && !options.inverseIndexFlag
+        && simpleMap.findContiguous(&clipIndex, &first))
+    {
+        if (first == 0 && simpleMap.size() == clip->GetVideoInfo().num_frames)
+        {
+            return (clip);
+        }
+
+        // A negative end is a frame count
+        AVSValue trimArgs[3] = { clip, first, -simpleMap.size() };
+        return (envP->Invoke("Trim", AVSValue(trimArgs, 3)));
+    }
+
+    // Stacked remaps are fused into a single index over the innermost
+    // clips, unless the inner filter has per-frame features. The audio
+    // conversion above leaves the video untouched.
+    const PClip inputClip = args[0].AsClip();
+    const RemapFrames* innerP = findInstance(inputClip);
+    if (innerP != NULL && !innerP->isFusable())
+    {
+        innerP = NULL;
+    }
+
     return (AVSValue (new RemapFrames (
-        clip, clip, MODE_SIMPLE, filenameP, mappingsP, audioBlendSamplesArg, (userDataP != 0), envP
+        clip, clip, MODE_SIMPLE, NULL, NULL, audioBlendSamplesArg,
+        options, &simpleMap, innerP, (userDataP != 0), envP
     )));
 }
 
-/*
 AVSValue __cdecl RemapFrames::CreateReplaceSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP)
 {
     const int       i_f = (userDataP == 0) ? 2 : 3;
     const int       i_m = (userDataP == 0) ? 3 : 2;
-    const PClip& clip = args[0].AsClip();
-    const PClip& sourceClip = args[1].AsClip();
+    const PClip clip = convertAudio(args[0], envP);
+    const PClip sourceClip = convertAudio(args[1], envP);
     const char* filenameP = args[i_f].Defined () ? args[i_f].AsString() : 0;
     const char* mappingsP = args[i_m].Defined () ? args[i_m].AsString() : 0;
+    const int audioBlendSamplesArg = args[4].Defined () ? args[4].AsInt() : 0;
+    const Options options = readOptions(args, 5);
 
     if (   clip->GetVideoInfo().num_frames == 0
         || sourceClip->GetVideoInfo().num_frames == 0
@@ -783,7 +2326,8 @@ AVSValue __cdecl RemapFrames::CreateReplaceSimple(AVSValue args, void* userDataP
     }
 
     return (AVSValue (new RemapFrames (
-        clip, sourceClip, MODE_REPLACE_SIMPLE, filenameP, mappingsP, (userDataP != 0), envP
+        clip, sourceClip, MODE_REPLACE_SIMPLE, filenameP, mappingsP, audioBlendSamplesArg,
+        options, NULL, NULL, (userDataP != 0), envP
     )));
 }
 
@@ -808,8 +2352,8 @@ AVSValue __cdecl RemapFrames::CreateTransform (AVSValue args, void* userDataP, I
         envP->ThrowError ("rfs_transform: parse error in <op> string.");
     }
 
-    std::vector <MapIndex> indices;
-    RemapFramesParser parser(range_list_0, &indices, 999, true);
+    FrameMap        frameMap;
+    RemapFramesParser parser(range_list_0, &frameMap, 999, true, Kernels::get(Kernels::bestLevel(envP->GetCPUFlags()), 0));
 
     std::string     result;
     try
@@ -840,34 +2384,195 @@ AVSValue __cdecl RemapFrames::CreateTransform (AVSValue args, void* userDataP, I
 
 
 
+/** CreateMerge
+  *
+  *     rfs_merge: merges several range lists into one, in canonical form.
+  *
+  *     The ranges of all the strings are gathered, sorted and coalesced,
+  *     so chains of rfs_merge calls don't grow with the history of the
+  *     script and downstream parsing only sees distinct ranges.
+  */
 AVSValue __cdecl RemapFrames::CreateMerge (AVSValue args, void* userDataP, IScriptEnvironment* envP)
 {
     bool            def_flag = false;
-    std::string     result;
     const int       nbr_str = args.ArraySize ();
 
-    for (int str_cnt = 0; str_cnt < nbr_str; ++str_cnt)
+    std::vector <RemapFramesParser::range_t>   range_list;
+    FrameMap        frameMap;
+
+    try
     {
-        if (args [str_cnt].Defined ())
+        for (int str_cnt = 0; str_cnt < nbr_str; ++str_cnt)
         {
-            if (def_flag)
+            if (args [str_cnt].Defined ())
             {
-                result += " ";
+                RemapFramesParser parser (args [str_cnt].AsString (), &frameMap, 0, true,
+                                          Kernels::get(Kernels::bestLevel(envP->GetCPUFlags()), 0));
+                try
+                {
+                    parser.parseRangeList (range_list);
+                }
+                catch (RemapFramesParser::MalformedException&)
+                {
+                    envP->ThrowError("rfs_merge: parse error in <s%d> string "
+                                     "(line offset %u, column %u)",
+                                     str_cnt, parser.getLineNumber(), parser.getColumn());
+                }
+                catch (RemapFramesParser::OverflowException&)
+                {
+                    envP->ThrowError("rfs_merge: integer overflow in <s%d> string "
+                                     "(line offset %u, column %u)",
+                                     str_cnt, parser.getLineNumber(), parser.getColumn());
+                }
+                catch (RemapFramesParser::BadValueException& e)
+                {
+                    envP->ThrowError("rfs_merge: value out of bounds in <s%d> string: %d "
+                                     "(line offset %u)",
+                                     str_cnt, e.val, parser.getLineNumber());
+                }
+                def_flag = true;
             }
-            result += args [str_cnt].AsString ();
-            def_flag = true;
         }
+
+        if (! def_flag)
+        {
+            return (AVSValue ());
+        }
+
+        std::string     result;
+        RemapFramesParser::merge_ranges (result, range_list);
+
+        return (envP->SaveString (result.c_str (), int (result.length ())));
+    }
+    catch (std::bad_alloc&)
+    {
+        envP->ThrowError("rfs_merge: insufficient memory");
+    }
+
+    return (AVSValue ());
+}
+
+
+
+/** CreateStats
+  *
+  *     RemapFramesStats: returns the performance counters of a clip
+  *     returned by one of the filters, one per line.
+  */
+AVSValue __cdecl RemapFrames::CreateStats(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const PClip clip = args[0].AsClip();
+    const RemapFrames* filterP = findInstance(clip);
+    if (filterP == NULL)
+    {
+        envP->ThrowError("RemapFramesStats: the clip is not the output of RemapFrames");
     }
 
-    if (! def_flag)
+#ifdef REMAPFRAMES_STATS
+    AudioBlockCache::Stats cacheStats;
+    if (filterP->blockCacheP)
     {
-        return (AVSValue ());
+        cacheStats = filterP->blockCacheP->getStats();
     }
+    const std::string text = filterP->stats.format(filterP->blockCacheP ? &cacheStats : NULL);
 
-    return (envP->SaveString (result.c_str (), int (result.length ())));
+    return (envP->SaveString(text.c_str(), int (text.length())));
+#else
+    return (AVSValue("statistics not compiled in (build with REMAPFRAMES_STATS defined)"));
+#endif
+}
+
+
+/** CreateSourceOf
+  *
+  *     RemapFramesSourceOf: returns the source frame of an output frame
+  *     of a clip returned by one of the filters, or with clip=true, the
+  *     index of the clip it's taken from (see reportedClipIndex()); -1
+  *     for the blank frames.
+  */
+AVSValue __cdecl RemapFrames::CreateSourceOf(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const PClip clip = args[0].AsClip();
+    const RemapFrames& filter = findOutput(clip, "RemapFramesSourceOf", envP);
+
+    const int n = args[1].AsInt();
+    if (n < 0 || n >= filter.frameMap.size())
+    {
+        envP->ThrowError("RemapFramesSourceOf: frame %d is out of range", n);
+    }
+
+    const MapIndex element = filter.frameMap.lookup(n);
+    if (element.clipIndex == MapIndex::BLANK_CLIP)
+    {
+        return (AVSValue(-1));
+    }
+    return (AVSValue(args[2].AsBool(false) ? filter.reportedClipIndex(element) : element.frame));
+}
+
+
+/** CreateUsesOf
+  *
+  *     RemapFramesUsesOf: returns the output frames taken from a frame
+  *     of the source clip (of the base clip with base=true; the same
+  *     when there is no source clip) of a clip returned by one of the
+  *     filters with inverseIndex=true, in ascending order: as an array,
+  *     or the index-th one, -1 past the last.
+  */
+AVSValue __cdecl RemapFrames::CreateUsesOf(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const PClip clip = args[0].AsClip();
+    const RemapFrames& filter = findOutput(clip, "RemapFramesUsesOf", envP);
+    if (!filter.inverseMapP)
+    {
+        envP->ThrowError("RemapFramesUsesOf: the clip was not created with inverseIndex=true");
+    }
+
+    const int clipIndex = args[2].AsBool(false) ? 0 : 1;
+    const int k = args[1].AsInt();
+    const int count = filter.inverseMapP->countUses(clipIndex, k);
+    const int* usesP = filter.inverseMapP->getUses(clipIndex, k);
+
+    if (args[3].Defined())
+    {
+        const int index = args[3].AsInt();
+        return (AVSValue((index >= 0 && index < count) ? usesP[index] : -1));
+    }
+
+    // Arrays came with the version 8 interface (AviSynth+ 3.6)
+    try
+    {
+        envP->CheckVersion(8);
+    }
+    catch (const AvisynthError&)
+    {
+        envP->ThrowError("RemapFramesUsesOf: returning an array requires AviSynth+ 3.6 or later; use index");
+    }
+
+    std::vector<AVSValue> uses(usesP, usesP + count);
+    return (AVSValue(uses.data(), count));
+}
+
+
+/** CreateUseCount
+  *
+  *     RemapFramesUseCount: returns the number of output frames taken
+  *     from a frame of the source clip (of the base clip with base=true)
+  *     of a clip returned by one of the filters with inverseIndex=true.
+  */
+AVSValue __cdecl RemapFrames::CreateUseCount(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const PClip clip = args[0].AsClip();
+    const RemapFrames& filter = findOutput(clip, "RemapFramesUseCount", envP);
+    if (!filter.inverseMapP)
+    {
+        envP->ThrowError("RemapFramesUseCount: the clip was not created with inverseIndex=true");
+    }
+
+    const int clipIndex = args[2].AsBool(false) ? 0 : 1;
+    return (AVSValue(filter.inverseMapP->countUses(clipIndex, args[1].AsInt())));
 }
 
-*/
+
 
 /** AvisynthPluginInit2
   *
@@ -884,19 +2589,26 @@ AVSValue __cdecl RemapFrames::CreateMerge (AVSValue args, void* userDataP, IScri
   */
 const AVS_Linkage* AVS_linkage = nullptr;
 
-extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors)
+// Optional parameters read by RemapFrames::readOptions()
+#define OPTIONS_SIGNATURE "[prefetch]i[prefetchThreads]i[gop]i[keyframes]s[audioPrefetch]b[audioThreads]i[audioStream]i[audioCache]i[statsFile]s[traceFile]s[cpu]s[frameProps]b[inverseIndex]b"
+
+extern "C" REMAPFRAMES_EXPORT const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors)
 {
     AVS_linkage = vectors;
-    //envP->AddFunction("RemapFrames", "c[filename]s[mappings]s[sourceClip]c", RemapFrames::Create, NULL);
-    envP->AddFunction("RemapFramesSimple_AudioMod", "c[filename]s[mappings]s[audioBlendSamples]i", RemapFrames::CreateSimple, NULL);
-    //envP->AddFunction("ReplaceFramesSimple", "cc[filename]s[mappings]s", RemapFrames::CreateReplaceSimple, NULL);
+    envP->AddFunction("RemapFrames", "c[filename]s[mappings]s[sourceClip]c[audioBlendSamples]i" OPTIONS_SIGNATURE, RemapFrames::Create, NULL);
+    envP->AddFunction("RemapFramesSimple_AudioMod", "c[filename]s[mappings]s[audioBlendSamples]i" OPTIONS_SIGNATURE, RemapFrames::CreateSimple, NULL);
+    envP->AddFunction("ReplaceFramesSimple", "cc[filename]s[mappings]s[audioBlendSamples]i" OPTIONS_SIGNATURE, RemapFrames::CreateReplaceSimple, NULL);
 
-    //envP->AddFunction("remf", "c[mappings]s[filename]s[sourceClip]c", RemapFrames::Create, (void *)1);
+    envP->AddFunction("remf", "c[mappings]s[filename]s[sourceClip]c[audioBlendSamples]i" OPTIONS_SIGNATURE, RemapFrames::Create, (void *)1);
     //envP->AddFunction("remfs", "c[mappings]s[filename]s", RemapFrames::CreateSimple, (void *)1);
-    //envP->AddFunction("rfs", "cc[mappings]s[filename]s", RemapFrames::CreateReplaceSimple, (void *)1);
-
-    //envP->AddFunction("rfs_transform", "[mappings]s[op]s[open]b[discrete]b", RemapFrames::CreateTransform, 0);
-    //envP->AddFunction("rfs_merge", "[s0]s[s1]s[s2]s[s3]s[s4]s[s5]s[s6]s[s7]s[s8]s[s9]s", RemapFrames::CreateMerge, 0);
+    envP->AddFunction("rfs", "cc[mappings]s[filename]s[audioBlendSamples]i" OPTIONS_SIGNATURE, RemapFrames::CreateReplaceSimple, (void *)1);
+
+    envP->AddFunction("rfs_transform", "[mappings]s[op]s[open]b[discrete]b", RemapFrames::CreateTransform, 0);
+    envP->AddFunction("RemapFramesStats", "c", RemapFrames::CreateStats, 0);
+    envP->AddFunction("RemapFramesSourceOf", "ci[clip]b", RemapFrames::CreateSourceOf, 0);
+    envP->AddFunction("RemapFramesUsesOf", "ci[base]b[index]i", RemapFrames::CreateUsesOf, 0);
+    envP->AddFunction("RemapFramesUseCount", "ci[base]b", RemapFrames::CreateUseCount, 0);
+    envP->AddFunction("rfs_merge", "[s0]s[s1]s[s2]s[s3]s[s4]s[s5]s[s6]s[s7]s[s8]s[s9]s", RemapFrames::CreateMerge, 0);
 
     return "RemapFrames v0.4.1 (Audiomod) [" __DATE__ "]\nCopyright (c) 2005 James D. Lin";
 }
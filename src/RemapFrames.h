@@ -34,64 +34,222 @@
 #ifndef REMAPFRAMES_H
 #define REMAPFRAMES_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include <avs/config.h>
+#ifdef AVS_WINDOWS
+#include <avs/win.h>
+#endif
 #include <avisynth.h>
 
+#include "FrameMap.h"
+#include "AudioBlockCache.h"
+#include "AudioStreamer.h"
+#include "FramePrefetcher.h"
+#include "InverseFrameMap.h"
+#include "Kernels.h"
+#include "PerfStats.h"
+#include "TraceRecorder.h"
+#include "WorkerPool.h"
+
 
 
 // MACROS --------------------------------------------------------------
 
 #define ARRAY_LENGTH(arr) (sizeof (arr) / sizeof *(arr))
 
+// Exports the plug-in entry point. Elsewhere than on Windows, the
+// library is built with hidden symbols (see CMakeLists.txt), so that its
+// classes don't clash with those of other plug-ins.
+#ifdef AVS_WINDOWS
+#define REMAPFRAMES_EXPORT __declspec(dllexport)
+#else
+#define REMAPFRAMES_EXPORT __attribute__((visibility("default")))
+#endif
 
 
-// CLASS PROTOTYPES ----------------------------------------------------
-
-struct MapIndex
-{
-    int clipIndex;
-    int frame;
-};
 
+// CLASS PROTOTYPES ----------------------------------------------------
 
 class RemapFrames : public GenericVideoFilter
 {
 public:
     typedef enum { MODE_SIMPLE, MODE_REPLACE_SIMPLE, MODE_ADVANCED } mode_t;
 
+    // Optional performance parameters, common to all the filters (see
+    // OPTIONS_SIGNATURE).
+    struct Options
+    {
+        int prefetchDepth;
+        int prefetchThreads;
+        int gopLength;
+        const char* keyframesP;
+        bool audioPrefetchFlag;
+        int audioThreads;
+        int audioStreamSamples;
+        int audioCacheSamples;
+        const char* statsFileP;
+        const char* traceFileP;
+        const char* cpuP;
+        bool framePropsFlag;
+        bool inverseIndexFlag;
+    };
+
+    virtual ~RemapFrames();
+
     virtual PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* envP);
-    void __stdcall GetAudio(void* buf, __int64 start, __int64 count, IScriptEnvironment* env);
+    void __stdcall GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* env);
     virtual bool __stdcall GetParity(int n);
+    virtual int __stdcall SetCacheHints(int cachehints, int frame_range);
 
-    //static AVSValue __cdecl Create(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl Create(AVSValue args, void* userDataP, IScriptEnvironment* envP);
     static AVSValue __cdecl CreateSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP);
-    //static AVSValue __cdecl CreateReplaceSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP);
-    //static AVSValue __cdecl CreateTransform(AVSValue args, void* userDataP, IScriptEnvironment* envP);
-    //static AVSValue __cdecl CreateMerge(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateReplaceSimple(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateTransform(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateMerge(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateStats(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateSourceOf(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateUsesOf(AVSValue args, void* userDataP, IScriptEnvironment* envP);
+    static AVSValue __cdecl CreateUseCount(AVSValue args, void* userDataP, IScriptEnvironment* envP);
 
 private:
+    // Private cache hint: returns the instance identifier, if
+    // <frame_range> is the key of this module (see findInstance()).
+    enum { CACHE_GET_REMAPFRAMES_ID = CACHE_USER_CONSTANTS + 0x5246 };
+
     PClip sourceClip;
 
+    // Audio of the frames taken from each clip (indexed by
+    // MapIndex::clipIndex). The source clip audio is only used when its
+    // format matches the base clip; otherwise the base clip is used.
+    PClip audioClips[2];
+
     int audioBlendSamples;
 
+    // Inner loops, built for the instruction set chosen at creation and
+    // specialized for the channels of the clip (see selectKernels())
+    const Kernels* kernelsP;
+
     // Stores the rearranged frame indices.
-    std::vector<MapIndex> indices;
+    FrameMap frameMap;
+
+    // Frame indices used by the audio remapping: <frameMap>, unless it was
+    // fused with the mappings of the base clip (see fuseWith()); the
+    // unfused indices are then kept in <audioMap>.
+    FrameMap audioMap;
+    const FrameMap* audioMapP;
+
+    // Inverse of <frameMap>, for RemapFramesUsesOf and
+    // RemapFramesUseCount; NULL when disabled.
+    std::unique_ptr<InverseFrameMap> inverseMapP;
+
+    // Identifies the instance in the fusion registry; 0 if not registered
+    int instanceId;
+
+    // Returned for the blank frames; built once if the mappings have any
+    PVideoFrame blankFrame;
+
+    // Tells if the output frames carry the _RemapSourceFrame and
+    // _RemapSourceClip properties (see setSourceProps())
+    bool framePropsFlag;
+
+    // Access trace; NULL when disabled. Declared before the threads
+    // recording into it, so it outlives them.
+    std::unique_ptr<TraceRecorder> traceP;
+
+    // Optional look-ahead on the source frames; NULL when disabled.
+    // Declared after the clips so its workers stop before they are
+    // released.
+    std::unique_ptr<FramePrefetcher> prefetcherP;
+    std::atomic<int> lastRequested;
+
+    // GOP structure of the source, for the seek smoothing: either a fixed
+    // GOP length or a sorted list of keyframes; both empty when disabled.
+    // <gopClipFlags> tells which clips (by MapIndex::clipIndex) it
+    // applies to; both are <sourceClip> then, so <warmedGopStart>, the
+    // start of the GOP last decoded from its beginning (-1 if none), is
+    // kept for that clip alone.
+    int gopLength;
+    std::vector<int> keyframes;
+    bool gopClipFlags[2];
+    std::atomic<int> warmedGopStart;
+
+    // Submits the audio of the next request window to the caches of the
+    // audio clips.
+    bool audioPrefetchFlag;
+
+    // Renders the large audio requests in parallel; NULL when disabled.
+    std::unique_ptr<WorkerPool> audioPoolP;
+
+    // Rendered output audio, for the re-requests; NULL when disabled.
+    std::unique_ptr<AudioBlockCache> blockCacheP;
+
+    // Renders ahead of sequential audio requests; NULL when disabled.
+    // <streamMutex> keeps a single consumer at a time.
+    std::unique_ptr<AudioStreamer> streamerP;
+    std::mutex streamMutex;
+    std::atomic<int64_t> lastAudioEnd;
+
+#ifdef REMAPFRAMES_STATS
+    // Performance counters; appended as JSON to <statsFile> on
+    // destruction unless empty.
+    mutable PerfStats stats;
+    std::string statsFile;
+#endif
 
     static bool is_empty_string (const char *str_0);
+    static PClip convertAudio(const AVSValue& clip, IScriptEnvironment* envP);
+    static Options readOptions(const AVSValue& args, int first);
+    static const Kernels& selectKernels(const char* cpuP, int channels, IScriptEnvironment* envP);
+    static void parseSimpleMappings(const char* filenameP, const char* mappingsP, bool tol_flag, int srcFrames,
+                                    const Kernels& kernels, FrameMap* mapP, IScriptEnvironment* envP);
+    static int getModuleKey();
+    static const RemapFrames* findInstance(const PClip& clip);
+    static const RemapFrames& findOutput(const PClip& clip, const char* functionP, IScriptEnvironment* envP);
 
-    void initSimpleMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,bool tol_flag, IScriptEnvironment* envP);
-    //void initReplaceSimpleMode(const char* filenameP, const char* mappingsP, bool tol_flag, IScriptEnvironment* envP);
-    //void initAdvancedMode(const char* filenameP, const char* mappingsP, bool tol_flag, IScriptEnvironment* envP);
+    void initSimpleMode(FrameMap* simpleMapP, const int audioBlendSamplesArg);
+    void initReplaceSimpleMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg, bool tol_flag, IScriptEnvironment* envP);
+    void initAdvancedMode(const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg, bool tol_flag, IScriptEnvironment* envP);
+    void initPrefetch(int depth, int nbrThreads, IScriptEnvironment* envP);
+    void initGop(int gopLength_, const char* keyframesP, IScriptEnvironment* envP);
+    void initAudioCache(int nbrSamples, IScriptEnvironment* envP);
+    void initAudioThreads(int nbrThreads, int streamSamples, IScriptEnvironment* envP);
+    void initTrace(const char* filenameP, IScriptEnvironment* envP);
+    void initFrameProps(bool flag, IScriptEnvironment* envP);
+    void initInverseIndex(bool flag, IScriptEnvironment* envP);
+    bool isFusable() const;
+    void fuseWith(const RemapFrames& inner);
 
     struct remappedAudioSample;
 
+    MapIndex lookupFrame(int n) const;
+    int reportedClipIndex(const MapIndex& element) const;
+    MapIndex lookupAudioFrame(int n) const;
+    long double frameOfSample(int64_t sample) const;
+    int64_t firstSampleOfFrame(int n) const;
+    int64_t findAudioSpan(int64_t pos, int* clipIndexP) const;
+    PVideoFrame getPrefetched(int n, const MapIndex& element, IScriptEnvironment* envP);
+    PVideoFrame setSourceProps(const PVideoFrame& frame, const MapIndex& element, IScriptEnvironment* envP) const;
+    int findGopStart(int frame) const;
+    void smoothSeek(const MapIndex& element, IScriptEnvironment* envP);
+    void prefetchAudio(int64_t start, int64_t count) const;
+    void renderAudio(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env);
+    void renderRequest(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env);
+    void renderUncached(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env);
+    void renderParallel(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env);
+    void readAudio(int clipIndex, void* buf, int64_t start, int64_t count, IScriptEnvironment* env);
+    void gatherAudio(SFLOAT* samples, const int* clipIndices, const int64_t* positions, int count,
+                     std::vector<SFLOAT>* windowP, IScriptEnvironment* env);
+    void renderRemapped(SFLOAT* samples, int64_t start, int64_t count, IScriptEnvironment* env);
+
     inline remappedAudioSample remapAudioSample(long long originalAudioSample, long double audioSampleRate, long double videoFramerate);
 
     explicit RemapFrames(PClip child_, PClip sourceClip_, mode_t mode,
                          const char* filenameP, const char* mappingsP, const int audioBlendSamplesArg,
+                         const Options& options, FrameMap* simpleMapP, const RemapFrames* innerP,
                          bool tol_flag, IScriptEnvironment* envP);
 };
 
@@ -40,15 +40,19 @@
 #include <cctype>
 #include <cstring>
 #include <cassert>
+#include <climits>
 #include <cmath>
 
 #include <algorithm>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 #include "Calc.h"
 #include "ScopeGuard.h"
 
 #include "getLine.h"
+#include "Kernels.h"
 #include "RemapFramesParser.h"
 
 
@@ -60,22 +64,23 @@
   *     Initializer for RemapFramesParser
   *
   * PARAMETERS:
-  *     IN/OUT indicesP_ - the vector to store the rearranged indices;
-  *                        must have size() > 0;
-  *                        elements must be pre-initialized to their default
-  *                          mappings
+  *     IN/OUT mapP_     - the map to store the rearranged indices;
+  *                        must be initialized (sparse for parse() and
+  *                          parseReplaceSimple(), dense for parseSimple())
   *     IN max_          - the maximum value allowed for new indices
-  *     IN tol_flag      - indicates if we tolerate out-of-range indices
+  *     IN kernels       - the kernels scanning the tokens
   */
-void RemapFramesParser::init(std::vector<MapIndex>* indicesP_, int max_) throw()
+void RemapFramesParser::init(FrameMap* mapP_, int max_, const Kernels& kernels) throw()
 {
-    assert(indicesP_ != NULL);
+    assert(mapP_ != NULL);
 
-    indicesP = indicesP_;
+    mapP = mapP_;
     f_max = max_;
     lineP = NULL;
+    kernelsP = &kernels;
 
     pos.p = NULL;
+    pos.endP = NULL;
     pos.line = 1;
     pos.col = 1;
 }
@@ -86,20 +91,21 @@ void RemapFramesParser::init(std::vector<MapIndex>* indicesP_, int max_) throw()
   * PARAMETERS:
   *     IN fileP_        - an open, readable file stream to the file to
   *                        parse
-  *     IN/OUT indicesP_ - the vector to store the rearranged indices;
-  *                        must have size() > 0;
-  *                        elements must be pre-initialized to their default
-  *                        mappings
+  *     IN/OUT mapP_     - the map to store the rearranged indices;
+  *                        must be initialized (sparse for parse() and
+  *                          parseReplaceSimple(), dense for parseSimple())
   *     IN max_          - the maximum value allowed for new indices
   *     IN tol_flag      - indicates if we tolerate out-of-range indices
+  *     IN kernels       - the kernels scanning the tokens;
+  *                        must outlive the parser
   */
-RemapFramesParser::RemapFramesParser(FILE* fileP_, std::vector<MapIndex>* indicesP_, int max_, bool tol_flag)
+RemapFramesParser::RemapFramesParser(FILE* fileP_, FrameMap* mapP_, int max_, bool tol_flag, const Kernels& kernels)
 : inputMode(MODE_FILE)
 , _tol_flag (tol_flag)
 {
     assert(fileP_ != NULL);
 
-    init(indicesP_, max_);
+    init(mapP_, max_, kernels);
     input.fileP = fileP_;
 }
 
@@ -108,19 +114,21 @@ RemapFramesParser::RemapFramesParser(FILE* fileP_, std::vector<MapIndex>* indice
   *
   * PARAMETERS:
   *     IN mappingsP_    - the string to parse
-  *     IN/OUT indicesP_ - the vector to store the rearranged indices;
-  *                        must have size() > 0;
-  *                        elements must be pre-initialized to their default
-  *                        mappings
+  *     IN/OUT mapP_     - the map to store the rearranged indices;
+  *                        must be initialized (sparse for parse() and
+  *                          parseReplaceSimple(), dense for parseSimple())
   *     IN max_          - the maximum value allowed for new indices
+  *     IN tol_flag      - indicates if we tolerate out-of-range indices
+  *     IN kernels       - the kernels scanning the tokens;
+  *                        must outlive the parser
   */
-RemapFramesParser::RemapFramesParser(const char* mappingsP_, std::vector<MapIndex>* indicesP_, int max_, bool tol_flag)
+RemapFramesParser::RemapFramesParser(const char* mappingsP_, FrameMap* mapP_, int max_, bool tol_flag, const Kernels& kernels)
 : inputMode(MODE_DIRECT)
 , _tol_flag (tol_flag)
 {
     assert(mappingsP_ != NULL);
 
-    init(indicesP_, max_);
+    init(mapP_, max_, kernels);
     input.mappingsP = mappingsP_;
 }
 
@@ -191,17 +199,23 @@ void RemapFramesParser::setPos() throw()
   * SIDE EFFECTS:
   *     allocates and fills <lineP>;
   *     it is the caller's responsibility to free <lineP> with freeLine() when
-  *       done
+  *       done;
+  *     sets <pos.endP>
   *
   * THROWS:
   *     std::bad_alloc - insufficient memory
   */
 bool RemapFramesParser::readLine() throw(std::bad_alloc)
 {
-    return (inputMode == MODE_FILE)
-           ? ::getLine(input.fileP, &lineP)
-           : // inputMode == MODE_DIRECT
-             ::getLine(&input.mappingsP, &lineP);
+    const bool readFlag = (inputMode == MODE_FILE)
+                          ? ::getLine(input.fileP, &lineP)
+                          : // inputMode == MODE_DIRECT
+                            ::getLine(&input.mappingsP, &lineP);
+    if (readFlag)
+    {
+        pos.endP = lineP + strlen(lineP);
+    }
+    return readFlag;
 }
 
 
@@ -226,10 +240,7 @@ void RemapFramesParser::freeLine() throw()
   */
 void RemapFramesParser::skipWhitespace() throw()
 {
-    while (*pos.p != '\0' && isspace(*pos.p))
-    {
-        ++pos.p;
-    }
+    pos.p = kernelsP->skipSpaces(pos.p, pos.endP);
 }
 
 
@@ -332,23 +343,29 @@ bool RemapFramesParser::matchInt(int* valP) throw(OverflowException)
     setPos();
 
     {
-        char* endP;
-        int val = strtol(pos.p, &endP, 10);
+        const bool negativeFlag = (*pos.p == '-');
+        const char* digitsP = (*pos.p == '+' || negativeFlag) ? pos.p + 1 : pos.p;
+        const char* endP = kernelsP->skipDigits(digitsP, pos.endP);
 
         // check that we matched at least one digit
-        // (strtol will return 0 if fed a string with no digits)
-        if (endP > pos.p && isdigit(*(endP - 1)))
+        if (endP > digitsP)
         {
-            if (val == LONG_MIN || val == LONG_MAX)
-            {
-                throw OverflowException();
-            }
-            else
+            // Same bounds as strtol() with a 32-bit long, which saturates
+            // at LONG_MIN and LONG_MAX
+            const long long limit = negativeFlag ? -(long long)INT_MIN : INT_MAX;
+            long long magnitude = 0;
+            for (const char* p = digitsP; p < endP; ++p)
             {
-                *valP = val;
-                pos.p = endP;
-                matched = true;
+                magnitude = magnitude * 10 + (*p - '0');
+                if (magnitude >= limit)
+                {
+                    throw OverflowException();
+                }
             }
+
+            *valP = negativeFlag ? (int)-magnitude : (int)magnitude;
+            pos.p = endP;
+            matched = true;
         }
     }
 
@@ -401,6 +418,97 @@ bool RemapFramesParser::matchRange(range_t* rangeP) throw()
 }
 
 
+/** matchStepRange
+  *
+  *     Matches an integer range with an optional step.  It appears as:
+  *         [i j]
+  *     or
+  *         [i j step]
+  *     in the input file.
+  *
+  * PARAMETERS:
+  *     OUT rangeP - on output, the found integer range;
+  *                  if the current token is not an integer range, left
+  *                    untouched
+  *     OUT stepP  - on output, the step, or 1 if not specified;
+  *                  if the current token is not an integer range, left
+  *                    untouched
+  *
+  * RETURNS:
+  *     true if an integer range are the current tokens in the line;
+  *     false otherwise
+  *
+  * SIDE EFFECTS:
+  *     if matched, advances <pos.p> to point to the start of the next
+  *       unparsed token
+  *
+  * THROWS:
+  *     OverflowException - the magnitude of an integer is too large to
+  *                           handle
+  */
+bool RemapFramesParser::matchStepRange(range_t* rangeP, int* stepP) throw(OverflowException)
+{
+    assert(rangeP != NULL);
+    assert(stepP != NULL);
+
+    bool matched = false;
+
+    setPos();
+
+    if (matchChar('['))
+    {
+        RemapFramesParser tempState = *this;
+        range_t range;
+        int step = 1;
+        if (   tempState.matchInt(&range.start)
+            && tempState.matchInt(&range.end)
+            && (tempState.matchChar(']') || (tempState.matchInt(&step) && tempState.matchChar(']'))))
+        {
+            *rangeP = range;
+            *stepP = step;
+            *this = tempState; // commit
+            matched = true;
+        }
+    }
+
+    return matched;
+}
+
+
+/** matchBlank
+  *
+  *     Matches a blank frame token, either "-" or "blank".
+  *
+  * RETURNS:
+  *     true if a blank token is the current token in the line;
+  *     false otherwise
+  *
+  * SIDE EFFECTS:
+  *     if matched, advances <pos.p> to point to the start of the next
+  *       unparsed token
+  */
+bool RemapFramesParser::matchBlank() throw()
+{
+    bool matched = false;
+
+    skipWhitespace();
+    setPos();
+
+    if (*pos.p == '-' && !isdigit(pos.p[1]))
+    {
+        ++pos.p;
+        matched = true;
+    }
+    else if (strncmp(pos.p, "blank", 5) == 0 && !isalnum(pos.p[5]))
+    {
+        pos.p += 5;
+        matched = true;
+    }
+
+    return matched;
+}
+
+
 /** setFrame
   *
   *     Maps a single frame to another single frame.
@@ -410,14 +518,14 @@ bool RemapFramesParser::matchRange(range_t* rangeP) throw()
   *     j - the new frame index
   *
   * SIDE EFFECTS:
-  *     mutates <indicesP>
+  *     mutates <mapP>
   *
   * THROWS:
   *     BadValueException - <i> or <j> is out of bounds
   */
-void RemapFramesParser::setFrame(int i, int j) throw(BadValueException)
+void RemapFramesParser::setFrame(int i, int j) throw(std::bad_alloc, BadValueException)
 {
-    int n = int (indicesP->size());
+    int n = mapP->size();
     if (!(i >= 0 && i < n))
     {
         if (! _tol_flag)
@@ -434,13 +542,12 @@ void RemapFramesParser::setFrame(int i, int j) throw(BadValueException)
         j =   (j >= f_max) ? f_max - 1
             : (j <    0) ? 0
             :              j;
-        MapIndex& element = (*indicesP)[i];
-        element.clipIndex = 1;
-        element.frame = j;
+        const FrameMap::Run run = { i, i, 1, i, j, 0.0 };
+        mapP->assign(run);
     }
 }
 
-void RemapFramesParser::appendFrame(int j) throw(BadValueException)
+void RemapFramesParser::appendFrame(int j) throw(std::bad_alloc, BadValueException)
 {
     const bool in_range_flag = (j >= 0 && j < f_max);
     if (! in_range_flag && (! _tol_flag || f_max == 0))
@@ -453,11 +560,60 @@ void RemapFramesParser::appendFrame(int j) throw(BadValueException)
         MapIndex element;
         element.clipIndex = 1;
         element.frame = j;
-        indicesP->push_back(element);
+        mapP->append(element);
     }
 }
 
 
+/** appendRange
+  *
+  *     Appends a range of frames to a dense map, as a single run.
+  *     The range is descending if its end is lower than its start.
+  *
+  * PARAMETERS:
+  *     IN range - the range of source frames
+  *     step     - the distance between two consecutive source frames;
+  *                  must be > 0
+  *
+  * SIDE EFFECTS:
+  *     mutates <mapP>
+  *
+  * THROWS:
+  *     BadValueException - <range> or <step> is out of bounds, or the
+  *                           range has too many frames
+  */
+void RemapFramesParser::appendRange(const range_t& range, int step) throw(std::bad_alloc, BadValueException)
+{
+    if (step <= 0)
+    {
+        throw BadValueException(step);
+    }
+    if (!(range.start >= 0 && range.start < f_max) && (! _tol_flag || f_max == 0))
+    {
+        throw BadValueException(range.start);
+    }
+    if (!(range.end >= 0 && range.end < f_max) && (! _tol_flag || f_max == 0))
+    {
+        throw BadValueException(range.end);
+    }
+
+    const unsigned int distance =   (range.end >= range.start)
+                                  ? unsigned (range.end) - unsigned (range.start)
+                                  : unsigned (range.start) - unsigned (range.end);
+    const unsigned int count = distance / unsigned (step) + 1;
+    const int n = mapP->size();
+    if (count > unsigned (INT_MAX - n))
+    {
+        throw BadValueException(range.end);
+    }
+
+    // Out-of-range source frames are clipped by the map itself.
+    const FrameMap::Run run = { n, n + int (count) - 1, 1, n, range.start,
+                                (range.end >= range.start) ? double (step) : -double (step) };
+    mapP->appendRun(run);
+}
+
+
 /** fillRange
   *
   *     Maps a range of frames to a single frame.
@@ -467,14 +623,14 @@ void RemapFramesParser::appendFrame(int j) throw(BadValueException)
   *     j          - the output frame index
   *
   * SIDE EFFECTS:
-  *     mutates <indicesP>
+  *     mutates <mapP>
   *
   * THROWS:
   *     BadValueException - <rangeInP> or <j> is out of bounds
   */
-void RemapFramesParser::fillRange(const range_t& rangeIn, int j) throw(BadValueException)
+void RemapFramesParser::fillRange(const range_t& rangeIn, int j) throw(std::bad_alloc, BadValueException)
 {
-    int n = int (indicesP->size());
+    int n = mapP->size();
     if (!(rangeIn.start >= 0 && rangeIn.start < n) && ! _tol_flag)
     {
         throw BadValueException(rangeIn.start);
@@ -493,31 +649,18 @@ void RemapFramesParser::fillRange(const range_t& rangeIn, int j) throw(BadValueE
     }
     else
     {
-        int m = rangeIn.end - rangeIn.start + 1;
+        FrameMap::Run run = { rangeIn.start, rangeIn.end, 1, rangeIn.start, j, 0.0 };
         if (_tol_flag)
         {
-            j =   (j >= f_max) ? f_max - 1
-                : (j <      0) ? 0
-                :                j;
-            for (int i = 0; i < m; i++)
-            {
-                const int ri = rangeIn.start + i;
-                if (ri >= 0 && ri < n)
-                {
-                    MapIndex& element = (*indicesP)[ri];
-                    element.clipIndex = 1;
-                    element.frame = j;
-                }
-            }
+            run.base =   (j >= f_max) ? f_max - 1
+                       : (j <      0) ? 0
+                       :                j;
+            run.start = std::max(run.start, 0);
+            run.end = std::min(run.end, n - 1);
         }
-        else
+        if (run.start <= run.end)
         {
-            for (int i = 0; i < m; i++)
-            {
-                MapIndex& element = (*indicesP)[rangeIn.start + i];
-                element.clipIndex = 1;
-                element.frame = j;
-            }
+            mapP->assign(run);
         }
     }
 }
@@ -535,14 +678,14 @@ void RemapFramesParser::fillRange(const range_t& rangeIn, int j) throw(BadValueE
   *     IN rangeOut - the output range of frames
   *
   * SIDE EFFECTS:
-  *     mutates <indicesP>
+  *     mutates <mapP>
   *
   * THROWS:
   *     BadValueException - <rangeInP> or <rangeOutP> is out of bounds
   */
-void RemapFramesParser::setRange(const range_t& rangeIn, const range_t& rangeOut) throw(BadValueException)
+void RemapFramesParser::setRange(const range_t& rangeIn, const range_t& rangeOut) throw(std::bad_alloc, BadValueException)
 {
-    int n = int (indicesP->size());
+    int n = mapP->size();
     if (!(rangeIn.start >= 0 && rangeIn.start < n) && ! _tol_flag)
     {
         throw BadValueException(rangeIn.start);
@@ -572,37 +715,79 @@ void RemapFramesParser::setRange(const range_t& rangeIn, const range_t& rangeOut
         assert(m != 0);
 
         d /= m;
+
+        // Out-of-range source frames are clipped by the map itself.
+        FrameMap::Run run = { rangeIn.start, rangeIn.end, 1, rangeIn.start, rangeOut.start, d };
         if (_tol_flag)
         {
-            for (int i = 0; i < m; i++)
-            {
-                const int ri = rangeIn.start + i;
-                if (ri >= 0 && ri < n)
-                {
-                    int rj = int(rangeOut.start + d * i);
-                    rj =   (rj >= f_max) ? f_max - 1
-                         : (rj <      0) ? 0
-                         :                 rj;
-
-                    MapIndex& element = (*indicesP)[ri];
-                    element.clipIndex = 1;
-                    element.frame = rj;
-                }
-            }
+            run.start = std::max(run.start, 0);
+            run.end = std::min(run.end, n - 1);
         }
-        else
+        if (run.start <= run.end)
         {
-            for (int i = 0; i < m; i++)
-            {
-                MapIndex& element = (*indicesP)[rangeIn.start + i];
-                element.clipIndex = 1;
-                element.frame = int(rangeOut.start + d * i);
-            }
+            mapP->assign(run);
+        }
+    }
+}
+
+
+/** blankRange
+  *
+  *     Replaces a range of frames with blank frames.
+  *
+  * PARAMETERS:
+  *     IN rangeIn - the input range of frames
+  *
+  * SIDE EFFECTS:
+  *     mutates <mapP>
+  *
+  * THROWS:
+  *     BadValueException - <rangeIn> is out of bounds
+  */
+void RemapFramesParser::blankRange(const range_t& rangeIn) throw(std::bad_alloc, BadValueException)
+{
+    int n = mapP->size();
+    if (!(rangeIn.start >= 0 && rangeIn.start < n) && ! _tol_flag)
+    {
+        throw BadValueException(rangeIn.start);
+    }
+    else if (!(rangeIn.end < n) && ! _tol_flag)
+    {
+        throw BadValueException(rangeIn.end);
+    }
+    else if (!(rangeIn.start <= rangeIn.end))
+    {
+        throw BadValueException(rangeIn.end);
+    }
+    else
+    {
+        FrameMap::Run run = { rangeIn.start, rangeIn.end, MapIndex::BLANK_CLIP, rangeIn.start, 0, 0.0 };
+        if (_tol_flag)
+        {
+            run.start = std::max(run.start, 0);
+            run.end = std::min(run.end, n - 1);
+        }
+        if (run.start <= run.end)
+        {
+            mapP->assign(run);
         }
     }
 }
 
 
+/** appendBlank
+  *
+  *     Appends a blank frame to a dense map.
+  */
+void RemapFramesParser::appendBlank() throw(std::bad_alloc)
+{
+    MapIndex element;
+    element.clipIndex = MapIndex::BLANK_CLIP;
+    element.frame = 0;
+    mapP->append(element);
+}
+
+
 /** parse
   *
   *     Parses the input file.
@@ -611,7 +796,7 @@ void RemapFramesParser::setRange(const range_t& rangeIn, const range_t& rangeOut
   *     simple - pass true to use simple mode
   *
   * SIDE EFFECTS:
-  *     mutates indicesP;
+  *     mutates <mapP>;
   *     sets <pos.p>, <pos.line>, and <pos.col>
   *
   * THROWS:
@@ -637,13 +822,19 @@ void RemapFramesParser::parse() throw(std::bad_alloc, MalformedException, Overfl
         pos.p = lineP;
         if (matchInt(&i))
         {
-            if (!matchInt(&j))
+            if (matchInt(&j))
             {
-                throw MalformedException();
+                setFrame(i, j);
+            }
+            else if (matchBlank())
+            {
+                rangeIn.start = i;
+                rangeIn.end = i;
+                blankRange(rangeIn);
             }
             else
             {
-                setFrame(i, j);
+                throw MalformedException();
             }
         }
         else if (matchRange(&rangeIn))
@@ -656,6 +847,10 @@ void RemapFramesParser::parse() throw(std::bad_alloc, MalformedException, Overfl
             {
                 setRange(rangeIn, rangeOut);
             }
+            else if (matchBlank())
+            {
+                blankRange(rangeIn);
+            }
             else
             {
                 throw MalformedException();
@@ -674,8 +869,9 @@ void RemapFramesParser::parse() throw(std::bad_alloc, MalformedException, Overfl
 // Returns the new number of frames.
 int RemapFramesParser::parseSimple() throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
 {
-    int numFrames = 0,
-        i;
+    int i,
+        step;
+    range_t range;
     assert(lineP == NULL);
 
     while (readLine())
@@ -683,10 +879,24 @@ int RemapFramesParser::parseSimple() throw(std::bad_alloc, MalformedException, O
         ON_BLOCK_EXIT_OBJ(*this, &RemapFramesParser::freeLine);
 
         pos.p = lineP;
-        while (matchInt(&i))
+        while (true)
         {
-            appendFrame(i);
-            ++numFrames;
+            if (matchInt(&i))
+            {
+                appendFrame(i);
+            }
+            else if (matchBlank())
+            {
+                appendBlank();
+            }
+            else if (matchStepRange(&range, &step))
+            {
+                appendRange(range, step);
+            }
+            else
+            {
+                break;
+            }
         }
 
         (void) matchComment();
@@ -695,7 +905,7 @@ int RemapFramesParser::parseSimple() throw(std::bad_alloc, MalformedException, O
 
         ++pos.line;
     }
-    return numFrames;
+    return mapP->size();
 }
 
 
@@ -741,6 +951,86 @@ void RemapFramesParser::parseReplaceSimple() throw(std::bad_alloc, MalformedExce
 
 
 
+/** parseRangeList
+  *
+  *     Parses a list of frames and frame ranges, as accepted by
+  *     ReplaceFramesSimple.
+  *
+  * PARAMETERS:
+  *     IN/OUT range_list - the parsed ranges are appended to it, in input
+  *                           order; single frames become 1-frame ranges
+  *
+  * THROWS:
+  *     MalformedException - parse error; the input is malformed
+  *     OverflowException  - the magnitude of a parsed integer is too large
+  *                            to handle
+  *     BadValueException  - a frame is negative or a range is reversed
+  */
+void RemapFramesParser::parseRangeList(std::vector<range_t> &range_list)
+throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
+{
+    int i;
+    range_t range;
+    assert(lineP == NULL);
+
+    while (readLine())
+    {
+        ON_BLOCK_EXIT_OBJ(*this, &RemapFramesParser::freeLine);
+
+        pos.p = lineP;
+        while (true)
+        {
+            if (matchInt(&i))
+            {
+                range.start = i;
+                range.end = i;
+            }
+            else if (!matchRange(&range))
+            {
+                break;
+            }
+
+            if (range.start < 0)
+            {
+                throw BadValueException(range.start);
+            }
+            if (range.start > range.end)
+            {
+                throw BadValueException(range.end);
+            }
+            range_list.push_back(range);
+        }
+
+        (void) matchComment();
+
+        if (!isLineEmpty()) { throw MalformedException(); }
+
+        ++pos.line;
+    }
+}
+
+
+/** parseTransform
+  *
+  *     Parses a range list and maps each range through <calc>.
+  *
+  *     The ranges are collected first, then mapped independently (in
+  *     parallel when the list is large enough) and the results are
+  *     concatenated in input order.
+  *
+  * PARAMETERS:
+  *     OUT result       - the transformed range list
+  *     IN calc          - the transform; must have been parsed with the
+  *                          "xry" variable list
+  *     hopen_flag       - ranges are half-open for the transform
+  *     discrete_flag    - evaluate each frame of a range individually
+  *
+  * THROWS:
+  *     MalformedException - parse error; the input is malformed
+  *     OverflowException  - the magnitude of a parsed integer is too large
+  *                            to handle
+  *     BadValueException  - a range is reversed
+  */
 void RemapFramesParser::parseTransform (std::string &result, const Calc &calc, bool hopen_flag, bool discrete_flag) 
 throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
 {
@@ -751,7 +1041,7 @@ throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
     bool matched;
     const char *delim_0 = "";
 
-    result.clear ();
+    std::vector <transform_item_t> item_list;
 
     while (readLine())
     {
@@ -764,8 +1054,8 @@ throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
 
             if (matchInt(&i))
             {
-                result += delim_0;
-                result += map_range (calc, hopen_flag, discrete_flag, i, i);
+                range.start = i;
+                range.end   = i;
                 matched = true;
             }
             else if (matchRange(&range))
@@ -774,13 +1064,13 @@ throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
                 {
                     throw BadValueException(range.end);
                 }
-                result += delim_0;
-                result += map_range (calc, hopen_flag, discrete_flag, range.start, range.end);
                 matched = true;
             }
 
             if (matched)
             {
+                const transform_item_t  item = { delim_0, range };
+                item_list.push_back (item);
                 delim_0 = " ";
             }
             else
@@ -797,6 +1087,127 @@ throw(std::bad_alloc, MalformedException, OverflowException, BadValueException)
 
         ++pos.line;
     }
+
+    map_range_list (result, item_list, calc, hopen_flag, discrete_flag);
+}
+
+
+
+/** map_range_list
+  *
+  *     Maps every item of <item_list> through <calc> and concatenates the
+  *     results, each one preceded by its delimiter.
+  *
+  *     Items are independent of each other, so large lists are split into
+  *     contiguous chunks evaluated on worker threads. <calc> is only read.
+  *     The chunks no thread could be started for are mapped in the
+  *     calling thread.
+  */
+void RemapFramesParser::map_range_list (std::string &result, const std::vector <transform_item_t> &item_list, const Calc &calc, bool hopen_flag, bool discrete_flag)
+{
+    const size_t    nbr_items = item_list.size ();
+    std::vector <std::string> mapped_list (nbr_items);
+
+    // Estimates the number of evaluations to decide whether threads are
+    // worth starting.
+    long long       work = 0;
+    for (size_t k = 0; k < nbr_items; ++k)
+    {
+        const range_t & r = item_list [k].range;
+        work += discrete_flag ? (long long) (r.end) - r.start + 1 : 2;
+    }
+
+    const long long min_work_per_thread = 4096;
+    const long long max_threads = std::max (int (std::thread::hardware_concurrency ()), 1);
+    const int       nbr_threads = int (std::min (
+        max_threads,
+        std::min ((long long) (nbr_items), work / min_work_per_thread)
+    ));
+
+    auto            map_chunk = [&] (size_t beg, size_t end)
+    {
+        for (size_t k = beg; k < end; ++k)
+        {
+            const range_t & r = item_list [k].range;
+            mapped_list [k] = map_range (calc, hopen_flag, discrete_flag, r.start, r.end);
+        }
+    };
+
+    if (nbr_threads <= 1)
+    {
+        map_chunk (0, nbr_items);
+    }
+    else
+    {
+        // Chunks are balanced on item count, which is good enough since
+        // a single huge range can't be split anyway.
+        // Reserved up front so push_back() can't throw with a started
+        // thread in hand.
+        std::vector <std::thread> thread_list;
+        thread_list.reserve (nbr_threads);
+        std::vector <char>        fail_list (nbr_threads, 0);
+        const size_t    chunk = (nbr_items + nbr_threads - 1) / nbr_threads;
+        size_t          serial_beg = nbr_items;
+        for (int t = 0; t < nbr_threads; ++t)
+        {
+            const size_t    beg = std::min (nbr_items, chunk * t);
+            const size_t    end = std::min (nbr_items, beg + chunk);
+            try
+            {
+                thread_list.push_back (std::thread ([&, beg, end, t] ()
+                {
+                    try
+                    {
+                        map_chunk (beg, end);
+                    }
+                    catch (...)
+                    {
+                        fail_list [t] = 1;
+                    }
+                }));
+            }
+            catch (const std::system_error &)
+            {
+                // No more threads: the remaining chunks are mapped here.
+                serial_beg = beg;
+                break;
+            }
+        }
+
+        // The started threads must be joined whatever happens here.
+        bool            serial_fail_flag = false;
+        try
+        {
+            map_chunk (serial_beg, nbr_items);
+        }
+        catch (...)
+        {
+            serial_fail_flag = true;
+        }
+        for (size_t t = 0; t < thread_list.size (); ++t)
+        {
+            thread_list [t].join ();
+        }
+        if (   serial_fail_flag
+            || std::find (fail_list.begin (), fail_list.end (), 1) != fail_list.end ())
+        {
+            throw std::bad_alloc ();
+        }
+    }
+
+    size_t          len = 0;
+    for (size_t k = 0; k < nbr_items; ++k)
+    {
+        len += strlen (item_list [k].delim_0) + mapped_list [k].length ();
+    }
+
+    result.clear ();
+    result.reserve (len);
+    for (size_t k = 0; k < nbr_items; ++k)
+    {
+        result += item_list [k].delim_0;
+        result += mapped_list [k];
+    }
 }
 
 
@@ -901,3 +1312,38 @@ void    RemapFramesParser::append_range (std::string &range_str, int beg, int en
 
 
 
+static bool range_start_less (const RemapFramesParser::range_t &a, const RemapFramesParser::range_t &b)
+{
+    return (a.start < b.start);
+}
+
+
+
+/** merge_ranges
+  *
+  *     Builds the canonical form of a set of ranges: sorted, with
+  *     overlapping and adjacent ranges coalesced, on a single line.
+  *
+  * PARAMETERS:
+  *     OUT result        - the canonical range list
+  *     IN/OUT range_list - the ranges to merge; sorted on output
+  */
+void    RemapFramesParser::merge_ranges (std::string &result, std::vector<range_t> &range_list)
+{
+    std::sort (range_list.begin (), range_list.end (), range_start_less);
+
+    result.clear ();
+
+    std::vector<range_t>::const_iterator   it = range_list.begin ();
+    while (it != range_list.end ())
+    {
+        range_t         cur = *it;
+        for (++ it
+        ;   it != range_list.end () && (long long) (it->start) <= (long long) (cur.end) + 1
+        ;   ++ it)
+        {
+            cur.end = std::max (cur.end, it->end);
+        }
+        append_range (result, cur.start, cur.end);
+    }
+}
@@ -37,13 +37,14 @@
 #include <cassert>
 #include <string>
 #include <vector>
-#include "RemapFrames.h"
+#include "FrameMap.h"
 
 
 
 // CLASS PROTOTYPES ----------------------------------------------------
 
 class Calc;
+struct Kernels;
 
 class RemapFramesParser
 {
@@ -57,8 +58,14 @@ public:
         BadValueException(int val_) : val(val_) { }
     };
 
-    RemapFramesParser(FILE* fileP, std::vector<MapIndex>* indicesP, int max_, bool tol_flag);
-    RemapFramesParser(const char* mappingsP, std::vector<MapIndex>* indicesP, int max_, bool tol_flag);
+    typedef struct
+    {
+        int start;
+        int end;
+    } range_t;
+
+    RemapFramesParser(FILE* fileP, FrameMap* mapP, int max_, bool tol_flag, const Kernels& kernels);
+    RemapFramesParser(const char* mappingsP, FrameMap* mapP, int max_, bool tol_flag, const Kernels& kernels);
 
     void getPos(unsigned int* lineP, unsigned int* colP) const throw();
     unsigned int getLineNumber() const throw();
@@ -72,6 +79,10 @@ public:
         throw(std::bad_alloc, MalformedException, OverflowException, BadValueException);
     void parseTransform(std::string &result, const Calc &calc, bool hopen_flag, bool discrete_flag)
         throw(std::bad_alloc, MalformedException, OverflowException, BadValueException);
+    void parseRangeList(std::vector<range_t> &range_list)
+        throw(std::bad_alloc, MalformedException, OverflowException, BadValueException);
+
+    static void merge_ranges (std::string &result, std::vector<range_t> &range_list);
 
 private:
     typedef enum { MODE_FILE, MODE_DIRECT } mode_t;
@@ -86,14 +97,8 @@ private:
         const char* mappingsP;
     } input;
 
-    typedef struct
-    {
-        int start;
-        int end;
-    } range_t;
-
     // stores the rearranged frame indices
-    std::vector<MapIndex>* indicesP;
+    FrameMap* mapP;
 
     int f_max;
 
@@ -103,18 +108,24 @@ private:
     // Indicates that we tolerate (and ignore) frames out of range
     bool _tol_flag;
 
+    // scans the tokens
+    const Kernels* kernelsP;
+
     struct
     {
         // points to the current position within the line
         const char* p;
 
+        // points to the end of the line (its terminating null character)
+        const char* endP;
+
         // the current line and column
         // (the column might not be accurate)
         unsigned int line;
         unsigned int col;
     } pos;
 
-    void init(std::vector<MapIndex>* indicesP_, int max_) throw();
+    void init(FrameMap* mapP_, int max_, const Kernels& kernels) throw();
 
     void setPos() throw();
 
@@ -128,12 +139,25 @@ private:
     bool matchChar(char c) throw();
     bool matchInt(int* valP) throw(OverflowException);
     bool matchRange(range_t* rangeP) throw();
+    bool matchStepRange(range_t* rangeP, int* stepP) throw(OverflowException);
+    bool matchBlank() throw();
+
+    void setFrame(int i, int j) throw(std::bad_alloc, BadValueException);
+    void appendFrame(int j) throw(std::bad_alloc, BadValueException);
+    void appendRange(const range_t& range, int step) throw(std::bad_alloc, BadValueException);
+    void fillRange(const range_t& rangeIn, int j) throw(std::bad_alloc, BadValueException);
+    void setRange(const range_t& rangeIn, const range_t& rangeOut) throw(std::bad_alloc, BadValueException);
+    void blankRange(const range_t& rangeIn) throw(std::bad_alloc, BadValueException);
+    void appendBlank() throw(std::bad_alloc);
 
-    void setFrame(int i, int j) throw(BadValueException);
-    void appendFrame(int j) throw(BadValueException);
-    void fillRange(const range_t& rangeIn, int j) throw(BadValueException);
-    void setRange(const range_t& rangeIn, const range_t& rangeOut) throw(BadValueException);
+    typedef struct
+    {
+        // text inserted before the mapped range
+        const char* delim_0;
+        range_t range;
+    } transform_item_t;
 
+    static void map_range_list (std::string &result, const std::vector <transform_item_t> &item_list, const Calc &calc, bool hopen_flag, bool discrete_flag);
     static std::string map_range (const Calc &calc, bool hopen_flag, bool discrete_flag, int beg, int end);
     static void append_range (std::string &range_str, int beg, int end);
 };
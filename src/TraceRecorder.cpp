@@ -0,0 +1,283 @@
+/** TraceRecorder
+  *     Binary log of the frame and audio requests made to a filter
+  *     instance and of the requests it makes to its clips.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#include "TraceRecorder.h"
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const char traceMagic[8] = { 'R', 'F', 'T', 'R', 'A', 'C', 'E', '1' };
+
+// Number of recorders a thread remembers its buffer for without locking
+static const int NBR_SLOTS = 4;
+
+
+
+// GLOBALS -------------------------------------------------------------
+
+static std::atomic<unsigned int> lastSerial(0);
+
+// Buffers of the current thread in the last recorders it used
+struct TraceSlot
+{
+    unsigned int serial;
+    void* bufferP;
+};
+static thread_local TraceSlot traceSlots[NBR_SLOTS];
+static thread_local int nextTraceSlot = 0;
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** create
+  *
+  *     Creates a trace file and its recorder.
+  *
+  * PARAMETERS:
+  *     IN filenameP - the name of the file; overwritten if it exists
+  *     IN clips     - the clips of the traced filter, indexed by
+  *                      OUTPUT_CLIP, BASE_CLIP and SOURCE_CLIP
+  *     flags        - the header flags
+  *
+  * RETURNS:
+  *     the new recorder, or NULL if the file could not be created
+  */
+TraceRecorder* TraceRecorder::create(const char* filenameP, const ClipInfo clips[NBR_CLIPS], int flags)
+{
+    FILE* fileP = fopen(filenameP, "wb");
+    if (fileP == NULL)
+    {
+        return NULL;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, traceMagic, sizeof header.magic);
+    header.version = VERSION;
+    header.recordSize = sizeof (Record);
+    header.flags = flags;
+    std::copy(clips, clips + NBR_CLIPS, header.clips);
+
+    if (fwrite(&header, sizeof header, 1, fileP) != 1)
+    {
+        fclose(fileP);
+        return NULL;
+    }
+
+    return new TraceRecorder(fileP, ++lastSerial);
+}
+
+
+/** describe
+  *
+  * RETURNS:
+  *     the header description of a clip
+  */
+TraceRecorder::ClipInfo TraceRecorder::describe(const VideoInfo& vi) throw()
+{
+    ClipInfo info;
+    memset(&info, 0, sizeof info);
+    info.width = vi.width;
+    info.height = vi.height;
+    info.pixelType = vi.pixel_type;
+    info.numFrames = vi.num_frames;
+    info.fpsNumerator = vi.fps_numerator;
+    info.fpsDenominator = vi.fps_denominator;
+    info.audioRate = vi.audio_samples_per_second;
+    info.channels = vi.nchannels;
+    info.sampleType = vi.sample_type;
+    info.numAudioSamples = vi.num_audio_samples;
+    return info;
+}
+
+
+/** load
+  *
+  *     Reads a trace file.
+  *
+  * PARAMETERS:
+  *     IN filenameP - the name of the file
+  *     OUT headerP  - receives the header
+  *     OUT recordsP - receives the records, sorted on time
+  *
+  * RETURNS:
+  *     false if the file can't be read or isn't a trace of this version
+  */
+bool TraceRecorder::load(const char* filenameP, Header* headerP, std::vector<Record>* recordsP)
+{
+    FILE* fileP = fopen(filenameP, "rb");
+    if (fileP == NULL)
+    {
+        return false;
+    }
+
+    bool okFlag = (   fread(headerP, sizeof *headerP, 1, fileP) == 1
+                   && memcmp(headerP->magic, traceMagic, sizeof traceMagic) == 0
+                   && headerP->version == VERSION
+                   && headerP->recordSize == sizeof (Record));
+
+    recordsP->clear();
+    Record record;
+    while (okFlag && fread(&record, sizeof record, 1, fileP) == 1)
+    {
+        recordsP->push_back(record);
+    }
+    okFlag = okFlag && !ferror(fileP);
+    fclose(fileP);
+
+    std::stable_sort(recordsP->begin(), recordsP->end(),
+                     [](const Record& a, const Record& b) { return a.time < b.time; });
+
+    return okFlag;
+}
+
+
+/** TraceRecorder constructor
+  *
+  * PARAMETERS:
+  *     IN/OUT fileP_ - the trace file, with the header written; closed
+  *                       by the destructor
+  *     serial_       - the unique identifier of the recorder; > 0
+  */
+TraceRecorder::TraceRecorder(FILE* fileP_, unsigned int serial_)
+: serial(serial_),
+  start(std::chrono::steady_clock::now()),
+  mutex(),
+  fileP(fileP_),
+  buffers(),
+  threadBuffers()
+{
+}
+
+
+/** TraceRecorder destructor
+  *
+  *     Writes the records left in the buffers. No thread may be recording
+  *     anymore.
+  */
+TraceRecorder::~TraceRecorder()
+{
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        flush(*buffers[i]);
+    }
+    fclose(fileP);
+}
+
+
+/** record
+  *
+  *     Appends a record to the buffer of the calling thread. Records are
+  *     dropped if the buffer can't be allocated.
+  *
+  * PARAMETERS:
+  *     type      - the kind of call
+  *     clipIndex - the clip called, for the child calls; -1 otherwise
+  *     arg0      - the frame, or the first sample
+  *     arg1      - the number of samples; 0 for the frames
+  */
+void TraceRecorder::record(Type type, int clipIndex, int64_t arg0, int64_t arg1) throw()
+{
+    const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+    Buffer* bufferP = findBuffer();
+    if (bufferP == NULL)
+    {
+        return;
+    }
+
+    Record& rec = bufferP->records[bufferP->used];
+    rec.time = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    rec.arg0 = arg0;
+    rec.arg1 = arg1;
+    rec.type = short (type);
+    rec.clipIndex = short (clipIndex);
+    rec.thread = bufferP->thread;
+
+    if (++bufferP->used == BUFFER_RECORDS)
+    {
+        flush(*bufferP);
+    }
+}
+
+
+/** findBuffer
+  *
+  * RETURNS:
+  *     the buffer of the calling thread, created on its first record;
+  *     NULL if it can't be allocated
+  */
+TraceRecorder::Buffer* TraceRecorder::findBuffer() throw()
+{
+    for (int i = 0; i < NBR_SLOTS; ++i)
+    {
+        if (traceSlots[i].serial == serial)
+        {
+            return static_cast<Buffer*>(traceSlots[i].bufferP);
+        }
+    }
+
+    // First record of the thread, or its slot was taken by other
+    // recorders since. A thread identifier reused after the end of a
+    // thread gets the buffer of the ended thread.
+    Buffer* bufferP = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::thread::id id = std::this_thread::get_id();
+        std::unordered_map<std::thread::id, Buffer*>::const_iterator it = threadBuffers.find(id);
+        if (it != threadBuffers.end())
+        {
+            bufferP = it->second;
+        }
+        else
+        {
+            try
+            {
+                std::unique_ptr<Buffer> newP(new Buffer);
+                newP->thread = int (buffers.size());
+                newP->used = 0;
+                buffers.push_back(std::move(newP));
+                bufferP = buffers.back().get();
+                threadBuffers[id] = bufferP;
+            }
+            catch (const std::bad_alloc&)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    TraceSlot& slot = traceSlots[nextTraceSlot];
+    nextTraceSlot = (nextTraceSlot + 1) % NBR_SLOTS;
+    slot.serial = serial;
+    slot.bufferP = bufferP;
+
+    return bufferP;
+}
+
+
+/** flush
+  *
+  *     Writes the records of a buffer to the file and empties it. Write
+  *     errors are ignored: the trace is then truncated.
+  */
+void TraceRecorder::flush(Buffer& buffer) throw()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffer.used > 0)
+    {
+        fwrite(buffer.records, sizeof (Record), buffer.used, fileP);
+        buffer.used = 0;
+    }
+}
@@ -0,0 +1,124 @@
+/** TraceRecorder
+  *     Binary log of the frame and audio requests made to a filter
+  *     instance and of the requests it makes to its clips, for replaying
+  *     real-world access patterns offline (see tools/replay).
+  *
+  *     Each thread appends to its own buffer without locking; full buffers
+  *     are written to the file under a mutex. The file is therefore
+  *     ordered by thread chunks, not by time: load() sorts the records.
+  */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <avisynth.h>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class TraceRecorder
+{
+public:
+    enum Type
+    {
+        GET_FRAME,      // GetFrame(arg0) on the filter
+        GET_AUDIO,      // GetAudio(arg0, arg1) on the filter
+        CHILD_FRAME,    // GetFrame(arg0) on clip <clipIndex>
+        CHILD_AUDIO     // GetAudio(arg0, arg1) on clip <clipIndex>
+    };
+
+    // Indices of ClipInfo in the header
+    enum { OUTPUT_CLIP, BASE_CLIP, SOURCE_CLIP, NBR_CLIPS };
+
+    enum { VERSION = 1 };
+
+    // Header flags
+    enum { SOURCE_IS_BASE = 1 };    // the source clip is the base clip
+
+    // 32 bytes, in the byte order of the recording host
+    struct Record
+    {
+        int64_t time;       // nanoseconds since the recorder creation
+        int64_t arg0;       // frame, or first sample
+        int64_t arg1;       // number of samples; 0 for the frames
+        short type;
+        short clipIndex;    // MapIndex::clipIndex; -1 for the requests
+        int thread;         // threads numbered from 0 in order of appearance
+    };
+
+    // The part of VideoInfo a mock clip needs to stand in for a clip
+    struct ClipInfo
+    {
+        int width;
+        int height;
+        int pixelType;
+        int numFrames;
+        unsigned int fpsNumerator;
+        unsigned int fpsDenominator;
+        int audioRate;
+        int channels;
+        int sampleType;
+        int reserved;
+        int64_t numAudioSamples;
+    };
+
+    struct Header
+    {
+        char magic[8];      // "RFTRACE1"
+        int version;
+        int recordSize;
+        int flags;
+        int reserved;
+        ClipInfo clips[NBR_CLIPS];
+    };
+
+    static TraceRecorder* create(const char* filenameP, const ClipInfo clips[NBR_CLIPS], int flags);
+    static ClipInfo describe(const VideoInfo& vi) throw();
+    static bool load(const char* filenameP, Header* headerP, std::vector<Record>* recordsP);
+
+    ~TraceRecorder();
+
+    void record(Type type, int clipIndex, int64_t arg0, int64_t arg1) throw();
+
+private:
+    enum { BUFFER_RECORDS = 4096 };
+
+    struct Buffer
+    {
+        int thread;
+        int used;
+        Record records[BUFFER_RECORDS];
+    };
+
+    // distinguishes the recorders in the per-thread lookup, even when
+    // one is allocated at the address of a deleted one
+    const unsigned int serial;
+
+    const std::chrono::steady_clock::time_point start;
+
+    // guards <fileP>, <buffers> and <threadBuffers>
+    std::mutex mutex;
+    FILE* fileP;
+    std::vector<std::unique_ptr<Buffer> > buffers;
+    std::unordered_map<std::thread::id, Buffer*> threadBuffers;
+
+    TraceRecorder(FILE* fileP_, unsigned int serial_);
+
+    Buffer* findBuffer() throw();
+    void flush(Buffer& buffer) throw();
+
+    TraceRecorder(const TraceRecorder&);
+    TraceRecorder& operator=(const TraceRecorder&);
+};
+
+
+#endif // TRACERECORDER_H
@@ -0,0 +1,183 @@
+/** WorkerPool
+  *     Fixed set of threads running the tasks of one batch at a time.
+  */
+
+#pragma warning (4 : 4290)
+
+#include <cassert>
+
+#include "WorkerPool.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** WorkerPool constructor
+  *
+  * PARAMETERS:
+  *     nbrThreads - the number of threads running the tasks, including
+  *                    the thread calling run(); must be > 0
+  */
+WorkerPool::WorkerPool(int nbrThreads)
+: runMutex(),
+  mutex(),
+  workCond(),
+  doneCond(),
+  taskP(NULL),
+  nbrTasks(0),
+  nextTask(0),
+  nbrDone(0),
+  errorP(),
+  stopFlag(false),
+  workers()
+{
+    assert(nbrThreads > 0);
+
+    workers.reserve(nbrThreads - 1);
+    for (int i = 1; i < nbrThreads; ++i)
+    {
+        workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+
+/** WorkerPool destructor
+  */
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+    workCond.notify_all();
+
+    for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+    {
+        it->join();
+    }
+}
+
+
+/** getNbrThreads
+  *
+  * RETURNS:
+  *     the number of threads running the tasks, including the caller
+  */
+int WorkerPool::getNbrThreads() const throw()
+{
+    return int (workers.size()) + 1;
+}
+
+
+/** run
+  *
+  *     Runs task(0) .. task(nbrTasks - 1) on the pool and the calling
+  *     thread, and waits for their completion. If the pool is already
+  *     running a batch for another caller, the tasks are run in the
+  *     calling thread instead of waiting for it.
+  *
+  * PARAMETERS:
+  *     nbrTasks - the number of tasks
+  *     IN task  - the task body, given the task index
+  *
+  * THROWS:
+  *     the first exception thrown by a task, once all the tasks are done
+  */
+void WorkerPool::run(int nbrTasks_, const std::function<void (int)>& task)
+{
+    std::unique_lock<std::mutex> runLock(runMutex, std::try_to_lock);
+    if (!runLock.owns_lock())
+    {
+        for (int i = 0; i < nbrTasks_; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    taskP = &task;
+    nbrTasks = nbrTasks_;
+    nextTask = 0;
+    nbrDone = 0;
+    errorP = std::exception_ptr();
+    workCond.notify_all();
+
+    runTasks(lock);
+
+    while (nbrDone < nbrTasks)
+    {
+        doneCond.wait(lock);
+    }
+    taskP = NULL;
+
+    if (errorP)
+    {
+        std::exception_ptr e = errorP;
+        errorP = std::exception_ptr();
+        std::rethrow_exception(e);
+    }
+}
+
+
+/** runTasks
+  *
+  *     Runs tasks of the current batch until none is left to start.
+  *
+  * PARAMETERS:
+  *     IN/OUT lock - lock on <mutex>; locked on input and output
+  */
+void WorkerPool::runTasks(std::unique_lock<std::mutex>& lock)
+{
+    while (taskP != NULL && nextTask < nbrTasks)
+    {
+        const std::function<void (int)>& task = *taskP;
+        const int i = nextTask++;
+        lock.unlock();
+
+        std::exception_ptr e;
+        try
+        {
+            task(i);
+        }
+        catch (...)
+        {
+            e = std::current_exception();
+        }
+
+        lock.lock();
+        if (e && !errorP)
+        {
+            errorP = e;
+        }
+        ++nbrDone;
+        if (nbrDone == nbrTasks)
+        {
+            doneCond.notify_all();
+        }
+    }
+}
+
+
+/** workerLoop
+  *
+  *     Worker thread body.
+  */
+void WorkerPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;)
+    {
+        while (!stopFlag && (taskP == NULL || nextTask >= nbrTasks))
+        {
+            workCond.wait(lock);
+        }
+        if (stopFlag)
+        {
+            return;
+        }
+
+        runTasks(lock);
+    }
+}
@@ -0,0 +1,55 @@
+/** WorkerPool
+  *     Fixed set of threads running the tasks of one batch at a time.
+  */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int nbrThreads);
+    ~WorkerPool();
+
+    int getNbrThreads() const throw();
+
+    void run(int nbrTasks, const std::function<void (int)>& task);
+
+private:
+    // serializes the batches
+    std::mutex runMutex;
+
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+
+    // current batch; <taskP> is NULL between batches
+    const std::function<void (int)>* taskP;
+    int nbrTasks;
+    int nextTask;
+    int nbrDone;
+    std::exception_ptr errorP;
+
+    bool stopFlag;
+    std::vector<std::thread> workers;
+
+    void runTasks(std::unique_lock<std::mutex>& lock);
+    void workerLoop();
+
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+};
+
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,789 @@
+/** RemapFramesBench
+  *     Benchmarks the filters of the plug-in on mock clips and prints the
+  *     results as CSV, one measure per line, for tracking regressions.
+  *
+  *     usage: RemapFramesBench [switches]
+  *
+  *     switches:
+  *         -quick          small clips and mappings, for a smoke run
+  *         -frames n       length of the clips, in frames
+  *         -channels list  channel counts of the audio cases; comma-separated
+  *         -tokens list    sizes of the generated mappings of the parser
+  *                           cases, in numbers; comma-separated
+  *         -threads n      threads of the concurrent case; 0 for one per
+  *                           processor
+  *         -cpu name       kernels of the filters and the parser: scalar,
+  *                           sse2, avx2 or avx512; the best ones the
+  *                           processor runs by default
+  *         -o file         writes the CSV to <file> instead of stdout
+  *
+  *     Cases:
+  *         audio       GetAudio throughput over the whole output, in
+  *                       samples per second, for forward, reverse and
+  *                       dense-cut mappings, with and without blending
+  *         frame       GetFrame latency on a dense-cut mapping, in
+  *                       sequential and random order; and on a reversed
+  *                       mapping with a GOP length, each GOP of which
+  *                       must be warmed up once
+  *         parse       parser throughput on generated mappings, in
+  *                       numbers per second
+  *         transform   rfs_transform throughput on generated ranges, in
+  *                       numbers per second, in open and discrete modes;
+  *                       and the parsing and evaluation rates of its
+  *                       operation alone
+  *         stacked     GetAudio throughput and GetFrame latency of 1 to 4
+  *                       stacked RemapFramesSimple filters; the video of
+  *                       a stack is fused into one lookup, the audio is
+  *                       not; and the GetFrame latency of two filters the
+  *                       inner one of which tags its frames (frameProps),
+  *                       so is not fused; the tags are checked
+  *         concurrent  GetFrame and GetAudio called from several threads
+  *                       at once on one filter; the audio is checked
+  *                       against a single-threaded rendering
+  *
+  *     Parsing 100M numbers takes about 2 GB of memory.
+  */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MockAvisynth.h"
+#include "Calc.h"
+#include "FrameMap.h"
+#include "Kernels.h"
+#include "RemapFramesParser.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+extern "C" const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors);
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+// Settings of a run
+struct Settings
+{
+    int frames;
+    std::vector<int> channels;
+    std::vector<long long> tokens;
+    int threads;
+    Kernels::level_t level;
+    FILE* outP;
+};
+
+
+// Mapping of an audio or frame case
+struct MappingCase
+{
+    const char* name;
+    std::string mappings;
+};
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const int AUDIO_RATE = 48000;
+static const int FPS = 25;
+static const int BLEND_SAMPLES = 64;
+static const int AUDIO_BLOCK = 4096;
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: RemapFramesBench [-quick] [-frames n] [-channels list] [-tokens list]\n"
+            "                        [-threads n] [-cpu name] [-o file]\n");
+    exit(2);
+}
+
+
+// Parses a comma-separated list of numbers
+static std::vector<long long> parseList(const char* textP)
+{
+    std::vector<long long> values;
+    for (const char* p = textP; *p != '\0'; )
+    {
+        char* endP;
+        values.push_back(strtoll(p, &endP, 10));
+        if (endP == p || values.back() <= 0)
+        {
+            usage();
+        }
+        p = (*endP == ',') ? endP + 1 : endP;
+    }
+    return values;
+}
+
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+// Prints a CSV line
+static void report(const Settings& settings, const char* benchmark, const char* mapping, int blend,
+                   int channels, int threads, long long items, double seconds, double value, const char* unit)
+{
+    fprintf(settings.outP, "%s,%s,%d,%d,%d,%lld,%.6f,%.6g,%s\n",
+            benchmark, mapping, blend, channels, threads, items, seconds, value, unit);
+    fflush(settings.outP);
+}
+
+
+/** makeMappings
+  *
+  * RETURNS:
+  *     the RemapFrames mappings of the audio and frame cases, for clips
+  *     of <frames> frames: the base clip shifted by one frame, reversed,
+  *     and each frame taken from a pseudo-random source frame, so that
+  *     every frame boundary is a cut
+  */
+static std::vector<MappingCase> makeMappings(int frames)
+{
+    std::vector<MappingCase> cases(3);
+    char line[64];
+
+    cases[0].name = "forward";
+    sprintf(line, "[0 %d] [1 %d]", frames - 2, frames - 1);
+    cases[0].mappings = line;
+
+    cases[1].name = "reverse";
+    sprintf(line, "[0 %d] [%d 0]", frames - 1, frames - 1);
+    cases[1].mappings = line;
+
+    cases[2].name = "dense-cut";
+    std::mt19937 rng(1);
+    for (int i = 0; i < frames; ++i)
+    {
+        sprintf(line, "%d %d\n", i, int (rng() % unsigned (frames)));
+        cases[2].mappings += line;
+    }
+
+    return cases;
+}
+
+
+// Builds a RemapFrames filter on <baseClip>, taking its frames from
+// <sourceClip>
+static PClip makeFilter(const Settings& settings, ScriptEnvironment& env, const PClip& baseClip,
+                        const PClip& sourceClip, const std::string& mappings, int blend)
+{
+    const AVSValue args[] = { baseClip, mappings.c_str(), sourceClip, blend, Kernels::get(settings.level, 0).nameP };
+    const char* const names[] = { NULL, "mappings", "sourceClip", "audioBlendSamples", "cpu" };
+    return env.Invoke("RemapFrames", AVSValue(args, 5), names).AsClip();
+}
+
+
+/** benchAudio
+  *
+  *     Reads the whole output audio in blocks, for each mapping, blending
+  *     setting and channel count.
+  */
+static void benchAudio(const Settings& settings, ScriptEnvironment& env, const std::vector<MappingCase>& mappings)
+{
+    for (size_t c = 0; c < settings.channels.size(); ++c)
+    {
+        const int channels = settings.channels[c];
+        const PClip baseClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                    FPS, 1, AUDIO_RATE, channels), 0);
+        const PClip sourceClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                      FPS, 1, AUDIO_RATE, channels), 1);
+        std::vector<SFLOAT> samples(size_t(AUDIO_BLOCK) * channels);
+
+        for (size_t m = 0; m < mappings.size(); ++m)
+        {
+            for (int blend = 0; blend <= BLEND_SAMPLES; blend += BLEND_SAMPLES)
+            {
+                const PClip clip = makeFilter(settings, env, baseClip, sourceClip, mappings[m].mappings, blend);
+                const int64_t total = clip->GetVideoInfo().num_audio_samples;
+
+                const Clock::time_point start = Clock::now();
+                for (int64_t pos = 0; pos < total; pos += AUDIO_BLOCK)
+                {
+                    clip->GetAudio(samples.data(), pos, std::min(int64_t (AUDIO_BLOCK), total - pos), &env);
+                }
+                const double seconds = secondsSince(start);
+
+                report(settings, "audio", mappings[m].name, blend, channels, 1, total, seconds,
+                       total / seconds, "samples/s");
+            }
+        }
+    }
+}
+
+
+/** benchFrames
+  *
+  *     Fetches every output frame of the dense-cut mapping, in order and
+  *     in a random order. The mock clips make frames of 64x64 pixels, so
+  *     the lookup and the frame handling dominate.
+  */
+static void benchFrames(const Settings& settings, ScriptEnvironment& env, const MappingCase& mapping)
+{
+    const PClip baseClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                FPS, 1, 0, 0), 0);
+    const PClip sourceClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                  FPS, 1, 0, 0), 1);
+    const PClip clip = makeFilter(settings, env, baseClip, sourceClip, mapping.mappings, 0);
+
+    std::vector<int> order(settings.frames);
+    for (int i = 0; i < settings.frames; ++i)
+    {
+        order[i] = i;
+    }
+
+    for (int randomFlag = 0; randomFlag < 2; ++randomFlag)
+    {
+        if (randomFlag)
+        {
+            std::shuffle(order.begin(), order.end(), std::mt19937(2));
+        }
+
+        const Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            clip->GetFrame(order[i], &env);
+        }
+        const double seconds = secondsSince(start);
+
+        report(settings, randomFlag ? "frame-random" : "frame-sequential", mapping.name, 0, 0, 1,
+               settings.frames, seconds, seconds * 1e9 / settings.frames, "ns/frame");
+    }
+}
+
+
+/** benchStacked
+  *
+  *     Reads the whole output audio and every frame of stacks of 1 to
+  *     <MAX_DEPTH> RemapFramesSimple filters, each one rotating the
+  *     frames of the one below by a frame.
+  */
+static void benchStacked(const Settings& settings, ScriptEnvironment& env)
+{
+    const int MAX_DEPTH = 4;
+
+    const int channels = settings.channels.front();
+    const PClip baseClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                FPS, 1, AUDIO_RATE, channels), 0);
+    char mappings[64];
+    sprintf(mappings, "[1 %d] 0", settings.frames - 1);
+    std::vector<SFLOAT> samples(size_t(AUDIO_BLOCK) * channels);
+
+    for (int blend = 0; blend <= BLEND_SAMPLES; blend += BLEND_SAMPLES)
+    {
+        PClip clip = baseClip;
+        for (int depth = 1; depth <= MAX_DEPTH; ++depth)
+        {
+            const AVSValue args[] = { clip, mappings, blend, Kernels::get(settings.level, 0).nameP };
+            const char* const names[] = { NULL, "mappings", "audioBlendSamples", "cpu" };
+            clip = env.Invoke("RemapFramesSimple_AudioMod", AVSValue(args, 4), names).AsClip();
+
+            char name[32];
+            sprintf(name, "depth%d", depth);
+            const int64_t total = clip->GetVideoInfo().num_audio_samples;
+
+            Clock::time_point start = Clock::now();
+            for (int64_t pos = 0; pos < total; pos += AUDIO_BLOCK)
+            {
+                clip->GetAudio(samples.data(), pos, std::min(int64_t (AUDIO_BLOCK), total - pos), &env);
+            }
+            double seconds = secondsSince(start);
+            report(settings, "stacked-audio", name, blend, channels, 1, total, seconds,
+                   total / seconds, "samples/s");
+
+            if (blend != 0)
+            {
+                continue;
+            }
+            start = Clock::now();
+            for (int n = 0; n < settings.frames; ++n)
+            {
+                clip->GetFrame(n, &env);
+            }
+            seconds = secondsSince(start);
+            report(settings, "stacked-frame", name, 0, 0, 1, settings.frames, seconds,
+                   seconds * 1e9 / settings.frames, "ns/frame");
+        }
+    }
+}
+
+
+/** benchStackedProps
+  *
+  *     Fetches every frame of two stacked RemapFramesSimple filters, each
+  *     one rotating the frames of the one below by a frame, the inner
+  *     one with frameProps. The outer one must not be fused with it, so
+  *     its frames carry the tags of the inner one.
+  *
+  * RETURNS:
+  *     the number of frames without the expected tags
+  */
+static int benchStackedProps(const Settings& settings, ScriptEnvironment& env)
+{
+    const int frames = settings.frames;
+    const PClip baseClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, frames,
+                                                                FPS, 1, 0, 0), 0);
+    char mappings[64];
+    sprintf(mappings, "[1 %d] 0", frames - 1);
+
+    const AVSValue innerArgs[] = { baseClip, mappings, true, Kernels::get(settings.level, 0).nameP };
+    const char* const innerNames[] = { NULL, "mappings", "frameProps", "cpu" };
+    const PClip inner = env.Invoke("RemapFramesSimple_AudioMod", AVSValue(innerArgs, 4), innerNames).AsClip();
+    const AVSValue outerArgs[] = { inner, mappings, Kernels::get(settings.level, 0).nameP };
+    const char* const outerNames[] = { NULL, "mappings", "cpu" };
+    const PClip clip = env.Invoke("RemapFramesSimple_AudioMod", AVSValue(outerArgs, 3), outerNames).AsClip();
+
+    int untagged = 0;
+    const Clock::time_point start = Clock::now();
+    for (int n = 0; n < frames; ++n)
+    {
+        const PVideoFrame frame = clip->GetFrame(n, &env);
+        int error = 0;
+        const int64_t source = env.propGetInt(env.getFramePropsRO(frame), "_RemapSourceFrame", 0, &error);
+        if (error != 0 || source != (n + 2) % frames)
+        {
+            ++untagged;
+        }
+    }
+    const double seconds = secondsSince(start);
+    report(settings, "stacked-frame", "props", 0, 0, 1, frames, seconds,
+           seconds * 1e9 / frames, "ns/frame");
+
+    return untagged;
+}
+
+
+/** benchReverseGop
+  *
+  *     Fetches every frame of a RemapFramesSimple filter playing its clip
+  *     backwards, with the seek smoothing of a long-GOP source. Each GOP
+  *     must be warmed up once, not again at every backward step.
+  *
+  * RETURNS:
+  *     the number of source frame requests over two per output frame
+  */
+static int64_t benchReverseGop(const Settings& settings, ScriptEnvironment& env)
+{
+    const int GOP_LENGTH = 50;
+
+    const int frames = settings.frames;
+    MockClip* const mockP = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, frames,
+                                                                 FPS, 1, 0, 0), 0);
+    const PClip baseClip = mockP;
+    char mappings[64];
+    sprintf(mappings, "[%d 0]", frames - 1);
+
+    const AVSValue args[] = { baseClip, mappings, GOP_LENGTH, Kernels::get(settings.level, 0).nameP };
+    const char* const names[] = { NULL, "mappings", "gop", "cpu" };
+    const PClip clip = env.Invoke("RemapFramesSimple_AudioMod", AVSValue(args, 4), names).AsClip();
+
+    const Clock::time_point start = Clock::now();
+    for (int n = 0; n < frames; ++n)
+    {
+        clip->GetFrame(n, &env);
+    }
+    const double seconds = secondsSince(start);
+    report(settings, "frame-gop", "reverse", 0, 0, 1, frames, seconds,
+           seconds * 1e9 / frames, "ns/frame");
+
+    return std::max(mockP->getFrameCalls() - 2 * int64_t (frames), int64_t (0));
+}
+
+
+/** benchParser
+  *
+  *     Parses generated mappings of each size, in both syntaxes:
+  *     RemapFramesSimple lists of source frames, mostly runs of
+  *     consecutive frames, and RemapFrames lines of single frames and
+  *     ranges.
+  */
+static void benchParser(const Settings& settings)
+{
+    for (size_t t = 0; t < settings.tokens.size(); ++t)
+    {
+        const long long tokens = settings.tokens[t];
+        const int srcFrames = int (std::min(tokens, 1000000LL));
+        std::mt19937 rng(3);
+        char item[64];
+
+        // Simple: 16 numbers per line; a jump every 8 frames on average
+        std::string simple;
+        simple.reserve(size_t(tokens) * 8);
+        int frame = 0;
+        for (long long i = 0; i < tokens; ++i)
+        {
+            frame = (rng() % 8 == 0) ? int (rng() % unsigned (srcFrames)) : (frame + 1) % srcFrames;
+            sprintf(item, (i % 16 == 15) ? "%d\n" : "%d ", frame);
+            simple += item;
+        }
+
+        // Advanced: "a z" and "[a b] [y z]" lines over a base clip of one
+        // frame per number
+        std::string advanced;
+        advanced.reserve(size_t(tokens) * 10);
+        const int baseFrames = int (std::min(tokens, 100000000LL));
+        for (long long i = 0; i < tokens; )
+        {
+            const int a = int (rng() % unsigned (baseFrames));
+            const int y = int (rng() % unsigned (srcFrames));
+            if (rng() % 4 == 0 && i + 4 <= tokens)
+            {
+                sprintf(item, "[%d %d] [%d %d]\n", a, std::min(a + 10, baseFrames - 1),
+                        y, std::min(y + 10, srcFrames - 1));
+                i += 4;
+            }
+            else
+            {
+                sprintf(item, "%d %d\n", a, y);
+                i += 2;
+            }
+            advanced += item;
+        }
+
+        for (int advancedFlag = 0; advancedFlag < 2; ++advancedFlag)
+        {
+            const std::string& text = advancedFlag ? advanced : simple;
+            FrameMap frameMap;
+            if (advancedFlag)
+            {
+                frameMap.initSparse(baseFrames, srcFrames);
+            }
+            else
+            {
+                frameMap.initDense(srcFrames);
+            }
+
+            const Clock::time_point start = Clock::now();
+            try
+            {
+                RemapFramesParser parser(text.c_str(), &frameMap, srcFrames, false, Kernels::get(settings.level, 0));
+                if (advancedFlag)
+                {
+                    parser.parse();
+                }
+                else
+                {
+                    parser.parseSimple();
+                }
+                frameMap.freeze();
+            }
+            catch (...)
+            {
+                fprintf(stderr, "parse: error in the generated mappings\n");
+                exit(1);
+            }
+            const double seconds = secondsSince(start);
+
+            report(settings, "parse", advancedFlag ? "advanced" : "simple", 0, 0, 1,
+                   tokens, seconds, tokens / seconds, "numbers/s");
+            report(settings, "parse-bytes", advancedFlag ? "advanced" : "simple", 0, 0, 1,
+                   (long long) text.size(), seconds, text.size() / seconds / 1e6, "MB/s");
+        }
+    }
+}
+
+
+/** benchTransform
+  *
+  *     Rescales generated rfs_transform range lists of each size from 24
+  *     to 30 fps, in open and discrete modes. Also parses and evaluates
+  *     the operation alone, as rfs_transform does for each boundary or
+  *     frame.
+  */
+static void benchTransform(const Settings& settings, ScriptEnvironment& env)
+{
+    const char* const op = "x 30 * 24 / r +";
+    const int PARSES = 10000;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < PARSES; ++i)
+    {
+        Calc calc;
+        if (calc.parse(op, "xry") != 0)
+        {
+            fprintf(stderr, "transform: cannot parse the operation\n");
+            exit(1);
+        }
+    }
+    double seconds = secondsSince(start);
+    report(settings, "calc-parse", "rescale", 0, 0, 1, PARSES, seconds, PARSES / seconds, "parses/s");
+
+    Calc calc;
+    calc.parse(op, "xry");
+    for (size_t t = 0; t < settings.tokens.size(); ++t)
+    {
+        const long long tokens = settings.tokens[t];
+
+        // The sum keeps the evaluations from being optimized out.
+        double input[3] = { 0, 0, 0 };
+        double sum = 0;
+        start = Clock::now();
+        for (long long i = 0; i < tokens; ++i)
+        {
+            input[0] = double (i);
+            input[1] = double (i & 1);
+            sum += calc.eval(input);
+        }
+        seconds = secondsSince(start);
+        report(settings, "calc-eval", "rescale", 0, 0, 1, tokens, seconds, tokens / seconds, "evals/s");
+        if (sum < 0)
+        {
+            fprintf(stderr, "transform: unexpected result\n");
+        }
+
+        // "[a b]" ranges of 1 to 10 frames, 0 to 9 frames apart
+        std::mt19937 rng(4);
+        std::string ranges;
+        ranges.reserve(size_t(tokens) * 8);
+        char item[32];
+        int frame = 0;
+        for (long long i = 0; i + 2 <= tokens; i += 2)
+        {
+            const int length = int (rng() % 10);
+            sprintf(item, "[%d %d] ", frame, frame + length);
+            ranges += item;
+            frame += length + 1 + int (rng() % 10);
+        }
+
+        for (int discreteFlag = 0; discreteFlag < 2; ++discreteFlag)
+        {
+            const AVSValue args[] = { ranges.c_str(), op, bool (discreteFlag != 0) };
+            const char* const names[] = { "mappings", "op", "discrete" };
+            start = Clock::now();
+            env.Invoke("rfs_transform", AVSValue(args, 3), names);
+            seconds = secondsSince(start);
+
+            report(settings, "transform", discreteFlag ? "discrete" : "open", 0, 0, 1,
+                   tokens, seconds, tokens / seconds, "numbers/s");
+        }
+    }
+}
+
+
+/** benchConcurrent
+  *
+  *     Calls GetFrame and GetAudio at random positions from several
+  *     threads at once on one filter of the dense-cut mapping, with
+  *     blending. Each audio request is compared with the same samples
+  *     rendered beforehand from one thread; any difference fails the run.
+  *
+  * RETURNS:
+  *     the number of mismatching requests
+  */
+static int benchConcurrent(const Settings& settings, ScriptEnvironment& env, const MappingCase& mapping)
+{
+    const int channels = settings.channels.back();
+    const PClip baseClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                FPS, 1, AUDIO_RATE, channels), 0);
+    const PClip sourceClip = new MockClip(MockClip::makeVideoInfo(64, 64, VideoInfo::CS_Y8, settings.frames,
+                                                                  FPS, 1, AUDIO_RATE, channels), 1);
+    const PClip clip = makeFilter(settings, env, baseClip, sourceClip, mapping.mappings, BLEND_SAMPLES);
+    const int64_t total = clip->GetVideoInfo().num_audio_samples;
+
+    // Single-threaded reference, rendered block by block
+    std::vector<SFLOAT> reference(size_t(total) * channels);
+    for (int64_t pos = 0; pos < total; pos += AUDIO_BLOCK)
+    {
+        clip->GetAudio(&reference[size_t(pos) * channels], pos, std::min(int64_t (AUDIO_BLOCK), total - pos), &env);
+    }
+
+    const int nbrThreads = (settings.threads > 0)
+                           ? settings.threads
+                           : std::max(2, int (std::thread::hardware_concurrency()));
+    const int requests = std::max(200, settings.frames / 4);
+    std::atomic<long long> samplesRead(0);
+    std::atomic<int> mismatches(0);
+
+    const Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nbrThreads; ++t)
+    {
+        workers.push_back(std::thread([&, t]() {
+            std::mt19937 rng(100 + t);
+            std::vector<SFLOAT> samples;
+            for (int i = 0; i < requests; ++i)
+            {
+                if (i % 2 == 0)
+                {
+                    clip->GetFrame(int (rng() % unsigned (settings.frames)), &env);
+                    continue;
+                }
+
+                // Requests of up to 8 frames, not aligned on the blocks
+                const int64_t pos = int64_t (rng() % unsigned (total));
+                const int64_t count = std::min(int64_t (1 + rng() % (8 * AUDIO_RATE / FPS)), total - pos);
+                samples.resize(size_t(count) * channels);
+                clip->GetAudio(samples.data(), pos, count, &env);
+                samplesRead += count;
+
+                if (memcmp(samples.data(), &reference[size_t(pos) * channels], samples.size() * sizeof (SFLOAT)) != 0)
+                {
+                    ++mismatches;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+    const double seconds = secondsSince(start);
+
+    const long long calls = (long long) nbrThreads * requests;
+    report(settings, "concurrent-calls", mapping.name, BLEND_SAMPLES, channels, nbrThreads,
+           calls, seconds, calls / seconds, "calls/s");
+    report(settings, "concurrent-audio", mapping.name, BLEND_SAMPLES, channels, nbrThreads,
+           samplesRead.load(), seconds, samplesRead.load() / seconds, "samples/s");
+    report(settings, "concurrent-mismatches", mapping.name, BLEND_SAMPLES, channels, nbrThreads,
+           calls / 2, seconds, mismatches.load(), "requests");
+
+    return mismatches.load();
+}
+
+
+
+// MAIN ----------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    settings.frames = 3000;
+    settings.channels.push_back(2);
+    settings.channels.push_back(6);
+    settings.tokens.push_back(1000000);
+    settings.tokens.push_back(10000000);
+    settings.threads = 0;
+    const char* cpuP = NULL;
+    settings.outP = stdout;
+
+    for (int argi = 1; argi < argc; ++argi)
+    {
+        const std::string name = argv[argi];
+        if (name == "-quick")
+        {
+            settings.frames = 250;
+            settings.tokens.assign(1, 100000);
+        }
+        else if (argi + 1 >= argc)
+        {
+            usage();
+        }
+        else if (name == "-frames")
+        {
+            settings.frames = atoi(argv[++argi]);
+            if (settings.frames < 2)
+            {
+                usage();
+            }
+        }
+        else if (name == "-channels")
+        {
+            const std::vector<long long> values = parseList(argv[++argi]);
+            settings.channels.assign(values.begin(), values.end());
+        }
+        else if (name == "-tokens")
+        {
+            settings.tokens = parseList(argv[++argi]);
+        }
+        else if (name == "-threads")
+        {
+            settings.threads = atoi(argv[++argi]);
+        }
+        else if (name == "-cpu")
+        {
+            cpuP = argv[++argi];
+        }
+        else if (name == "-o")
+        {
+            settings.outP = fopen(argv[++argi], "w");
+            if (settings.outP == NULL)
+            {
+                fprintf(stderr, "%s: cannot create the file\n", argv[argi]);
+                return 1;
+            }
+        }
+        else
+        {
+            usage();
+        }
+    }
+
+    ScriptEnvironment env;
+    settings.level = Kernels::bestLevel(env.GetCPUFlags());
+    if (cpuP != NULL)
+    {
+        Kernels::level_t level;
+        if (!Kernels::parseLevel(cpuP, &level))
+        {
+            usage();
+        }
+        if (level > settings.level)
+        {
+            fprintf(stderr, "%s: not supported by this processor\n", cpuP);
+            return 1;
+        }
+        settings.level = level;
+    }
+
+    int mismatches = 0;
+    int untagged = 0;
+    int64_t rewarmed = 0;
+    try
+    {
+        AvisynthPluginInit3(&env, NULL);
+
+        fprintf(settings.outP, "benchmark,mapping,blend,channels,threads,items,seconds,value,unit\n");
+        const std::vector<MappingCase> mappings = makeMappings(settings.frames);
+        benchAudio(settings, env, mappings);
+        benchFrames(settings, env, mappings.back());
+        benchStacked(settings, env);
+        untagged = benchStackedProps(settings, env);
+        rewarmed = benchReverseGop(settings, env);
+        benchParser(settings);
+        benchTransform(settings, env);
+        mismatches = benchConcurrent(settings, env, mappings.back());
+    }
+    catch (const AvisynthError& err)
+    {
+        fprintf(stderr, "%s\n", err.msg);
+        return 1;
+    }
+
+    if (settings.outP != stdout)
+    {
+        fclose(settings.outP);
+    }
+    if (untagged > 0)
+    {
+        fprintf(stderr, "stacked: %d frames lost the tags of the inner filter\n", untagged);
+        return 1;
+    }
+    if (rewarmed > 0)
+    {
+        fprintf(stderr, "frame-gop: %lld source frames requested again by the seek smoothing\n",
+                (long long)rewarmed);
+        return 1;
+    }
+    if (mismatches > 0)
+    {
+        fprintf(stderr, "concurrent: %d audio requests differ from the single-threaded rendering\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
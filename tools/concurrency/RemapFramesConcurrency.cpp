@@ -0,0 +1,532 @@
+/** RemapFramesConcurrency
+  *     Checks stacked filters called from several threads at once: each
+  *     stack is first read by a single thread, then by several threads
+  *     calling GetFrame and GetAudio at random on all its levels. Every
+  *     frame and every sample is checked against the reference
+  *     (ReferenceAudio, and the composed frame tables of ReferenceMap for
+  *     the frames).
+  *
+  *     The audio of a stacked filter is read through the filters below
+  *     it, so the audio engine re-enters itself on the calling thread.
+  *
+  *     usage: RemapFramesConcurrency [switches]
+  *
+  *     switches:
+  *         -threads n      threads of the concurrent phase; 0, the
+  *                           default, for one per processor (at least 4)
+  *         -requests n     requests per thread and per case
+  *         -v              prints every case, not only the failing ones
+  *
+  *     Exits with 1 if any case fails.
+  */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MockAvisynth.h"
+#include "ReferenceAudio.h"
+#include "ReferenceMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+extern "C" const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors);
+
+
+// A filter of a stack, applied to the level below it (the base clip for
+// the first one)
+struct Layer
+{
+    ReferenceMap map;       // RemapFramesSimple if simple, else RemapFrames
+    bool sourceFlag;        // RemapFrames reads the mock source clip;
+                            //   else sourceClip is the level below
+};
+
+
+// A stack of filters
+struct Stack
+{
+    const char* name;
+    std::vector<Layer> layers;
+};
+
+
+// Engine options of a case, as named arguments
+struct Engine
+{
+    const char* name;
+    int prefetch;
+    int audioThreads;
+    int audioCache;
+    int audioStream;
+};
+
+
+// A level of a built stack
+struct Level
+{
+    PClip clip;
+    std::unique_ptr<ReferenceAudio> referenceP;
+    std::vector<SFLOAT> expected;       // the whole audio
+    std::vector<int> expectedSeeds;     // of each frame; -1 if blank
+    std::vector<int> expectedFrames;
+};
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const int FRAMES = 60;
+static const int AUDIO_RATE = 48000;
+static const int FPS = 25;
+static const int CHANNELS = 2;
+
+static const int BASE_SEED = 0;
+static const int SOURCE_SEED = 1;
+
+static const int blendValues[] = { 0, 100 };
+
+static const Engine engines[] =
+{
+    { "plain", 0, 1, 0, 0 },
+    { "threaded", 3, 3, 16384, 8192 },
+};
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr, "usage: RemapFramesConcurrency [-threads n] [-requests n] [-v]\n");
+    exit(2);
+}
+
+
+/** makeStacks
+  *
+  * RETURNS:
+  *     the stacks of the cases
+  */
+static std::vector<Stack> makeStacks()
+{
+    std::vector<Stack> stacks;
+
+    // Fused for the video, not for the audio
+    Stack stack;
+    stack.name = "simple-on-simple";
+    stack.layers.clear();
+    ReferenceMap halves(ReferenceMap::MODE_SIMPLE, FRAMES, FRAMES);
+    halves.appendRange(30, 59);
+    halves.appendRange(0, 29);
+    ReferenceMap backwards(ReferenceMap::MODE_SIMPLE, FRAMES, FRAMES);
+    backwards.appendRange(59, 0);
+    const Layer shuffle = { halves, false };
+    const Layer reverse = { backwards, false };
+    stack.layers.push_back(shuffle);
+    stack.layers.push_back(reverse);
+    stacks.push_back(stack);
+
+    stack.name = "advanced-on-advanced";
+    stack.layers.clear();
+    ReferenceMap stretched(ReferenceMap::MODE_ADVANCED, FRAMES, FRAMES);
+    stretched.setRange(10, 19, 40, 49);
+    stretched.setRange(25, 30, 35, 33);
+    stretched.blankRange(50, 51);
+    ReferenceMap copied(ReferenceMap::MODE_ADVANCED, FRAMES, FRAMES);
+    copied.setRange(0, 9, 20, 29);
+    copied.setRange(40, 59, 59, 40);
+    const Layer withSource = { stretched, true };
+    const Layer onItself = { copied, false };
+    stack.layers.push_back(withSource);
+    stack.layers.push_back(onItself);
+    stacks.push_back(stack);
+
+    stack.name = "simple-advanced-simple";
+    stack.layers.clear();
+    stack.layers.push_back(shuffle);
+    stack.layers.push_back(withSource);
+    stack.layers.push_back(reverse);
+    stacks.push_back(stack);
+
+    return stacks;
+}
+
+
+/** makeFilter
+  *
+  * RETURNS:
+  *     the filter of a level, built by the plug-in
+  */
+static PClip makeFilter(ScriptEnvironment& env, const Layer& layer, const PClip& belowClip,
+                        const PClip& sourceClip, int blend, const Engine& engine)
+{
+    std::vector<AVSValue> args;
+    std::vector<const char*> names;
+
+    args.push_back(belowClip);
+    names.push_back(NULL);
+    if (layer.sourceFlag)
+    {
+        args.push_back(sourceClip);
+        names.push_back("sourceClip");
+    }
+    args.push_back(layer.map.getMappings().c_str());
+    names.push_back("mappings");
+    args.push_back(blend);
+    names.push_back("audioBlendSamples");
+    args.push_back(engine.prefetch);
+    names.push_back("prefetch");
+    args.push_back(engine.audioThreads);
+    names.push_back("audioThreads");
+    args.push_back(engine.audioCache);
+    names.push_back("audioCache");
+    args.push_back(engine.audioStream);
+    names.push_back("audioStream");
+
+    return env.Invoke(layer.map.isSimple() ? "RemapFramesSimple_AudioMod" : "RemapFrames",
+                      AVSValue(args.data(), int (args.size())), names.data()).AsClip();
+}
+
+
+/** buildStack
+  *
+  *     Builds the filters of a stack, and the expected output of each of
+  *     its levels.
+  */
+static void buildStack(ScriptEnvironment& env, const Stack& stack, int blend, const Engine& engine,
+                       const PClip& baseClip, const PClip& sourceClip, std::vector<Level>* levelsP)
+{
+    const VideoInfo& vi = baseClip->GetVideoInfo();
+    std::vector<Level>& levels = *levelsP;
+    levels.clear();
+    levels.resize(stack.layers.size());
+
+    for (size_t l = 0; l < stack.layers.size(); ++l)
+    {
+        const Layer& layer = stack.layers[l];
+        Level& level = levels[l];
+        const PClip belowClip = (l == 0) ? baseClip : levels[l - 1].clip;
+        const ReferenceAudio* belowP = (l == 0) ? NULL : levels[l - 1].referenceP.get();
+
+        level.clip = makeFilter(env, layer, belowClip, sourceClip, blend, engine);
+
+        const ReferenceAudio::Input below = { vi, BASE_SEED, belowP };
+        const ReferenceAudio::Input source = { vi, SOURCE_SEED, NULL };
+        const ReferenceAudio::Input inputs[2] = { below, layer.sourceFlag ? source : below };
+        const VideoInfo& outVi = level.clip->GetVideoInfo();
+        level.referenceP.reset(new ReferenceAudio(outVi, layer.map, inputs, blend));
+        level.expected.resize(size_t(outVi.num_audio_samples) * CHANNELS);
+        level.referenceP->render(level.expected.data(), 0, outVi.num_audio_samples);
+
+        // The frames, through the levels below
+        level.expectedSeeds.resize(outVi.num_frames);
+        level.expectedFrames.resize(outVi.num_frames);
+        for (int n = 0; n < outVi.num_frames; ++n)
+        {
+            const MapIndex element = layer.map.lookup(n);
+            if (element.clipIndex == MapIndex::BLANK_CLIP)
+            {
+                level.expectedSeeds[n] = -1;
+                level.expectedFrames[n] = -1;
+            }
+            else if (element.clipIndex == 1 && layer.sourceFlag)
+            {
+                level.expectedSeeds[n] = SOURCE_SEED;
+                level.expectedFrames[n] = element.frame;
+            }
+            else if (l == 0)
+            {
+                level.expectedSeeds[n] = BASE_SEED;
+                level.expectedFrames[n] = element.frame;
+            }
+            else
+            {
+                level.expectedSeeds[n] = levels[l - 1].expectedSeeds[element.frame];
+                level.expectedFrames[n] = levels[l - 1].expectedFrames[element.frame];
+            }
+        }
+    }
+}
+
+
+/** checkFrame
+  *
+  * RETURNS:
+  *     false if frame <n> of <level> isn't the expected one; <messageP>
+  *       then receives the description of the difference
+  */
+static bool checkFrame(const Level& level, int n, IScriptEnvironment* envP, std::string* messageP)
+{
+    const PVideoFrame frame = level.clip->GetFrame(n, envP);
+    int seed = -1;
+    int stamp = -1;
+    // The blank frames carry no stamp, only black pixels
+    if (   !MockClip::readStamp(frame, &seed, &stamp)
+        || (seed != BASE_SEED && seed != SOURCE_SEED))
+    {
+        seed = -1;
+        stamp = -1;
+    }
+    if (seed == level.expectedSeeds[n] && stamp == level.expectedFrames[n])
+    {
+        return true;
+    }
+
+    char text[128];
+    sprintf(text, "frame %d: expected %d of clip %d, got %d of clip %d",
+            n, level.expectedFrames[n], level.expectedSeeds[n], stamp, seed);
+    *messageP = text;
+    return false;
+}
+
+
+/** checkAudio
+  *
+  * RETURNS:
+  *     false if the samples <start> to <start> + <count> - 1 of <level>
+  *       aren't bit-exact; <messageP> then receives the description of
+  *       the first difference
+  */
+static bool checkAudio(const Level& level, int64_t start, int64_t count, std::vector<SFLOAT>* bufferP,
+                       IScriptEnvironment* envP, std::string* messageP)
+{
+    bufferP->assign(size_t(count) * CHANNELS, 0.0f);
+    level.clip->GetAudio(bufferP->data(), start, count, envP);
+
+    const SFLOAT* const expectedP = &level.expected[size_t(start) * CHANNELS];
+    for (size_t i = 0; i < bufferP->size(); ++i)
+    {
+        if (memcmp(&(*bufferP)[i], &expectedP[i], sizeof (SFLOAT)) != 0)
+        {
+            char text[192];
+            sprintf(text, "sample %lld channel %d (request %lld+%lld): expected %.9g, got %.9g",
+                    (long long) (start + int64_t (i / CHANNELS)), int (i % CHANNELS),
+                    (long long) start, (long long) count, double (expectedP[i]), double ((*bufferP)[i]));
+            *messageP = text;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** runSerial
+  *
+  *     Reads every frame and the whole audio of each level, from the top
+  *     of the stack, in one thread.
+  *
+  * RETURNS:
+  *     the description of the first difference; empty if none
+  */
+static std::string runSerial(const std::vector<Level>& levels, IScriptEnvironment* envP)
+{
+    std::string message;
+    std::vector<SFLOAT> buffer;
+    for (size_t l = levels.size(); l-- > 0 && message.empty(); )
+    {
+        const Level& level = levels[l];
+        const VideoInfo& vi = level.clip->GetVideoInfo();
+        for (int n = 0; n < vi.num_frames && message.empty(); ++n)
+        {
+            checkFrame(level, n, envP, &message);
+        }
+
+        // Blocks of odd sizes, straddling the frame boundaries
+        const int64_t blockSamples = 3001;
+        for (int64_t pos = 0; pos < vi.num_audio_samples && message.empty(); pos += blockSamples)
+        {
+            checkAudio(level, pos, std::min(blockSamples, vi.num_audio_samples - pos), &buffer, envP, &message);
+        }
+    }
+    return message;
+}
+
+
+/** runConcurrent
+  *
+  *     Calls GetFrame and GetAudio from <nbrThreads> threads at once, on
+  *     random levels. Some threads read the audio in sequence, to run the
+  *     streamer.
+  *
+  * RETURNS:
+  *     the description of the first difference; empty if none
+  */
+static std::string runConcurrent(const std::vector<Level>& levels, int nbrThreads, int nbrRequests,
+                                 IScriptEnvironment* envP)
+{
+    std::atomic<int> nbrFailed(0);
+    std::vector<std::string> messages(nbrThreads);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nbrThreads; ++t)
+    {
+        workers.push_back(std::thread([&, t]() {
+            std::mt19937 rng(1000 + t);
+            std::vector<SFLOAT> buffer;
+            const bool sequentialFlag = (t % 4 == 0);
+            int64_t nextPos = 0;
+            std::string& message = messages[t];
+            try
+            {
+                for (int i = 0; i < nbrRequests && message.empty() && nbrFailed == 0; ++i)
+                {
+                    const Level& level = sequentialFlag ? levels.back() : levels[rng() % levels.size()];
+                    const VideoInfo& vi = level.clip->GetVideoInfo();
+                    if (i % 3 == 0)
+                    {
+                        checkFrame(level, int (rng() % unsigned (vi.num_frames)), envP, &message);
+                        continue;
+                    }
+
+                    // Up to 4 frames, not aligned on the frames or blocks
+                    int64_t start = sequentialFlag ? nextPos : int64_t (rng() % unsigned (vi.num_audio_samples));
+                    if (start >= vi.num_audio_samples)
+                    {
+                        start = 0;
+                    }
+                    const int64_t count = std::min(int64_t (1 + rng() % (4 * AUDIO_RATE / FPS)),
+                                                   vi.num_audio_samples - start);
+                    checkAudio(level, start, count, &buffer, envP, &message);
+                    nextPos = start + count;
+                }
+            }
+            catch (const AvisynthError& err)
+            {
+                message = err.msg;
+            }
+            if (!message.empty())
+            {
+                ++nbrFailed;
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+
+    for (int t = 0; t < nbrThreads; ++t)
+    {
+        if (!messages[t].empty())
+        {
+            return messages[t];
+        }
+    }
+    return std::string();
+}
+
+
+
+// MAIN ----------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    int nbrThreads = 0;
+    int nbrRequests = 300;
+    bool verboseFlag = false;
+
+    for (int argi = 1; argi < argc; ++argi)
+    {
+        const std::string name = argv[argi];
+        if (name == "-v")
+        {
+            verboseFlag = true;
+        }
+        else if (argi + 1 >= argc)
+        {
+            usage();
+        }
+        else if (name == "-threads")
+        {
+            nbrThreads = atoi(argv[++argi]);
+        }
+        else if (name == "-requests")
+        {
+            nbrRequests = atoi(argv[++argi]);
+            if (nbrRequests < 1)
+            {
+                usage();
+            }
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (nbrThreads <= 0)
+    {
+        nbrThreads = std::max(4, int (std::thread::hardware_concurrency()));
+    }
+
+    ScriptEnvironment env;
+    int nbrCases = 0;
+    int nbrFailed = 0;
+    try
+    {
+        AvisynthPluginInit3(&env, NULL);
+
+        const VideoInfo vi = MockClip::makeVideoInfo(32, 32, VideoInfo::CS_Y8, FRAMES, FPS, 1, AUDIO_RATE, CHANNELS);
+        const PClip baseClip = new MockClip(vi, BASE_SEED);
+        const PClip sourceClip = new MockClip(vi, SOURCE_SEED);
+
+        const std::vector<Stack> stacks = makeStacks();
+        for (size_t s = 0; s < stacks.size(); ++s)
+        {
+            for (size_t b = 0; b < sizeof blendValues / sizeof blendValues[0]; ++b)
+            {
+                for (size_t e = 0; e < sizeof engines / sizeof engines[0]; ++e)
+                {
+                    char caseName[128];
+                    sprintf(caseName, "%s/blend%d/%s", stacks[s].name, blendValues[b], engines[e].name);
+
+                    std::vector<Level> levels;
+                    buildStack(env, stacks[s], blendValues[b], engines[e], baseClip, sourceClip, &levels);
+
+                    static const char* const phaseNames[] = { "serial", "concurrent" };
+                    for (int phase = 0; phase < 2; ++phase)
+                    {
+                        ++nbrCases;
+                        std::string message;
+                        try
+                        {
+                            message = (phase == 0) ? runSerial(levels, &env)
+                                                   : runConcurrent(levels, nbrThreads, nbrRequests, &env);
+                        }
+                        catch (const AvisynthError& err)
+                        {
+                            message = err.msg;
+                        }
+
+                        if (!message.empty())
+                        {
+                            ++nbrFailed;
+                            printf("FAIL %s/%s: %s\n", caseName, phaseNames[phase], message.c_str());
+                        }
+                        else if (verboseFlag)
+                        {
+                            printf("ok   %s/%s\n", caseName, phaseNames[phase]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (const AvisynthError& err)
+    {
+        fprintf(stderr, "%s\n", err.msg);
+        return 1;
+    }
+
+    printf("%d cases, %d failed\n", nbrCases, nbrFailed);
+    return (nbrFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+/** ReferenceAudio
+  *     Reference rendering of the remapped audio: the original per-sample
+  *     algorithm of RemapFrames, kept apart from the plug-in so that the
+  *     optimized audio paths can be checked against it.
+  *
+  *     Do not optimize this module: its output defines the expected
+  *     output of the plug-in.
+  */
+
+#include <algorithm>
+#include <cmath>
+
+#include "MockAvisynth.h"
+#include "ReferenceAudio.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** ReferenceAudio constructor
+  *
+  * PARAMETERS:
+  *     IN vi_               - the format of the remapped clip
+  *     IN frameMap_         - the frame table of the mappings; must outlive
+  *                              the object
+  *     IN inputs_           - the base and source clips, by clip index
+  *     audioBlendSamples_   - number of samples blended on each side of a
+  *                              frame boundary
+  */
+ReferenceAudio::ReferenceAudio(const VideoInfo& vi_, const ReferenceMap& frameMap_, const Input inputs_[2],
+                               int audioBlendSamples_)
+: vi(vi_),
+  frameMap(frameMap_),
+  audioBlendSamples(audioBlendSamples_)
+{
+    inputs[0] = inputs_[0];
+    inputs[1] = inputs_[1];
+}
+
+
+/** render
+  *
+  *     Computes output samples one by one from the mapping.
+  *
+  * PARAMETERS:
+  *     OUT samples - receives <count> interleaved float samples
+  *     start       - the first output sample
+  *     count       - the number of samples
+  */
+void ReferenceAudio::render(SFLOAT* samples, int64_t start, int64_t count) const
+{
+    const int channels = vi.AudioChannels();
+
+    const long double videoFramerate = (long double)vi.fps_numerator / (long double)vi.fps_denominator;
+    const long double audioSampleRate = vi.audio_samples_per_second;
+    const long double samplesPerFrame = audioSampleRate / videoFramerate;
+
+    std::vector<SFLOAT> sampleBuffer(channels);
+    std::vector<SFLOAT> mixSampleBuffer(channels);
+
+    for (int64_t i = 0; i < count; i++)
+    {
+        const int64_t absolutePlace = start + i;
+        const remappedAudioSample mainSample = remapAudioSample(absolutePlace, audioSampleRate, videoFramerate);
+
+        readAudio(mainSample.clipIndex, &sampleBuffer[0], mainSample.audioSample);
+
+        if (audioBlendSamples != 0)
+        {
+            const long double framePlace = (long double)absolutePlace / samplesPerFrame;
+            const long double roundedFramePlace = std::round(framePlace);
+            const long double distanceFromFrameBoundary = std::abs(framePlace - roundedFramePlace) * samplesPerFrame;
+
+            if (distanceFromFrameBoundary <= audioBlendSamples && roundedFramePlace != 0)
+            {
+                // Half way at the boundary, the other half being blended
+                // in the other frame
+                const long double mainSampleIntensity =
+                    (long double)0.5 + ((long double)0.5 * (distanceFromFrameBoundary / (long double)audioBlendSamples));
+                const long double foreignSampleIntensity = 1 - mainSampleIntensity;
+
+                long double mixSamplePosition;
+                int mixClipIndex;
+                if (roundedFramePlace > framePlace)
+                {
+                    const remappedAudioSample nextFrameSample =
+                        remapAudioSample(absolutePlace + samplesPerFrame, audioSampleRate, videoFramerate);
+                    mixSamplePosition = nextFrameSample.audioSample - (nextFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
+                    mixClipIndex = nextFrameSample.clipIndex;
+                }
+                else
+                {
+                    const remappedAudioSample lastFrameSample =
+                        remapAudioSample(absolutePlace - samplesPerFrame, audioSampleRate, videoFramerate);
+                    mixSamplePosition = lastFrameSample.audioSample + (lastFrameSample.backwards ? -samplesPerFrame : samplesPerFrame);
+                    mixClipIndex = lastFrameSample.clipIndex;
+                }
+
+                // A sample isn't blended with itself
+                if (mainSample.audioSample != mixSamplePosition || mainSample.clipIndex != mixClipIndex)
+                {
+                    // In double, as with MSVC, where long double is double
+                    readAudio(mixClipIndex, &mixSampleBuffer[0], int64_t (mixSamplePosition));
+                    const double mainWeight = std::sqrt((double)mainSampleIntensity);
+                    const double foreignWeight = std::sqrt((double)foreignSampleIntensity);
+                    for (int j = 0; j < channels; j++)
+                    {
+                        const double mainProduct = mainWeight * sampleBuffer[j];
+                        const double foreignProduct = foreignWeight * mixSampleBuffer[j];
+                        sampleBuffer[j] = float(mainProduct + foreignProduct);
+                    }
+                }
+            }
+        }
+
+        std::copy(sampleBuffer.begin(), sampleBuffer.end(), samples + i * channels);
+    }
+}
+
+
+/** lookupAudioFrame
+  *
+  * RETURNS:
+  *     the clip and frame output frame <n> is taken from; <n> is clipped
+  *     to the clip bounds
+  */
+MapIndex ReferenceAudio::lookupAudioFrame(int n) const
+{
+    return frameMap.lookup(std::min(std::max(n, 0), frameMap.size() - 1));
+}
+
+
+/** remapAudioSample
+  *
+  * RETURNS:
+  *     the input sample played at output sample <originalAudioSample>,
+  *     and whether its frame is played backwards
+  */
+ReferenceAudio::remappedAudioSample ReferenceAudio::remapAudioSample(long long originalAudioSample,
+                                                                     long double audioSampleRate,
+                                                                     long double videoFramerate) const
+{
+    const long double seconds = originalAudioSample / audioSampleRate;
+    const long double frame = seconds * videoFramerate;
+    const int whichFrame = std::min(std::max((int)frame, 0), frameMap.size() - 1);
+    const MapIndex current = lookupAudioFrame(whichFrame);
+    const MapIndex next = lookupAudioFrame(whichFrame + 1);
+    const MapIndex previous = lookupAudioFrame(whichFrame - 1);
+
+    // Backwards inside a run of decreasing frames; a blank neighbour
+    // (frame 0) ends the run
+    const bool frameRunBackwards = (   next.clipIndex != MapIndex::BLANK_CLIP
+                                    && previous.clipIndex != MapIndex::BLANK_CLIP
+                                    && next.frame < current.frame && previous.frame > current.frame);
+
+    const long double frameOffset = frame - (long double)whichFrame;
+    const long double invertedFrameOffset = 1.0 - frameOffset;
+    const long double actualFrameToGet = frameRunBackwards
+                                         ? (long double)current.frame + invertedFrameOffset
+                                         : (long double)current.frame + frameOffset;
+
+    remappedAudioSample result;
+    result.audioSample = std::min(vi.num_audio_samples,
+                                  std::max((int64_t)0, (int64_t)(0.5 + actualFrameToGet / videoFramerate * audioSampleRate)));
+    result.backwards = frameRunBackwards;
+    result.clipIndex = current.clipIndex;
+    return result;
+}
+
+
+/** readAudio
+  *
+  *     Reads one sample of an input clip: silence for the blank frames
+  *     and outside of the clip, unless the clip is a remapped one.
+  */
+void ReferenceAudio::readAudio(int clipIndex, SFLOAT* buf, int64_t sample) const
+{
+    if (clipIndex != MapIndex::BLANK_CLIP && inputs[clipIndex].innerP != NULL)
+    {
+        inputs[clipIndex].innerP->render(buf, sample, 1);
+        return;
+    }
+
+    const int channels = vi.AudioChannels();
+    const bool silentFlag = (   clipIndex == MapIndex::BLANK_CLIP
+                             || sample < 0
+                             || sample >= inputs[clipIndex].vi.num_audio_samples);
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        buf[ch] = silentFlag ? 0.0f : MockClip::sampleValue(inputs[clipIndex].seed, sample, ch);
+    }
+}
@@ -0,0 +1,61 @@
+/** ReferenceAudio
+  *     Reference rendering of the remapped audio: the original per-sample
+  *     algorithm of RemapFrames, kept apart from the plug-in so that the
+  *     optimized audio paths can be checked against it.
+  */
+
+#ifndef REFERENCEAUDIO_H
+#define REFERENCEAUDIO_H
+
+#include <avisynth.h>
+
+#include "ReferenceMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+// Audio of a remapped clip whose input clips are MockClips, or other
+// remapped clips, computed one sample at a time. The input samples are
+// computed directly from the seeds of the clips, or by the reference of
+// the remapped clip, without calling them.
+class ReferenceAudio
+{
+public:
+    // An input clip: its format, and the seed of its MockClip or the
+    // reference of the remapped clip it is (then <seed> is unused)
+    struct Input
+    {
+        VideoInfo vi;
+        int seed;
+        const ReferenceAudio* innerP;
+    };
+
+    ReferenceAudio(const VideoInfo& vi_, const ReferenceMap& frameMap_, const Input inputs_[2], int audioBlendSamples_);
+
+    void render(SFLOAT* samples, int64_t start, int64_t count) const;
+
+private:
+    struct remappedAudioSample
+    {
+        int64_t audioSample;
+        bool backwards;
+        int clipIndex;
+    };
+
+    const VideoInfo vi;
+    const ReferenceMap& frameMap;
+    Input inputs[2];
+    const int audioBlendSamples;
+
+    MapIndex lookupAudioFrame(int n) const;
+    remappedAudioSample remapAudioSample(long long originalAudioSample, long double audioSampleRate,
+                                         long double videoFramerate) const;
+    void readAudio(int clipIndex, SFLOAT* buf, int64_t sample) const;
+
+    ReferenceAudio(const ReferenceAudio&);
+    ReferenceAudio& operator=(const ReferenceAudio&);
+};
+
+
+#endif // REFERENCEAUDIO_H
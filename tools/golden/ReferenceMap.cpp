@@ -0,0 +1,232 @@
+/** ReferenceMap
+  *     Reference frame table of a mapping: built along with the text of
+  *     the mapping, one command at a time, by the original semantics of
+  *     the commands.
+  *
+  *     Do not share code with the plug-in here: this table defines the
+  *     expected frames of the filters.
+  */
+
+#include <cassert>
+#include <cstdio>
+
+#include "ReferenceMap.h"
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+/** ReferenceMap constructor
+  *
+  * PARAMETERS:
+  *     mode_         - the syntax of the mapping
+  *     baseFrames    - the number of frames of the base clip; in
+  *                       MODE_ADVANCED, the output starts as a copy of it
+  *     sourceFrames_ - the number of frames of the source clip; the
+  *                       source frames are clipped to it
+  */
+ReferenceMap::ReferenceMap(Mode mode_, int baseFrames, int sourceFrames_)
+: mode(mode_),
+  sourceFrames(sourceFrames_),
+  table(),
+  mappings()
+{
+    if (mode == MODE_ADVANCED)
+    {
+        table.resize(baseFrames);
+        for (int i = 0; i < baseFrames; ++i)
+        {
+            table[i].clipIndex = 0;
+            table[i].frame = i;
+        }
+    }
+}
+
+
+/** setFrame
+  *
+  *     "i j": output frame <i> is source frame <j>.
+  */
+void ReferenceMap::setFrame(int i, int j)
+{
+    assert(mode == MODE_ADVANCED);
+
+    char line[64];
+    sprintf(line, "%d %d", i, j);
+    addLine(line);
+
+    table.at(i) = sourceFrame(j);
+}
+
+
+/** setRange
+  *
+  *     "[a b] [c d]": the source range is stretched over the output range.
+  *     Output frame a + i is source frame int (c + s * i), with s the
+  *     ratio of the lengths of the ranges, negative if [c d] is reversed.
+  */
+void ReferenceMap::setRange(int inStart, int inEnd, int outStart, int outEnd)
+{
+    assert(mode == MODE_ADVANCED);
+
+    char line[64];
+    sprintf(line, "[%d %d] [%d %d]", inStart, inEnd, outStart, outEnd);
+    addLine(line);
+
+    const int m = inEnd - inStart + 1;
+    double s = outEnd - outStart;
+    s += (s < 0) ? -1 : +1;
+    s /= m;
+    for (int i = 0; i < m; ++i)
+    {
+        table.at(inStart + i) = sourceFrame(int (outStart + s * i));
+    }
+}
+
+
+/** fillRange
+  *
+  *     "[a b] j": every output frame of the range is source frame <j>.
+  */
+void ReferenceMap::fillRange(int inStart, int inEnd, int j)
+{
+    assert(mode == MODE_ADVANCED);
+
+    char line[64];
+    sprintf(line, "[%d %d] %d", inStart, inEnd, j);
+    addLine(line);
+
+    for (int i = inStart; i <= inEnd; ++i)
+    {
+        table.at(i) = sourceFrame(j);
+    }
+}
+
+
+/** blankRange
+  *
+  *     "[a b] -": the output frames of the range are blank.
+  */
+void ReferenceMap::blankRange(int inStart, int inEnd)
+{
+    assert(mode == MODE_ADVANCED);
+
+    char line[64];
+    sprintf(line, "[%d %d] -", inStart, inEnd);
+    addLine(line);
+
+    for (int i = inStart; i <= inEnd; ++i)
+    {
+        table.at(i).clipIndex = MapIndex::BLANK_CLIP;
+        table.at(i).frame = 0;
+    }
+}
+
+
+/** appendFrame
+  *
+  *     "j": the next output frame is source frame <j>.
+  */
+void ReferenceMap::appendFrame(int j)
+{
+    assert(mode == MODE_SIMPLE);
+
+    char item[32];
+    sprintf(item, "%d", j);
+    addLine(item);
+
+    table.push_back(sourceFrame(j));
+}
+
+
+/** appendRange
+  *
+  *     "[c d]": the next output frames are source frames <c> to <d>,
+  *     in descending order if <d> is lower than <c>.
+  */
+void ReferenceMap::appendRange(int outStart, int outEnd)
+{
+    assert(mode == MODE_SIMPLE);
+
+    char item[64];
+    sprintf(item, "[%d %d]", outStart, outEnd);
+    addLine(item);
+
+    const int step = (outEnd >= outStart) ? 1 : -1;
+    for (int j = outStart; j != outEnd + step; j += step)
+    {
+        table.push_back(sourceFrame(j));
+    }
+}
+
+
+/** isSimple
+  *
+  * RETURNS:
+  *     true if the mapping is in the RemapFramesSimple syntax
+  */
+bool ReferenceMap::isSimple() const
+{
+    return mode == MODE_SIMPLE;
+}
+
+
+/** getMappings
+  *
+  * RETURNS:
+  *     the text of the mapping
+  */
+const std::string& ReferenceMap::getMappings() const
+{
+    return mappings;
+}
+
+
+/** size
+  *
+  * RETURNS:
+  *     the number of output frames
+  */
+int ReferenceMap::size() const
+{
+    return int (table.size());
+}
+
+
+/** lookup
+  *
+  * RETURNS:
+  *     the clip and frame output frame <n> is taken from
+  */
+MapIndex ReferenceMap::lookup(int n) const
+{
+    return table.at(n);
+}
+
+
+/** sourceFrame
+  *
+  * RETURNS:
+  *     frame <j> of the source clip, clipped to its bounds
+  */
+MapIndex ReferenceMap::sourceFrame(int j) const
+{
+    MapIndex element;
+    element.clipIndex = 1;
+    element.frame =   (j >= sourceFrames) ? sourceFrames - 1
+                    : (j < 0)             ? 0
+                    :                       j;
+    return element;
+}
+
+
+/** addLine
+  *
+  *     Appends a command (MODE_ADVANCED) or an item (MODE_SIMPLE) to the
+  *     text of the mapping.
+  */
+void ReferenceMap::addLine(const char* lineP)
+{
+    mappings += lineP;
+    mappings += (mode == MODE_ADVANCED) ? '\n' : ' ';
+}
@@ -0,0 +1,60 @@
+/** ReferenceMap
+  *     Reference frame table of a mapping: built along with the text of
+  *     the mapping, one command at a time, by the original semantics of
+  *     the commands, so that the parser and FrameMap can be checked
+  *     against it.
+  */
+
+#ifndef REFERENCEMAP_H
+#define REFERENCEMAP_H
+
+#include <string>
+#include <vector>
+
+#include "FrameMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+// The output frames of a RemapFrames or RemapFramesSimple filter, and
+// the mappings text producing them. Output frames are indexed directly;
+// clip indices are those of MapIndex.
+class ReferenceMap
+{
+public:
+    enum Mode
+    {
+        MODE_SIMPLE,        // RemapFramesSimple: a list of source frames
+        MODE_ADVANCED       // RemapFrames: commands over the base clip
+    };
+
+    ReferenceMap(Mode mode_, int baseFrames, int sourceFrames_);
+
+    // MODE_ADVANCED
+    void setFrame(int i, int j);
+    void setRange(int inStart, int inEnd, int outStart, int outEnd);
+    void fillRange(int inStart, int inEnd, int j);
+    void blankRange(int inStart, int inEnd);
+
+    // MODE_SIMPLE
+    void appendFrame(int j);
+    void appendRange(int outStart, int outEnd);
+
+    bool isSimple() const;
+    const std::string& getMappings() const;
+    int size() const;
+    MapIndex lookup(int n) const;
+
+private:
+    Mode mode;
+    int sourceFrames;
+    std::vector<MapIndex> table;
+    std::string mappings;
+
+    MapIndex sourceFrame(int j) const;
+    void addLine(const char* lineP);
+};
+
+
+#endif // REFERENCEMAP_H
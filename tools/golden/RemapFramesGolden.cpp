@@ -0,0 +1,484 @@
+/** RemapFramesGolden
+  *     Checks the audio of the plug-in against the reference per-sample
+  *     algorithm (ReferenceAudio), over a matrix of mappings, blending
+  *     windows, channel counts, sample rates and engine options, and
+  *     reports the first divergent sample of each failing case.
+  *
+  *     The reference reads the frames from its own table (ReferenceMap),
+  *     built along with the text of the mappings, not from the parser.
+  *     Some cases stack several filters, each one reading the audio of
+  *     the one below it; the engine options then apply to all of them.
+  *
+  *     usage: RemapFramesGolden [switches]
+  *
+  *     switches:
+  *         -frames n       length of the clips, in frames
+  *         -tolerance x    largest accepted difference of a sample; 0, the
+  *                           default, requires bit-exact output
+  *         -filter text    runs only the cases whose name contains <text>
+  *         -v              prints every case, not only the failing ones
+  *
+  *     Every case requests the output audio in several patterns:
+  *     sequential blocks of odd sizes, large blocks (split by the audio
+  *     threads), and random requests (served by the block cache).
+  *
+  *     The cases are also run with each kernel set below the best one
+  *     (cpu parameter), when the processor runs it.
+  *
+  *     Exits with 1 if any case fails.
+  */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MockAvisynth.h"
+#include "ReferenceAudio.h"
+#include "ReferenceMap.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+extern "C" const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors);
+
+
+// Audio format of a case
+struct Format
+{
+    const char* name;
+    int audioRate;
+    unsigned int fpsNumerator;
+    unsigned int fpsDenominator;
+};
+
+
+// A filter of a case, applied to the level below it (the base clip for
+// the first one)
+struct Layer
+{
+    ReferenceMap map;       // RemapFramesSimple if simple, else RemapFrames
+    bool sourceFlag;        // RemapFrames reads the mock source clip;
+                            //   else sourceClip is the level below
+};
+
+
+// Mappings of a case: a filter, or a stack of filters
+struct Mapping
+{
+    const char* name;
+    std::vector<Layer> layers;
+};
+
+
+// Engine options of a case, as named arguments
+struct Engine
+{
+    const char* name;
+    const char* optionName;
+    int value;
+    const char* textP;      // the value, if a string
+    int cpuFlags;           // CPUF_* flags needed to run the case
+};
+
+
+// A request pattern: the requests made to read the output
+struct Request
+{
+    int64_t start;
+    int64_t count;
+};
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const Format formats[] =
+{
+    { "48k-25", 48000, 25, 1 },
+    { "44k1-29.97", 44100, 30000, 1001 },
+    { "48k-23.976", 48000, 24000, 1001 },
+    { "8k-24", 8000, 24, 1 },
+};
+
+static const int channelCounts[] = { 1, 2, 3, 6, 8 };
+
+static const int blendValues[] = { 0, 16, 300 };
+
+static const Engine engines[] =
+{
+    // The best kernels of the processor
+    { "plain", NULL, 0, NULL, 0 },
+    { "audioCache", "audioCache", 8192, NULL, 0 },
+    { "audioThreads", "audioThreads", 3, NULL, 0 },
+    { "audioStream", "audioStream", 16384, NULL, 0 },
+    // The others
+    { "cpu-scalar", "cpu", 0, "scalar", 0 },
+    { "cpu-sse2", "cpu", 0, "sse2", CPUF_SSE2 },
+    { "cpu-avx2", "cpu", 0, "avx2", CPUF_AVX2 },
+};
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr, "usage: RemapFramesGolden [-frames n] [-tolerance x] [-filter text] [-v]\n");
+    exit(2);
+}
+
+
+/** addMapping
+  *
+  *     Adds a case of one filter to <mappings>.
+  */
+static void addMapping(std::vector<Mapping>& mappings, const char* name, const ReferenceMap& map)
+{
+    Mapping mapping;
+    mapping.name = name;
+    const Layer layer = { map, !map.isSimple() };
+    mapping.layers.push_back(layer);
+    mappings.push_back(mapping);
+}
+
+
+/** makeMappings
+  *
+  * RETURNS:
+  *     the mappings of the cases, for clips of <frames> frames
+  */
+static std::vector<Mapping> makeMappings(int frames)
+{
+    std::vector<Mapping> mappings;
+    const int u = frames / 10;
+
+    ReferenceMap forward(ReferenceMap::MODE_ADVANCED, frames, frames);
+    forward.setRange(0, frames - 2, 1, frames - 1);
+    addMapping(mappings, "forward", forward);
+
+    ReferenceMap reverse(ReferenceMap::MODE_ADVANCED, frames, frames);
+    reverse.setRange(0, frames - 1, frames - 1, 0);
+    addMapping(mappings, "reverse", reverse);
+
+    ReferenceMap denseCut(ReferenceMap::MODE_ADVANCED, frames, frames);
+    std::mt19937 rng(1);
+    for (int i = 0; i < frames; ++i)
+    {
+        denseCut.setFrame(i, int (rng() % unsigned (frames)));
+    }
+    addMapping(mappings, "dense-cut", denseCut);
+
+    // Stretched, single, reversed and blank frames between untouched
+    // frames of the base clip, as in the example of the documentation
+    ReferenceMap mixed(ReferenceMap::MODE_ADVANCED, frames, frames);
+    mixed.setRange(0, 2 * u - 1, 0, u - 1);
+    mixed.setFrame(2 * u, 5 * u);
+    mixed.fillRange(3 * u, 4 * u, 6 * u);
+    mixed.setRange(5 * u, 6 * u, 8 * u, 7 * u);
+    mixed.blankRange(7 * u, 7 * u + u / 2);
+    addMapping(mappings, "mixed", mixed);
+
+    // Blank frames right after a backward jump and after a reversed
+    // range: they don't make the frame before them play backwards
+    ReferenceMap blankAfterJump(ReferenceMap::MODE_ADVANCED, frames, frames);
+    blankAfterJump.setFrame(2 * u, 8 * u);
+    blankAfterJump.setFrame(2 * u + 1, 4 * u);
+    blankAfterJump.blankRange(2 * u + 2, 2 * u + 3);
+    blankAfterJump.setRange(4 * u, 5 * u, 9 * u, 8 * u);
+    blankAfterJump.blankRange(5 * u + 1, 5 * u + 2);
+    addMapping(mappings, "blank-after-jump", blankAfterJump);
+
+    // Base clip frames in a shuffled order, in simple mode
+    ReferenceMap simpleShuffle(ReferenceMap::MODE_SIMPLE, frames, frames);
+    for (int i = 0; i < frames; ++i)
+    {
+        simpleShuffle.appendFrame((i % 3 == 0) ? frames - 1 - i : std::min(i ^ 1, frames - 1));
+    }
+    addMapping(mappings, "simple-shuffle", simpleShuffle);
+
+    // Stacks: the video of simple filters over simple filters is fused
+    // into one lookup, their audio is not
+    ReferenceMap halves(ReferenceMap::MODE_SIMPLE, frames, frames);
+    halves.appendRange(frames / 2, frames - 1);
+    halves.appendRange(0, frames / 2 - 1);
+    ReferenceMap backwards(ReferenceMap::MODE_SIMPLE, frames, frames);
+    backwards.appendRange(frames - 1, 0);
+    ReferenceMap withSource(ReferenceMap::MODE_ADVANCED, frames, frames);
+    withSource.setRange(u, 2 * u - 1, 4 * u, 5 * u - 1);
+    withSource.setRange(3 * u, 4 * u, 6 * u, 5 * u + u / 2);
+    withSource.blankRange(5 * u, 5 * u + 1);
+    ReferenceMap onItself(ReferenceMap::MODE_ADVANCED, frames, frames);
+    onItself.setRange(0, u - 1, 2 * u, 3 * u - 1);
+    onItself.setRange(4 * u, frames - 1, frames - 1, 4 * u);
+
+    const Layer layers[] = { { halves, false }, { backwards, false },
+                             { withSource, true }, { onItself, false } };
+    Mapping mapping;
+    mapping.name = "stacked-simple";
+    mapping.layers.assign(&layers[0], &layers[2]);
+    mappings.push_back(mapping);
+
+    mapping.name = "stacked-advanced";
+    mapping.layers.assign(&layers[2], &layers[4]);
+    mappings.push_back(mapping);
+
+    mapping.name = "stacked-mixed";
+    mapping.layers.clear();
+    mapping.layers.push_back(layers[0]);
+    mapping.layers.push_back(layers[2]);
+    mapping.layers.push_back(layers[1]);
+    mappings.push_back(mapping);
+
+    return mappings;
+}
+
+
+/** makeRequests
+  *
+  * RETURNS:
+  *     the request patterns of output audio of <total> samples
+  */
+static std::vector<std::vector<Request> > makeRequests(int64_t total)
+{
+    std::vector<std::vector<Request> > patterns(3);
+
+    const int64_t sizes[2] = { 3001, 100000 };
+    for (int p = 0; p < 2; ++p)
+    {
+        for (int64_t pos = 0; pos < total; pos += sizes[p])
+        {
+            const Request request = { pos, std::min(sizes[p], total - pos) };
+            patterns[p].push_back(request);
+        }
+    }
+
+    // Random requests, some of them overlapping; about four times the
+    // output in all
+    std::mt19937 rng(2);
+    for (int i = 0; i < 64; ++i)
+    {
+        const int64_t start = int64_t (rng() % unsigned (total));
+        const Request request = { start, std::min(int64_t (1 + rng() % unsigned (total / 8)), total - start) };
+        patterns[2].push_back(request);
+    }
+
+    return patterns;
+}
+
+
+/** makeFilter
+  *
+  * RETURNS:
+  *     the filter of a level of a case, built by the plug-in
+  */
+static PClip makeFilter(ScriptEnvironment& env, const Layer& layer, const PClip& belowClip,
+                        const PClip& sourceClip, int blend, const Engine& engine)
+{
+    std::vector<AVSValue> args;
+    std::vector<const char*> names;
+
+    args.push_back(belowClip);
+    names.push_back(NULL);
+    if (layer.sourceFlag)
+    {
+        args.push_back(sourceClip);
+        names.push_back("sourceClip");
+    }
+    args.push_back(layer.map.getMappings().c_str());
+    names.push_back("mappings");
+    args.push_back(blend);
+    names.push_back("audioBlendSamples");
+    if (engine.optionName != NULL)
+    {
+        args.push_back((engine.textP != NULL) ? AVSValue(engine.textP) : AVSValue(engine.value));
+        names.push_back(engine.optionName);
+    }
+
+    return env.Invoke(layer.map.isSimple() ? "RemapFramesSimple_AudioMod" : "RemapFrames",
+                      AVSValue(args.data(), int (args.size())), names.data()).AsClip();
+}
+
+
+/** compare
+  *
+  * PARAMETERS:
+  *     IN expected  - the reference samples of the whole output
+  *     IN actual    - the samples returned for <request>
+  *     request      - the request
+  *     channels     - the number of channels
+  *     tolerance    - the largest accepted difference
+  *     OUT messageP - receives the description of the first divergent
+  *                      sample
+  *
+  * RETURNS:
+  *     false if a sample differs by more than <tolerance>
+  */
+static bool compare(const std::vector<SFLOAT>& expected, const std::vector<SFLOAT>& actual, const Request& request,
+                    int channels, double tolerance, std::string* messageP)
+{
+    const SFLOAT* const expectedP = &expected[size_t(request.start) * channels];
+    for (size_t i = 0; i < size_t(request.count) * channels; ++i)
+    {
+        const double diff = std::fabs(double (actual[i]) - double (expectedP[i]));
+        if (diff > tolerance || (tolerance == 0 && memcmp(&actual[i], &expectedP[i], sizeof (SFLOAT)) != 0))
+        {
+            char text[256];
+            sprintf(text, "sample %lld channel %d (request %lld+%lld): expected %.9g, got %.9g (difference %.3g)",
+                    (long long) (request.start + int64_t (i / channels)), int (i % channels),
+                    (long long) request.start, (long long) request.count,
+                    double (expectedP[i]), double (actual[i]), diff);
+            *messageP = text;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+// MAIN ----------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    int frames = 30;
+    double tolerance = 0;
+    const char* filterP = "";
+    bool verboseFlag = false;
+
+    for (int argi = 1; argi < argc; ++argi)
+    {
+        const std::string name = argv[argi];
+        if (name == "-v")
+        {
+            verboseFlag = true;
+        }
+        else if (argi + 1 >= argc)
+        {
+            usage();
+        }
+        else if (name == "-frames")
+        {
+            frames = atoi(argv[++argi]);
+            if (frames < 20)
+            {
+                usage();
+            }
+        }
+        else if (name == "-tolerance")
+        {
+            tolerance = atof(argv[++argi]);
+        }
+        else if (name == "-filter")
+        {
+            filterP = argv[++argi];
+        }
+        else
+        {
+            usage();
+        }
+    }
+
+    static const char* const patternNames[] = { "blocks", "large", "random" };
+
+    ScriptEnvironment env;
+    int nbrCases = 0;
+    int nbrFailed = 0;
+    try
+    {
+        AvisynthPluginInit3(&env, NULL);
+
+        const std::vector<Mapping> mappings = makeMappings(frames);
+        for (size_t m = 0; m < mappings.size(); ++m)
+        {
+            const std::vector<Layer>& layers = mappings[m].layers;
+            for (size_t f = 0; f < sizeof formats / sizeof formats[0]; ++f)
+            {
+                for (size_t c = 0; c < sizeof channelCounts / sizeof channelCounts[0]; ++c)
+                {
+                    const int channels = channelCounts[c];
+                    const VideoInfo vi = MockClip::makeVideoInfo(32, 32, VideoInfo::CS_Y8, frames,
+                                                                 formats[f].fpsNumerator, formats[f].fpsDenominator,
+                                                                 formats[f].audioRate, channels);
+                    const PClip baseClip = new MockClip(vi, 0);
+                    const PClip sourceClip = new MockClip(vi, 1);
+                    const std::vector<std::vector<Request> > patterns = makeRequests(vi.num_audio_samples);
+
+                    for (size_t b = 0; b < sizeof blendValues / sizeof blendValues[0]; ++b)
+                    {
+                        char caseName[128];
+                        sprintf(caseName, "%s/%s/%dch/blend%d", mappings[m].name, formats[f].name,
+                                channels, blendValues[b]);
+                        if (strstr(caseName, filterP) == NULL)
+                        {
+                            continue;
+                        }
+
+                        // Each level reads the samples of the one below
+                        std::vector<std::unique_ptr<ReferenceAudio> > references;
+                        for (size_t l = 0; l < layers.size(); ++l)
+                        {
+                            const ReferenceAudio::Input below = { vi, 0, (l == 0) ? NULL : references.back().get() };
+                            const ReferenceAudio::Input source = { vi, 1, NULL };
+                            const ReferenceAudio::Input inputs[2] = { below, layers[l].sourceFlag ? source : below };
+                            references.emplace_back(new ReferenceAudio(vi, layers[l].map, inputs, blendValues[b]));
+                        }
+                        std::vector<SFLOAT> expected(size_t(vi.num_audio_samples) * channels);
+                        references.back()->render(expected.data(), 0, vi.num_audio_samples);
+
+                        for (size_t e = 0; e < sizeof engines / sizeof engines[0]; ++e)
+                        {
+                            if ((env.GetCPUFlags() & engines[e].cpuFlags) != engines[e].cpuFlags)
+                            {
+                                continue;
+                            }
+                            PClip clip = baseClip;
+                            for (size_t l = 0; l < layers.size(); ++l)
+                            {
+                                clip = makeFilter(env, layers[l], clip, sourceClip, blendValues[b], engines[e]);
+                            }
+                            for (size_t p = 0; p < patterns.size(); ++p)
+                            {
+                                ++nbrCases;
+                                std::string message;
+                                std::vector<SFLOAT> actual;
+                                for (size_t r = 0; r < patterns[p].size() && message.empty(); ++r)
+                                {
+                                    const Request& request = patterns[p][r];
+                                    actual.assign(size_t(request.count) * channels, 0.0f);
+                                    clip->GetAudio(actual.data(), request.start, request.count, &env);
+                                    compare(expected, actual, request, channels, tolerance, &message);
+                                }
+
+                                if (!message.empty())
+                                {
+                                    ++nbrFailed;
+                                    printf("FAIL %s/%s/%s: %s\n", caseName, engines[e].name, patternNames[p],
+                                           message.c_str());
+                                }
+                                else if (verboseFlag)
+                                {
+                                    printf("ok   %s/%s/%s\n", caseName, engines[e].name, patternNames[p]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (const AvisynthError& err)
+    {
+        fprintf(stderr, "%s\n", err.msg);
+        return 1;
+    }
+
+    printf("%d cases, %d failed\n", nbrCases, nbrFailed);
+    return (nbrFailed > 0) ? 1 : 0;
+}
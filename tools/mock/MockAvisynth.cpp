@@ -0,0 +1,1438 @@
+/** MockAvisynth
+  *     Minimal stand-in for the AviSynth core, to run the filters of the
+  *     plug-in without AviSynth installed.
+  */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "MockAvisynth.h"
+
+
+
+// CONSTANTS -----------------------------------------------------------
+
+static const VideoInfo emptyVideoInfo = VideoInfo();
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+// Atomic increment and decrement of the reference counts
+static long incrementCount(volatile long* countP)
+{
+#ifdef _MSC_VER
+    return _InterlockedIncrement(countP);
+#else
+    return __atomic_add_fetch(countP, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static long decrementCount(volatile long* countP)
+{
+#ifdef _MSC_VER
+    return _InterlockedDecrement(countP);
+#else
+    return __atomic_sub_fetch(countP, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+
+// Memory with the address of the block stored before it, for Free()
+static void* allocateAligned(size_t nBytes, size_t alignment)
+{
+    alignment = std::max(alignment, sizeof (void*));
+    char* const blockP = static_cast<char*>(::operator new(nBytes + alignment + sizeof (void*)));
+    const uintptr_t first = reinterpret_cast<uintptr_t>(blockP + sizeof (void*));
+    char* const dataP = reinterpret_cast<char*>((first + alignment - 1) / alignment * alignment);
+    reinterpret_cast<void**>(dataP)[-1] = blockP;
+    return dataP;
+}
+
+static void freeAligned(void* dataP)
+{
+    if (dataP != NULL)
+    {
+        ::operator delete(static_cast<void**>(dataP)[-1]);
+    }
+}
+
+
+// Spins for <micros> microseconds, as a decoder would keep a core busy
+static void spin(int micros)
+{
+    if (micros <= 0)
+    {
+        return;
+    }
+
+    const std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+
+
+// CLASS DEFINITIONS ---------------------------------------------------
+
+// VideoInfo -----------------------------------------------------------
+
+bool VideoInfo::HasVideo() const { return width != 0; }
+bool VideoInfo::HasAudio() const { return audio_samples_per_second != 0; }
+bool VideoInfo::IsRGB() const { return !!(pixel_type & CS_BGR); }
+bool VideoInfo::IsYUV() const { return !!(pixel_type & CS_YUV); }
+bool VideoInfo::IsYUVA() const { return !!(pixel_type & CS_YUVA); }
+bool VideoInfo::IsYUY2() const { return (pixel_type & CS_YUY2) == CS_YUY2; }
+bool VideoInfo::IsPlanar() const { return !!(pixel_type & CS_PLANAR); }
+
+bool VideoInfo::IsY() const
+{
+    return ((pixel_type & CS_PLANAR_MASK) & ~CS_Sample_Bits_Mask) == (CS_GENERIC_Y & CS_PLANAR_FILTER);
+}
+
+bool VideoInfo::IsPlanarRGB() const
+{
+    return ((pixel_type & CS_PLANAR_MASK) & ~CS_Sample_Bits_Mask) == (CS_GENERIC_RGBP & CS_PLANAR_FILTER);
+}
+
+bool VideoInfo::IsPlanarRGBA() const
+{
+    return ((pixel_type & CS_PLANAR_MASK) & ~CS_Sample_Bits_Mask) == (CS_GENERIC_RGBAP & CS_PLANAR_FILTER);
+}
+
+int VideoInfo::BitsPerComponent() const
+{
+    if (pixel_type == CS_BGR48 || pixel_type == CS_BGR64)
+    {
+        return 16;
+    }
+    if (!IsPlanar())
+    {
+        return 8;
+    }
+
+    static const int bits[8] = { 8, 16, 32, 0, 0, 10, 12, 14 };
+    return bits[(pixel_type & CS_Sample_Bits_Mask) >> CS_Shift_Sample_Bits];
+}
+
+int VideoInfo::ComponentSize() const
+{
+    const int bits = BitsPerComponent();
+    return (bits == 8) ? 1 : (bits == 32) ? 4 : 2;
+}
+
+int VideoInfo::NumComponents() const
+{
+    if (IsY())
+    {
+        return 1;
+    }
+    if (IsYUVA() || IsPlanarRGBA() || pixel_type == CS_BGR32 || pixel_type == CS_BGR64)
+    {
+        return 4;
+    }
+    return 3;
+}
+
+int VideoInfo::BytesFromPixels(int pixels) const
+{
+    return IsPlanar() ? pixels * ComponentSize()
+         : IsYUY2()   ? pixels * 2
+         :              pixels * NumComponents() * ComponentSize();
+}
+
+int VideoInfo::GetPlaneWidthSubsampling(int plane) const
+{
+    if (plane == PLANAR_Y || plane == PLANAR_A || IsRGB() || IsY())
+    {
+        return 0;
+    }
+    return ((pixel_type >> CS_Shift_Sub_Width) + 1) & 3;
+}
+
+int VideoInfo::GetPlaneHeightSubsampling(int plane) const
+{
+    if (plane == PLANAR_Y || plane == PLANAR_A || IsRGB() || IsY())
+    {
+        return 0;
+    }
+    return ((pixel_type >> CS_Shift_Sub_Height) + 1) & 3;
+}
+
+int VideoInfo::AudioChannels() const { return HasAudio() ? nchannels : 0; }
+int VideoInfo::SampleType() const { return sample_type; }
+int VideoInfo::SamplesPerSecond() const { return audio_samples_per_second; }
+
+int VideoInfo::BytesPerChannelSample() const
+{
+    switch (sample_type)
+    {
+        case SAMPLE_INT8:  return 1;
+        case SAMPLE_INT16: return 2;
+        case SAMPLE_INT24: return 3;
+        case SAMPLE_INT32: return 4;
+        case SAMPLE_FLOAT: return 4;
+        default:           return 0;
+    }
+}
+
+int VideoInfo::BytesPerAudioSample() const { return nchannels * BytesPerChannelSample(); }
+
+int64_t VideoInfo::AudioSamplesFromFrames(int frames) const
+{
+    return (fps_numerator && HasVideo())
+           ? int64_t(frames) * audio_samples_per_second * fps_denominator / fps_numerator
+           : 0;
+}
+
+int VideoInfo::FramesFromAudioSamples(int64_t samples) const
+{
+    return (fps_denominator && HasAudio())
+           ? int((samples * fps_numerator) / (int64_t(fps_denominator) * audio_samples_per_second))
+           : 0;
+}
+
+
+// VideoFrameBuffer ----------------------------------------------------
+
+VideoFrameBuffer::VideoFrameBuffer(int size, int margin, Device* device_)
+: data(static_cast<BYTE*>(allocateAligned(size, margin))),
+  data_size(size),
+  sequence_number(0),
+  refcount(0),
+  device(device_)
+{
+}
+
+VideoFrameBuffer::~VideoFrameBuffer()
+{
+    freeAligned(data);
+}
+
+
+// VideoFrame ----------------------------------------------------------
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, AVSMap* avsmap, int _offset, int _pitch, int _row_size, int _height,
+                       int _offsetU, int _offsetV, int _pitchUV, int _row_sizeUV, int _heightUV, int _offsetA)
+: refcount(0),
+  vfb(_vfb),
+  offset(_offset),
+  pitch(_pitch),
+  row_size(_row_size),
+  height(_height),
+  offsetU(_offsetU),
+  offsetV(_offsetV),
+  pitchUV(_pitchUV),
+  row_sizeUV(_row_sizeUV),
+  heightUV(_heightUV),
+  offsetA(_offsetA),
+  pitchA((_offsetA != 0) ? _pitch : 0),
+  row_sizeA((_offsetA != 0) ? _row_size : 0),
+  properties(avsmap)
+{
+    incrementCount(&vfb->refcount);
+}
+
+VideoFrame::~VideoFrame()
+{
+    delete properties;
+}
+
+void* VideoFrame::operator new(size_t size)
+{
+    return ::operator new(size);
+}
+
+void VideoFrame::AddRef()
+{
+    incrementCount(&refcount);
+}
+
+void VideoFrame::Release()
+{
+    if (decrementCount(&refcount) == 0)
+    {
+        if (decrementCount(&vfb->refcount) == 0)
+        {
+            delete vfb;
+        }
+        delete this;
+    }
+}
+
+int VideoFrame::GetPitch(int plane) const
+{
+    switch (plane & ~PLANAR_ALIGNED)
+    {
+        case PLANAR_U: case PLANAR_V: case PLANAR_B: case PLANAR_R:
+            return pitchUV;
+        case PLANAR_A:
+            return pitchA;
+        default:
+            return pitch;
+    }
+}
+
+int VideoFrame::GetRowSize(int plane) const
+{
+    switch (plane & ~PLANAR_ALIGNED)
+    {
+        case PLANAR_U: case PLANAR_V: case PLANAR_B: case PLANAR_R:
+            return row_sizeUV;
+        case PLANAR_A:
+            return row_sizeA;
+        default:
+            return row_size;
+    }
+}
+
+int VideoFrame::GetHeight(int plane) const
+{
+    switch (plane & ~PLANAR_ALIGNED)
+    {
+        case PLANAR_U: case PLANAR_V: case PLANAR_B: case PLANAR_R:
+            return heightUV;
+        default:
+            return height;
+    }
+}
+
+int VideoFrame::GetOffset(int plane) const
+{
+    switch (plane & ~PLANAR_ALIGNED)
+    {
+        case PLANAR_U: case PLANAR_B:
+            return offsetU;
+        case PLANAR_V: case PLANAR_R:
+            return offsetV;
+        case PLANAR_A:
+            return offsetA;
+        default:
+            return offset;
+    }
+}
+
+const BYTE* VideoFrame::GetReadPtr(int plane) const
+{
+    return vfb->data + GetOffset(plane);
+}
+
+BYTE* VideoFrame::GetWritePtr(int plane) const
+{
+    return vfb->data + GetOffset(plane);
+}
+
+
+// PVideoFrame ---------------------------------------------------------
+
+PVideoFrame::PVideoFrame() : p(NULL) { }
+PVideoFrame::PVideoFrame(const PVideoFrame& x) { Init(x.p); }
+PVideoFrame::PVideoFrame(VideoFrame* x) { Init(x); }
+void PVideoFrame::operator=(VideoFrame* x) { Set(x); }
+void PVideoFrame::operator=(const PVideoFrame& x) { Set(x.p); }
+PVideoFrame::~PVideoFrame() { if (p != NULL) p->Release(); }
+
+void PVideoFrame::Init(VideoFrame* x)
+{
+    p = x;
+    if (p != NULL)
+    {
+        p->AddRef();
+    }
+}
+
+void PVideoFrame::Set(VideoFrame* x)
+{
+    if (x != NULL)
+    {
+        x->AddRef();
+    }
+    if (p != NULL)
+    {
+        p->Release();
+    }
+    p = x;
+}
+
+
+// IClip and PClip -----------------------------------------------------
+
+void IClip::AddRef()
+{
+    incrementCount(&refcnt);
+}
+
+void IClip::Release()
+{
+    if (decrementCount(&refcnt) == 0)
+    {
+        delete this;
+    }
+}
+
+PClip::PClip() : p(NULL) { }
+PClip::PClip(const PClip& x) { Init(x.p); }
+PClip::PClip(IClip* x) { Init(x); }
+void PClip::operator=(IClip* x) { Set(x); }
+void PClip::operator=(const PClip& x) { Set(x.p); }
+PClip::~PClip() { if (p != NULL) p->Release(); }
+
+void PClip::Init(IClip* x)
+{
+    p = x;
+    if (p != NULL)
+    {
+        p->AddRef();
+    }
+}
+
+void PClip::Set(IClip* x)
+{
+    if (x != NULL)
+    {
+        x->AddRef();
+    }
+    if (p != NULL)
+    {
+        p->Release();
+    }
+    p = x;
+}
+
+
+// AVSValue ------------------------------------------------------------
+// Arrays are deep copies, as with NEW_AVSVALUE in the core; strings
+// are not owned (see ScriptEnvironment::SaveString()).
+
+AVSValue::AVSValue() { type = 'v'; array_size = 0; clip = NULL; }
+AVSValue::AVSValue(IClip* c) { type = 'c'; array_size = 0; clip = c; if (c != NULL) c->AddRef(); }
+AVSValue::AVSValue(const PClip& c) { type = 'c'; array_size = 0; clip = c.operator->(); if (clip != NULL) clip->AddRef(); }
+AVSValue::AVSValue(bool b) { type = 'b'; array_size = 0; clip = NULL; boolean = b; }
+AVSValue::AVSValue(int i) { type = 'i'; array_size = 0; clip = NULL; integer = i; }
+AVSValue::AVSValue(float f) { type = 'f'; array_size = 0; clip = NULL; floating_pt = f; }
+AVSValue::AVSValue(double f) { type = 'f'; array_size = 0; clip = NULL; floating_pt = float (f); }
+AVSValue::AVSValue(const char* s) { type = 's'; array_size = 0; clip = NULL; string = s; }
+AVSValue::AVSValue(const AVSValue& v) { Assign(&v, true); }
+
+AVSValue::~AVSValue()
+{
+    if (type == 'c' && clip != NULL)
+    {
+        clip->Release();
+    }
+    if (type == 'a')
+    {
+        delete[] array;
+    }
+}
+
+AVSValue& AVSValue::operator=(const AVSValue& v) { Assign(&v, false); return *this; }
+
+AVSValue::AVSValue(const AVSValue* a, int size)
+{
+    AVSValue array;
+    array.type = 'a';
+    array.array_size = short (size);
+    array.array = a;
+    Assign(&array, true);
+    array.type = 'v';
+}
+
+AVSValue::AVSValue(const AVSValue& a, int size)
+{
+    AVSValue array;
+    array.type = 'a';
+    array.array_size = short (size);
+    array.array = &a;
+    Assign(&array, true);
+    array.type = 'v';
+}
+
+void AVSValue::Assign(const AVSValue* src, bool init)
+{
+    if (src->type == 'c' && src->clip != NULL)
+    {
+        src->clip->AddRef();
+    }
+
+    AVSValue* arrayP = NULL;
+    if (src->type == 'a' && src->array_size > 0)
+    {
+        arrayP = new AVSValue[src->array_size];
+        std::copy(src->array, src->array + src->array_size, arrayP);
+    }
+
+    if (!init)
+    {
+        if (type == 'c' && clip != NULL)
+        {
+            clip->Release();
+        }
+        if (type == 'a')
+        {
+            delete[] array;
+        }
+    }
+
+    type = src->type;
+    array_size = src->array_size;
+    switch (type)
+    {
+        case 'a': array = arrayP; break;
+        case 'c': clip = src->clip; break;
+        case 'b': boolean = src->boolean; break;
+        case 'i': integer = src->integer; break;
+        case 'f': floating_pt = src->floating_pt; break;
+        case 's': string = src->string; break;
+        default:  clip = NULL; break;
+    }
+}
+
+bool AVSValue::Defined() const { return type != 'v'; }
+bool AVSValue::IsClip() const { return type == 'c'; }
+bool AVSValue::IsBool() const { return type == 'b'; }
+bool AVSValue::IsInt() const { return type == 'i'; }
+bool AVSValue::IsFloat() const { return type == 'f' || type == 'i'; }
+bool AVSValue::IsString() const { return type == 's'; }
+bool AVSValue::IsArray() const { return type == 'a'; }
+bool AVSValue::IsFunction() const { return false; }
+
+PClip AVSValue::AsClip() const { return IsClip() ? clip : NULL; }
+bool AVSValue::AsBool() const { return boolean; }
+int AVSValue::AsInt() const { return integer; }
+const char* AVSValue::AsString() const { return IsString() ? string : NULL; }
+double AVSValue::AsFloat() const { return IsInt() ? integer : floating_pt; }
+
+bool AVSValue::AsBool(bool def) const { return IsBool() ? boolean : def; }
+int AVSValue::AsInt(int def) const { return IsInt() ? integer : def; }
+double AVSValue::AsDblDef(double def) const { return IsFloat() ? AsFloat() : def; }
+double AVSValue::AsFloat(float def) const { return IsFloat() ? AsFloat() : def; }
+const char* AVSValue::AsString(const char* def) const { return IsString() ? string : def; }
+
+int AVSValue::ArraySize() const { return IsArray() ? array_size : 1; }
+
+const AVSValue& AVSValue::operator[](int index) const
+{
+    return IsArray() ? array[index] : *this;
+}
+
+
+// MockClip ------------------------------------------------------------
+
+/** MockClip constructor
+  *
+  * PARAMETERS:
+  *     IN vi_ - the format of the clip; the audio, if any, must be float
+  *     seed_  - distinguishes the frames and samples of the clips
+  */
+MockClip::MockClip(const VideoInfo& vi_, int seed_)
+: vi(vi_),
+  seed(seed_),
+  frameMicros(0),
+  seekMicros(0),
+  lastFrame(-1),
+  frameCalls(0),
+  audioCalls(0),
+  samplesRead(0)
+{
+}
+
+
+/** makeVideoInfo
+  *
+  * RETURNS:
+  *     the format of a clip with float audio, or no audio if <audioRate>
+  *     is 0
+  */
+VideoInfo MockClip::makeVideoInfo(int width, int height, int pixelType, int numFrames,
+                                  unsigned int fpsNumerator, unsigned int fpsDenominator,
+                                  int audioRate, int channels)
+{
+    VideoInfo vi = emptyVideoInfo;
+    vi.width = width;
+    vi.height = height;
+    vi.pixel_type = pixelType;
+    vi.num_frames = numFrames;
+    vi.fps_numerator = fpsNumerator;
+    vi.fps_denominator = fpsDenominator;
+    if (audioRate > 0)
+    {
+        vi.audio_samples_per_second = audioRate;
+        vi.sample_type = SAMPLE_FLOAT;
+        vi.nchannels = channels;
+        vi.num_audio_samples = vi.AudioSamplesFromFrames(numFrames);
+    }
+    return vi;
+}
+
+
+/** sampleValue
+  *
+  * RETURNS:
+  *     the value of a sample of channel <channel> in the clip of seed
+  *     <seed>; exact multiples of 2^-15 in [-1, 1)
+  */
+float MockClip::sampleValue(int seed, int64_t sample, int channel) throw()
+{
+    unsigned int x =   unsigned (sample) * 2654435761u
+                     ^ unsigned (sample >> 32) * 40503u
+                     ^ unsigned (channel + 1) * 0x9E3779B9u
+                     ^ unsigned (seed) * 0x85EBCA6Bu;
+    x ^= x >> 15;
+    x *= 0x2C1B3C6Du;
+    x ^= x >> 12;
+    return float (int (x & 0xFFFF) - 32768) / 32768.0f;
+}
+
+
+/** readStamp
+  *
+  * PARAMETERS:
+  *     IN frame - a frame returned by a MockClip
+  *     OUT seedP  - receives the seed of the clip
+  *     OUT frameP - receives the frame number
+  *
+  * RETURNS:
+  *     false if the frame is too small to hold the stamp
+  */
+bool MockClip::readStamp(const PVideoFrame& frame, int* seedP, int* frameP)
+{
+    if (!frame || frame->GetRowSize() < int (2 * sizeof (int)))
+    {
+        return false;
+    }
+
+    const BYTE* const rowP = frame->GetReadPtr();
+    memcpy(seedP, rowP, sizeof (int));
+    memcpy(frameP, rowP + sizeof (int), sizeof (int));
+    return true;
+}
+
+
+/** setCosts
+  *
+  *     Sets the simulated decoding time.
+  *
+  * PARAMETERS:
+  *     frameMicros_ - busy time of each GetFrame, in microseconds
+  *     seekMicros_  - additional time when the frame does not follow the
+  *                      previous one
+  */
+void MockClip::setCosts(int frameMicros_, int seekMicros_) throw()
+{
+    frameMicros = frameMicros_;
+    seekMicros = seekMicros_;
+}
+
+
+int64_t MockClip::getFrameCalls() const throw() { return frameCalls.load(); }
+int64_t MockClip::getAudioCalls() const throw() { return audioCalls.load(); }
+int64_t MockClip::getSamplesRead() const throw() { return samplesRead.load(); }
+
+
+PVideoFrame __stdcall MockClip::GetFrame(int n, IScriptEnvironment* envP)
+{
+    ++frameCalls;
+
+    const int prev = lastFrame.exchange(n);
+    spin(frameMicros + ((n != prev + 1 && n != prev) ? seekMicros : 0));
+
+    PVideoFrame frame = envP->NewVideoFrame(vi);
+    if (frame->GetRowSize() >= int (2 * sizeof (int)))
+    {
+        BYTE* const rowP = frame->GetWritePtr();
+        memcpy(rowP, &seed, sizeof (int));
+        memcpy(rowP + sizeof (int), &n, sizeof (int));
+    }
+    return frame;
+}
+
+
+bool __stdcall MockClip::GetParity(int n)
+{
+    return false;
+}
+
+
+void __stdcall MockClip::GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* envP)
+{
+    ++audioCalls;
+    samplesRead += count;
+
+    const int channels = vi.AudioChannels();
+    SFLOAT* samples = static_cast<SFLOAT*>(buf);
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const int64_t sample = start + i;
+        const bool inFlag = (sample >= 0 && sample < vi.num_audio_samples);
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            *samples++ = inFlag ? sampleValue(seed, sample, ch) : 0.0f;
+        }
+    }
+}
+
+
+int __stdcall MockClip::SetCacheHints(int cachehints, int frame_range)
+{
+    return (cachehints == CACHE_GET_MTMODE) ? MT_NICE_FILTER : 0;
+}
+
+
+const VideoInfo& __stdcall MockClip::GetVideoInfo()
+{
+    return vi;
+}
+
+
+// Built-in filters ----------------------------------------------------
+
+// Trim(clip, first, last): a negative <last> is a frame count, 0 the end
+// of the clip.
+class MockTrim : public GenericVideoFilter
+{
+public:
+    MockTrim(PClip child_, int first_, int count)
+    : GenericVideoFilter(child_),
+      first(first_),
+      audioOffset(vi.AudioSamplesFromFrames(first_))
+    {
+        vi.num_frames = count;
+        if (vi.HasAudio())
+        {
+            vi.num_audio_samples = std::min(vi.AudioSamplesFromFrames(count),
+                                            child->GetVideoInfo().num_audio_samples - audioOffset);
+        }
+    }
+
+    static AVSValue __cdecl Create(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+    {
+        const PClip clip = args[0].AsClip();
+        const int numFrames = clip->GetVideoInfo().num_frames;
+        const int first = std::min(std::max(args[1].AsInt(), 0), numFrames);
+        const int last = args[2].AsInt();
+        const int count =   (last < 0)  ? -last
+                          : (last == 0) ? numFrames - first
+                          :               last - first + 1;
+        if (count <= 0 || first + count > numFrames)
+        {
+            envP->ThrowError("Trim: invalid range");
+        }
+        return AVSValue(new MockTrim(clip, first, count));
+    }
+
+    PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* envP)
+    {
+        return child->GetFrame(first + std::min(std::max(n, 0), vi.num_frames - 1), envP);
+    }
+
+    void __stdcall GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* envP)
+    {
+        child->GetAudio(buf, start + audioOffset, count, envP);
+    }
+
+    int __stdcall SetCacheHints(int cachehints, int frame_range)
+    {
+        return (cachehints == CACHE_GET_MTMODE) ? MT_NICE_FILTER : 0;
+    }
+
+private:
+    const int first;
+    const int64_t audioOffset;
+};
+
+
+// ConvertAudio(clip, type, preferred type): float only, which the mock
+// clips already are.
+static AVSValue __cdecl createConvertAudio(AVSValue args, void* userDataP, IScriptEnvironment* envP)
+{
+    const PClip clip = args[0].AsClip();
+    const VideoInfo& vi = clip->GetVideoInfo();
+    if (vi.HasAudio() && vi.SampleType() != SAMPLE_FLOAT)
+    {
+        envP->ThrowError("ConvertAudio: only float audio is supported by the mock environment");
+    }
+    if (args[1].AsInt() != SAMPLE_FLOAT)
+    {
+        envP->ThrowError("ConvertAudio: only the conversion to float is supported by the mock environment");
+    }
+    return args[0];
+}
+
+
+// ScriptEnvironment ---------------------------------------------------
+
+/** ScriptEnvironment constructor
+  */
+ScriptEnvironment::ScriptEnvironment()
+: functions(),
+  stringMutex(),
+  strings(),
+  atExit()
+{
+    AddFunction("Trim", "cii", MockTrim::Create, NULL);
+    AddFunction("ConvertAudio", "cii", createConvertAudio, NULL);
+}
+
+
+/** ScriptEnvironment destructor
+  *
+  *     Calls the AtExit() functions, last registered first.
+  */
+ScriptEnvironment::~ScriptEnvironment()
+{
+    while (!atExit.empty())
+    {
+        const std::pair<ShutdownFunc, void*> entry = atExit.back();
+        atExit.pop_back();
+        entry.first(entry.second, this);
+    }
+}
+
+
+/** parseArgument
+  *
+  *     Converts the text of a named argument to the type of the
+  *     parameter, for the command lines of the tools.
+  *
+  * PARAMETERS:
+  *     IN name    - the name of a registered function
+  *     IN argName - the name of a parameter of <name>
+  *     IN text    - the value
+  *
+  * RETURNS:
+  *     the value; strings are saved with SaveString()
+  *
+  * THROWS:
+  *     AvisynthError if the function or the parameter doesn't exist, or
+  *       the text isn't a valid value
+  */
+AVSValue ScriptEnvironment::parseArgument(const char* name, const char* argName, const char* text)
+{
+    const Param* paramP = findParam(name, argName);
+    if (paramP == NULL)
+    {
+        ThrowError("%s has no parameter named %s", name, argName);
+    }
+
+    char* endP;
+    switch (paramP->type)
+    {
+        case 'i':
+        {
+            const long value = strtol(text, &endP, 10);
+            if (*text == '\0' || *endP != '\0')
+            {
+                ThrowError("%s: %s must be an integer", name, argName);
+            }
+            return AVSValue(int (value));
+        }
+
+        case 'f':
+        {
+            const double value = strtod(text, &endP);
+            if (*text == '\0' || *endP != '\0')
+            {
+                ThrowError("%s: %s must be a number", name, argName);
+            }
+            return AVSValue(value);
+        }
+
+        case 'b':
+            if (strcmp(text, "true") == 0)
+            {
+                return AVSValue(true);
+            }
+            if (strcmp(text, "false") == 0)
+            {
+                return AVSValue(false);
+            }
+            ThrowError("%s: %s must be true or false", name, argName);
+
+        case 's':
+            return AVSValue(SaveString(text));
+
+        default:
+            ThrowError("%s: %s can't be given as text", name, argName);
+    }
+
+    return AVSValue();
+}
+
+
+// The flags of the host processor, as far as RemapFrames looks at them;
+// none where the compiler can't tell.
+int __stdcall ScriptEnvironment::GetCPUFlags()
+{
+    int flags = 0;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    flags |= __builtin_cpu_supports("sse2") ? CPUF_SSE2 : 0;
+    flags |= __builtin_cpu_supports("avx2") ? CPUF_AVX2 : 0;
+    flags |= __builtin_cpu_supports("avx512f") ? CPUF_AVX512F : 0;
+    flags |= __builtin_cpu_supports("avx512bw") ? CPUF_AVX512BW : 0;
+#endif
+    return flags;
+}
+
+
+char* __stdcall ScriptEnvironment::SaveString(const char* s, int length)
+{
+    std::lock_guard<std::mutex> lock(stringMutex);
+    strings.push_back((length < 0) ? std::string(s) : std::string(s, length));
+    return &strings.back()[0];
+}
+
+
+char* ScriptEnvironment::Sprintf(const char* fmt, ...)
+{
+    va_list val;
+    va_start(val, fmt);
+    char* const s = VSprintf(fmt, val);
+    va_end(val);
+    return s;
+}
+
+
+char* __stdcall ScriptEnvironment::VSprintf(const char* fmt, va_list val)
+{
+    char buf[4096];
+    vsnprintf(buf, sizeof buf, fmt, val);
+    return SaveString(buf);
+}
+
+
+void ScriptEnvironment::ThrowError(const char* fmt, ...)
+{
+    va_list val;
+    va_start(val, fmt);
+    const char* const msg = VSprintf(fmt, val);
+    va_end(val);
+    throw AvisynthError(msg);
+}
+
+
+void __stdcall ScriptEnvironment::AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data)
+{
+    Function function;
+    function.params = parseParams(params);
+    function.apply = apply;
+    function.userDataP = user_data;
+
+    std::vector<Function>& overloads = functions[lowercase(name)];
+    overloads.insert(overloads.begin(), function);
+}
+
+
+bool __stdcall ScriptEnvironment::FunctionExists(const char* name)
+{
+    return functions.count(lowercase(name)) != 0;
+}
+
+
+/** Invoke
+  *
+  *     Calls the last registered overload of <name> accepting the
+  *     arguments. <args> is an array, or a single argument;
+  *     <arg_names> has one name per argument, NULL for the positional
+  *     ones.
+  *
+  * THROWS:
+  *     NotFound if there is no function <name>; AvisynthError if no
+  *       overload accepts the arguments
+  */
+AVSValue __stdcall ScriptEnvironment::Invoke(const char* name, const AVSValue args, const char* const* arg_names)
+{
+    std::map<std::string, std::vector<Function> >::const_iterator it = functions.find(lowercase(name));
+    if (it == functions.end())
+    {
+        throw NotFound();
+    }
+
+    std::vector<AVSValue> bound;
+    for (size_t i = 0; i < it->second.size(); ++i)
+    {
+        const Function& function = it->second[i];
+        if (bindArguments(function, args, arg_names, &bound))
+        {
+            return function.apply(bound.empty() ? AVSValue() : AVSValue(&bound[0], int (bound.size())),
+                                  function.userDataP, this);
+        }
+    }
+
+    ThrowError("Invalid arguments to function \"%s\"", name);
+    return AVSValue();
+}
+
+
+PVideoFrame __stdcall ScriptEnvironment::NewVideoFrame(const VideoInfo& vi, int align)
+{
+    const int alignment = std::max(align, int (FRAME_ALIGN));
+    const int rowSize = vi.BytesFromPixels(vi.width);
+    const int pitch = (rowSize + alignment - 1) / alignment * alignment;
+    int size = pitch * vi.height;
+
+    int offsetU = 0;
+    int offsetV = 0;
+    int pitchUV = 0;
+    int rowSizeUV = 0;
+    int heightUV = 0;
+    if (vi.IsPlanar() && !vi.IsY())
+    {
+        rowSizeUV = vi.BytesFromPixels(vi.width >> vi.GetPlaneWidthSubsampling(PLANAR_U));
+        pitchUV = (rowSizeUV + alignment - 1) / alignment * alignment;
+        heightUV = vi.height >> vi.GetPlaneHeightSubsampling(PLANAR_U);
+        offsetU = size;
+        offsetV = offsetU + pitchUV * heightUV;
+        size = offsetV + pitchUV * heightUV;
+    }
+
+    int offsetA = 0;
+    if (vi.IsYUVA() || vi.IsPlanarRGBA())
+    {
+        offsetA = size;
+        size += pitch * vi.height;
+    }
+
+    VideoFrameBuffer* const vfbP = new VideoFrameBuffer(std::max(size, 1), alignment, NULL);
+    return new VideoFrame(vfbP, new AVSMap(), 0, pitch, rowSize, vi.height,
+                          offsetU, offsetV, pitchUV, rowSizeUV, heightUV, offsetA);
+}
+
+
+void __stdcall ScriptEnvironment::BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height)
+{
+    for (int y = 0; y < height; ++y, dstp += dst_pitch, srcp += src_pitch)
+    {
+        memcpy(dstp, srcp, row_size);
+    }
+}
+
+
+PVideoFrame __stdcall ScriptEnvironment::NewVideoFrameP(const VideoInfo& vi, PVideoFrame* propSrc, int align)
+{
+    PVideoFrame frame = NewVideoFrame(vi, align);
+    if (propSrc != NULL && *propSrc)
+    {
+        copyFrameProps(*propSrc, frame);
+    }
+    return frame;
+}
+
+
+// The subframes share the buffer of <src> and get a copy of its
+// properties, as in the core.
+PVideoFrame __stdcall ScriptEnvironment::Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height)
+{
+    return new VideoFrame(src->vfb, new AVSMap(*src->properties), src->offset + rel_offset,
+                          new_pitch, new_row_size, new_height, 0, 0, 0, 0, 0, 0);
+}
+
+
+PVideoFrame __stdcall ScriptEnvironment::SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+                                                        int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV)
+{
+    return SubframePlanarA(src, rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV, 0);
+}
+
+
+PVideoFrame __stdcall ScriptEnvironment::SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+                                                         int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV,
+                                                         int rel_offsetA)
+{
+    // The chroma planes keep the subsampling of <src>
+    const int rowSizeUV = (src->row_size != 0) ? new_row_size * src->row_sizeUV / src->row_size : 0;
+    const int heightUV = (src->height != 0) ? new_height * src->heightUV / src->height : 0;
+    return new VideoFrame(src->vfb, new AVSMap(*src->properties), src->offset + rel_offset,
+                          new_pitch, new_row_size, new_height,
+                          src->offsetU + rel_offsetU, src->offsetV + rel_offsetV, new_pitchUV, rowSizeUV, heightUV,
+                          (src->offsetA != 0) ? src->offsetA + rel_offsetA : 0);
+}
+
+
+void __stdcall ScriptEnvironment::copyFrameProps(const PVideoFrame& src, PVideoFrame& dst)
+{
+    *dst->properties = *src->properties;
+}
+
+
+const AVSMap* __stdcall ScriptEnvironment::getFramePropsRO(const PVideoFrame& frame)
+{
+    return frame->properties;
+}
+
+
+AVSMap* __stdcall ScriptEnvironment::getFramePropsRW(PVideoFrame& frame)
+{
+    return frame->properties;
+}
+
+
+int __stdcall ScriptEnvironment::propNumKeys(const AVSMap* map)
+{
+    return int (map->ints.size());
+}
+
+
+const char* __stdcall ScriptEnvironment::propGetKey(const AVSMap* map, int index)
+{
+    if (index < 0 || index >= int (map->ints.size()))
+    {
+        ThrowError("propGetKey: index %d out of range", index);
+    }
+
+    std::map<std::string, std::vector<int64_t> >::const_iterator it = map->ints.begin();
+    std::advance(it, index);
+    return it->first.c_str();
+}
+
+
+int __stdcall ScriptEnvironment::propNumElements(const AVSMap* map, const char* key)
+{
+    std::map<std::string, std::vector<int64_t> >::const_iterator it = map->ints.find(key);
+    return (it != map->ints.end()) ? int (it->second.size()) : -1;
+}
+
+
+char __stdcall ScriptEnvironment::propGetType(const AVSMap* map, const char* key)
+{
+    return (map->ints.count(key) != 0) ? 'i' : 'u';
+}
+
+
+int64_t __stdcall ScriptEnvironment::propGetInt(const AVSMap* map, const char* key, int index, int* error)
+{
+    int status = 0;
+    int64_t value = 0;
+    std::map<std::string, std::vector<int64_t> >::const_iterator it = map->ints.find(key);
+    if (it == map->ints.end())
+    {
+        status = GETPROPERROR_UNSET;
+    }
+    else if (index < 0 || index >= int (it->second.size()))
+    {
+        status = GETPROPERROR_INDEX;
+    }
+    else
+    {
+        value = it->second[index];
+    }
+
+    if (error != NULL)
+    {
+        *error = status;
+    }
+    else if (status != 0)
+    {
+        ThrowError("propGetInt: no element %d for key \"%s\"", index, key);
+    }
+    return value;
+}
+
+
+const int64_t* __stdcall ScriptEnvironment::propGetIntArray(const AVSMap* map, const char* key, int* error)
+{
+    std::map<std::string, std::vector<int64_t> >::const_iterator it = map->ints.find(key);
+    const bool setFlag = (it != map->ints.end());
+    if (error != NULL)
+    {
+        *error = setFlag ? 0 : GETPROPERROR_UNSET;
+    }
+    else if (!setFlag)
+    {
+        ThrowError("propGetIntArray: no key \"%s\"", key);
+    }
+    return (setFlag && !it->second.empty()) ? &it->second[0] : NULL;
+}
+
+
+int __stdcall ScriptEnvironment::propDeleteKey(AVSMap* map, const char* key)
+{
+    return int (map->ints.erase(key));
+}
+
+
+int __stdcall ScriptEnvironment::propSetInt(AVSMap* map, const char* key, int64_t i, int append)
+{
+    std::vector<int64_t>& values = map->ints[key];
+    switch (append)
+    {
+        case PROPAPPENDMODE_REPLACE:
+            values.assign(1, i);
+            break;
+
+        case PROPAPPENDMODE_APPEND:
+            values.push_back(i);
+            break;
+
+        default:
+            // PROPAPPENDMODE_TOUCH: only creates the key
+            break;
+    }
+    return 0;
+}
+
+
+int __stdcall ScriptEnvironment::propSetIntArray(AVSMap* map, const char* key, const int64_t* i, int size)
+{
+    map->ints[key].assign(i, i + size);
+    return 0;
+}
+
+
+void __stdcall ScriptEnvironment::clearMap(AVSMap* map)
+{
+    map->ints.clear();
+}
+
+
+void __stdcall ScriptEnvironment::AtExit(ShutdownFunc function, void* user_data)
+{
+    atExit.push_back(std::make_pair(function, user_data));
+}
+
+
+void __stdcall ScriptEnvironment::CheckVersion(int version)
+{
+    if (version > AVISYNTH_INTERFACE_VERSION)
+    {
+        ThrowError("Plugin was designed for a later version of Avisynth (%d)", version);
+    }
+}
+
+
+void __stdcall ScriptEnvironment::DeleteScriptEnvironment()
+{
+    delete this;
+}
+
+
+const AVS_Linkage* __stdcall ScriptEnvironment::GetAVSLinkage()
+{
+    return NULL;
+}
+
+
+void* __stdcall ScriptEnvironment::Allocate(size_t nBytes, size_t alignment, AvsAllocType type)
+{
+    return allocateAligned(nBytes, alignment);
+}
+
+
+void __stdcall ScriptEnvironment::Free(void* ptr)
+{
+    freeAligned(ptr);
+}
+
+
+bool __stdcall ScriptEnvironment::InvokeTry(AVSValue* result, const char* name, const AVSValue& args, const char* const* arg_names)
+{
+    try
+    {
+        *result = Invoke(name, args, arg_names);
+        return true;
+    }
+    catch (const NotFound&)
+    {
+        return false;
+    }
+}
+
+
+// No script variables: the lookups fail or return their default.
+AVSValue __stdcall ScriptEnvironment::GetVar(const char* name) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::GetVarDef(const char* name, const AVSValue& def) { return def; }
+bool __stdcall ScriptEnvironment::GetVarTry(const char* name, AVSValue* val) const { return false; }
+bool __stdcall ScriptEnvironment::GetVarBool(const char* name, bool def) const { return def; }
+int __stdcall ScriptEnvironment::GetVarInt(const char* name, int def) const { return def; }
+double __stdcall ScriptEnvironment::GetVarDouble(const char* name, double def) const { return def; }
+const char* __stdcall ScriptEnvironment::GetVarString(const char* name, const char* def) const { return def; }
+int64_t __stdcall ScriptEnvironment::GetVarLong(const char* name, int64_t def) const { return def; }
+
+// No cache or memory management
+int __stdcall ScriptEnvironment::SetMemoryMax(int mem) { return 0; }
+void* __stdcall ScriptEnvironment::ManageCache(int key, void* data) { return NULL; }
+size_t __stdcall ScriptEnvironment::GetEnvProperty(AvsEnvProperty prop) { return 0; }
+
+// Unsupported services
+#define MOCK_UNSUPPORTED(name) ThrowError("%s is not supported by the mock environment", name)
+
+bool __stdcall ScriptEnvironment::SetVar(const char* name, const AVSValue& val) { MOCK_UNSUPPORTED("SetVar"); return false; }
+bool __stdcall ScriptEnvironment::SetGlobalVar(const char* name, const AVSValue& val) { MOCK_UNSUPPORTED("SetGlobalVar"); return false; }
+void __stdcall ScriptEnvironment::PushContext(int level) { MOCK_UNSUPPORTED("PushContext"); }
+void __stdcall ScriptEnvironment::PopContext() { MOCK_UNSUPPORTED("PopContext"); }
+bool __stdcall ScriptEnvironment::MakeWritable(PVideoFrame* pvf) { MOCK_UNSUPPORTED("MakeWritable"); return false; }
+int __stdcall ScriptEnvironment::SetWorkingDir(const char* newdir) { MOCK_UNSUPPORTED("SetWorkingDir"); return -1; }
+bool __stdcall ScriptEnvironment::PlanarChromaAlignment(PlanarChromaAlignmentMode key) { MOCK_UNSUPPORTED("PlanarChromaAlignment"); return false; }
+void __stdcall ScriptEnvironment::ApplyMessage(PVideoFrame* frame, const VideoInfo& vi, const char* message, int size,
+                                               int textcolor, int halocolor, int bgcolor)
+    { MOCK_UNSUPPORTED("ApplyMessage"); }
+double __stdcall ScriptEnvironment::propGetFloat(const AVSMap* map, const char* key, int index, int* error) { MOCK_UNSUPPORTED("propGetFloat"); return 0; }
+const char* __stdcall ScriptEnvironment::propGetData(const AVSMap* map, const char* key, int index, int* error) { MOCK_UNSUPPORTED("propGetData"); return NULL; }
+int __stdcall ScriptEnvironment::propGetDataSize(const AVSMap* map, const char* key, int index, int* error) { MOCK_UNSUPPORTED("propGetDataSize"); return 0; }
+PClip __stdcall ScriptEnvironment::propGetClip(const AVSMap* map, const char* key, int index, int* error) { MOCK_UNSUPPORTED("propGetClip"); return PClip(); }
+const PVideoFrame __stdcall ScriptEnvironment::propGetFrame(const AVSMap* map, const char* key, int index, int* error) { MOCK_UNSUPPORTED("propGetFrame"); return PVideoFrame(); }
+int __stdcall ScriptEnvironment::propSetFloat(AVSMap* map, const char* key, double d, int append) { MOCK_UNSUPPORTED("propSetFloat"); return 1; }
+int __stdcall ScriptEnvironment::propSetData(AVSMap* map, const char* key, const char* d, int length, int append) { MOCK_UNSUPPORTED("propSetData"); return 1; }
+int __stdcall ScriptEnvironment::propSetClip(AVSMap* map, const char* key, PClip& clip, int append) { MOCK_UNSUPPORTED("propSetClip"); return 1; }
+int __stdcall ScriptEnvironment::propSetFrame(AVSMap* map, const char* key, const PVideoFrame& frame, int append) { MOCK_UNSUPPORTED("propSetFrame"); return 1; }
+const double* __stdcall ScriptEnvironment::propGetFloatArray(const AVSMap* map, const char* key, int* error) { MOCK_UNSUPPORTED("propGetFloatArray"); return NULL; }
+int __stdcall ScriptEnvironment::propSetFloatArray(AVSMap* map, const char* key, const double* d, int size) { MOCK_UNSUPPORTED("propSetFloatArray"); return 1; }
+AVSMap* __stdcall ScriptEnvironment::createMap() { MOCK_UNSUPPORTED("createMap"); return NULL; }
+void __stdcall ScriptEnvironment::freeMap(AVSMap* map) { MOCK_UNSUPPORTED("freeMap"); }
+AVSValue __stdcall ScriptEnvironment::Invoke2(const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names)
+    { MOCK_UNSUPPORTED("Invoke2"); return AVSValue(); }
+bool __stdcall ScriptEnvironment::Invoke2Try(AVSValue* result, const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names)
+    { MOCK_UNSUPPORTED("Invoke2Try"); return false; }
+AVSValue __stdcall ScriptEnvironment::Invoke3(const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names)
+    { MOCK_UNSUPPORTED("Invoke3"); return AVSValue(); }
+bool __stdcall ScriptEnvironment::Invoke3Try(AVSValue* result, const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names)
+    { MOCK_UNSUPPORTED("Invoke3Try"); return false; }
+
+#undef MOCK_UNSUPPORTED
+
+
+std::string ScriptEnvironment::lowercase(const char* s)
+{
+    std::string result(s);
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        result[i] = char (tolower((unsigned char) result[i]));
+    }
+    return result;
+}
+
+
+// Tells if <value> can be passed to a parameter of type <type>
+bool ScriptEnvironment::matches(char type, const AVSValue& value)
+{
+    switch (type)
+    {
+        case 'c': return value.IsClip();
+        case 'i': return value.IsInt();
+        case 'f': return value.IsFloat();
+        case 's': return value.IsString();
+        case 'b': return value.IsBool();
+        default:  return true;
+    }
+}
+
+
+/** parseParams
+  *
+  * PARAMETERS:
+  *     IN params - a function signature, such as "c[mappings]s";
+  *                   repeated parameters ('*', '+') are not supported
+  */
+std::vector<ScriptEnvironment::Param> ScriptEnvironment::parseParams(const char* params)
+{
+    std::vector<Param> result;
+    const char* curP = params;
+    while (*curP != '\0')
+    {
+        Param param;
+        param.optionalFlag = false;
+        if (*curP == '[')
+        {
+            const char* const endP = strchr(curP, ']');
+            if (endP == NULL)
+            {
+                break;
+            }
+            param.name.assign(curP + 1, endP);
+            param.optionalFlag = true;
+            curP = endP + 1;
+        }
+        param.type = *curP++;
+        result.push_back(param);
+    }
+    return result;
+}
+
+
+/** bindArguments
+  *
+  *     Places the arguments in the order of the parameters of
+  *     <function>.
+  *
+  * RETURNS:
+  *     false if the arguments don't fit the parameters
+  */
+bool ScriptEnvironment::bindArguments(const Function& function, const AVSValue& args, const char* const* arg_names,
+                                      std::vector<AVSValue>* boundP) const
+{
+    const std::vector<Param>& params = function.params;
+    boundP->assign(params.size(), AVSValue());
+
+    size_t nextPositional = 0;
+    for (int i = 0; i < args.ArraySize(); ++i)
+    {
+        const AVSValue& arg = args[i];
+        size_t p;
+        if (arg_names != NULL && arg_names[i] != NULL)
+        {
+            const std::string name = lowercase(arg_names[i]);
+            for (p = 0; p < params.size() && lowercase(params[p].name.c_str()) != name; ++p)
+            {
+            }
+        }
+        else
+        {
+            p = nextPositional++;
+        }
+
+        if (p >= params.size() || (*boundP)[p].Defined() || !matches(params[p].type, arg))
+        {
+            return false;
+        }
+        (*boundP)[p] = arg;
+    }
+
+    for (size_t p = 0; p < params.size(); ++p)
+    {
+        if (!params[p].optionalFlag && !(*boundP)[p].Defined())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// The parameter <argName> of the last overload of <name> having it
+const ScriptEnvironment::Param* ScriptEnvironment::findParam(const char* name, const char* argName)
+{
+    std::map<std::string, std::vector<Function> >::const_iterator it = functions.find(lowercase(name));
+    if (it == functions.end())
+    {
+        return NULL;
+    }
+
+    const std::string target = lowercase(argName);
+    for (size_t i = 0; i < it->second.size(); ++i)
+    {
+        const std::vector<Param>& params = it->second[i].params;
+        for (size_t p = 0; p < params.size(); ++p)
+        {
+            if (lowercase(params[p].name.c_str()) == target)
+            {
+                return &params[p];
+            }
+        }
+    }
+    return NULL;
+}
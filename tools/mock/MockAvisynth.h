@@ -0,0 +1,207 @@
+/** MockAvisynth
+  *     Minimal stand-in for the AviSynth core, to run the filters of the
+  *     plug-in without AviSynth installed (replay and benchmark tools).
+  *
+  *     The plug-in sources and this module are compiled with
+  *     BUILDING_AVSCORE defined: the AviSynth classes are then called
+  *     directly instead of through the AVS_Linkage table, and this module
+  *     defines the members the plug-in and the tools use. Frames are
+  *     planar, or single-plane packed, and their properties can only be
+  *     integers.
+  */
+
+#ifndef MOCKAVISYNTH_H
+#define MOCKAVISYNTH_H
+
+#include <atomic>
+#include <cstdarg>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <avisynth.h>
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+// Frame properties: arrays of integers by key, the only type supported
+// by the mock
+class AVSMap
+{
+public:
+    std::map<std::string, std::vector<int64_t> > ints;
+};
+
+
+// Synthetic clip. Frame n starts with the seed and the frame number
+// (see readStamp()); the audio is float, with a deterministic value per
+// sample and channel (see sampleValue()). Safe to call from several
+// threads.
+class MockClip : public IClip
+{
+public:
+    MockClip(const VideoInfo& vi_, int seed_);
+
+    static VideoInfo makeVideoInfo(int width, int height, int pixelType, int numFrames,
+                                   unsigned int fpsNumerator, unsigned int fpsDenominator,
+                                   int audioRate, int channels);
+    static float sampleValue(int seed, int64_t sample, int channel) throw();
+    static bool readStamp(const PVideoFrame& frame, int* seedP, int* frameP);
+
+    void setCosts(int frameMicros, int seekMicros) throw();
+
+    int64_t getFrameCalls() const throw();
+    int64_t getAudioCalls() const throw();
+    int64_t getSamplesRead() const throw();
+
+    virtual PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* envP);
+    virtual bool __stdcall GetParity(int n);
+    virtual void __stdcall GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* envP);
+    virtual int __stdcall SetCacheHints(int cachehints, int frame_range);
+    virtual const VideoInfo& __stdcall GetVideoInfo();
+
+private:
+    VideoInfo vi;
+    const int seed;
+
+    // Simulated decoding: busy time of each frame, plus <seekMicros>
+    // when a frame isn't the one following the previous frame.
+    int frameMicros;
+    int seekMicros;
+    std::atomic<int> lastFrame;
+
+    std::atomic<int64_t> frameCalls;
+    std::atomic<int64_t> audioCalls;
+    std::atomic<int64_t> samplesRead;
+};
+
+
+// The scripting environment. Functions registered with AddFunction()
+// can be invoked with positional and named arguments; Trim and
+// ConvertAudio (to float only) are built in. The other services throw
+// AvisynthError.
+class ScriptEnvironment : public IScriptEnvironment
+{
+public:
+    ScriptEnvironment();
+    virtual ~ScriptEnvironment();
+
+    AVSValue parseArgument(const char* name, const char* argName, const char* text);
+
+    virtual int __stdcall GetCPUFlags();
+    virtual char* __stdcall SaveString(const char* s, int length = -1);
+    virtual char* Sprintf(const char* fmt, ...);
+    virtual char* __stdcall VSprintf(const char* fmt, va_list val);
+    virtual void ThrowError(const char* fmt, ...);
+    virtual void __stdcall AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data);
+    virtual bool __stdcall FunctionExists(const char* name);
+    virtual AVSValue __stdcall Invoke(const char* name, const AVSValue args, const char* const* arg_names = 0);
+    virtual AVSValue __stdcall GetVar(const char* name);
+    virtual bool __stdcall SetVar(const char* name, const AVSValue& val);
+    virtual bool __stdcall SetGlobalVar(const char* name, const AVSValue& val);
+    virtual void __stdcall PushContext(int level = 0);
+    virtual void __stdcall PopContext();
+    virtual PVideoFrame __stdcall NewVideoFrame(const VideoInfo& vi, int align = FRAME_ALIGN);
+    virtual bool __stdcall MakeWritable(PVideoFrame* pvf);
+    virtual void __stdcall BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height);
+    virtual void __stdcall AtExit(ShutdownFunc function, void* user_data);
+    virtual void __stdcall CheckVersion(int version = AVISYNTH_INTERFACE_VERSION);
+    virtual PVideoFrame __stdcall Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height);
+    virtual int __stdcall SetMemoryMax(int mem);
+    virtual int __stdcall SetWorkingDir(const char* newdir);
+    virtual void* __stdcall ManageCache(int key, void* data);
+    virtual bool __stdcall PlanarChromaAlignment(PlanarChromaAlignmentMode key);
+    virtual PVideoFrame __stdcall SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+                                                 int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV);
+    virtual void __stdcall DeleteScriptEnvironment();
+    virtual void __stdcall ApplyMessage(PVideoFrame* frame, const VideoInfo& vi, const char* message, int size,
+                                       int textcolor, int halocolor, int bgcolor);
+    virtual const AVS_Linkage* __stdcall GetAVSLinkage();
+    virtual AVSValue __stdcall GetVarDef(const char* name, const AVSValue& def = AVSValue());
+    virtual PVideoFrame __stdcall SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+                                                  int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV,
+                                                  int rel_offsetA);
+    virtual void __stdcall copyFrameProps(const PVideoFrame& src, PVideoFrame& dst);
+    virtual const AVSMap* __stdcall getFramePropsRO(const PVideoFrame& frame);
+    virtual AVSMap* __stdcall getFramePropsRW(PVideoFrame& frame);
+    virtual int __stdcall propNumKeys(const AVSMap* map);
+    virtual const char* __stdcall propGetKey(const AVSMap* map, int index);
+    virtual int __stdcall propNumElements(const AVSMap* map, const char* key);
+    virtual char __stdcall propGetType(const AVSMap* map, const char* key);
+    virtual int64_t __stdcall propGetInt(const AVSMap* map, const char* key, int index, int* error);
+    virtual double __stdcall propGetFloat(const AVSMap* map, const char* key, int index, int* error);
+    virtual const char* __stdcall propGetData(const AVSMap* map, const char* key, int index, int* error);
+    virtual int __stdcall propGetDataSize(const AVSMap* map, const char* key, int index, int* error);
+    virtual PClip __stdcall propGetClip(const AVSMap* map, const char* key, int index, int* error);
+    virtual const PVideoFrame __stdcall propGetFrame(const AVSMap* map, const char* key, int index, int* error);
+    virtual int __stdcall propDeleteKey(AVSMap* map, const char* key);
+    virtual int __stdcall propSetInt(AVSMap* map, const char* key, int64_t i, int append);
+    virtual int __stdcall propSetFloat(AVSMap* map, const char* key, double d, int append);
+    virtual int __stdcall propSetData(AVSMap* map, const char* key, const char* d, int length, int append);
+    virtual int __stdcall propSetClip(AVSMap* map, const char* key, PClip& clip, int append);
+    virtual int __stdcall propSetFrame(AVSMap* map, const char* key, const PVideoFrame& frame, int append);
+    virtual const int64_t* __stdcall propGetIntArray(const AVSMap* map, const char* key, int* error);
+    virtual const double* __stdcall propGetFloatArray(const AVSMap* map, const char* key, int* error);
+    virtual int __stdcall propSetIntArray(AVSMap* map, const char* key, const int64_t* i, int size);
+    virtual int __stdcall propSetFloatArray(AVSMap* map, const char* key, const double* d, int size);
+    virtual AVSMap* __stdcall createMap();
+    virtual void __stdcall freeMap(AVSMap* map);
+    virtual void __stdcall clearMap(AVSMap* map);
+    virtual PVideoFrame __stdcall NewVideoFrameP(const VideoInfo& vi, PVideoFrame* propSrc, int align = FRAME_ALIGN);
+    virtual size_t __stdcall GetEnvProperty(AvsEnvProperty prop);
+    virtual void* __stdcall Allocate(size_t nBytes, size_t alignment, AvsAllocType type);
+    virtual void __stdcall Free(void* ptr);
+    virtual bool __stdcall GetVarTry(const char* name, AVSValue* val) const;
+    virtual bool __stdcall GetVarBool(const char* name, bool def) const;
+    virtual int __stdcall GetVarInt(const char* name, int def) const;
+    virtual double __stdcall GetVarDouble(const char* name, double def) const;
+    virtual const char* __stdcall GetVarString(const char* name, const char* def) const;
+    virtual int64_t __stdcall GetVarLong(const char* name, int64_t def) const;
+    virtual bool __stdcall InvokeTry(AVSValue* result, const char* name, const AVSValue& args, const char* const* arg_names = 0);
+    virtual AVSValue __stdcall Invoke2(const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names = 0);
+    virtual bool __stdcall Invoke2Try(AVSValue* result, const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names = 0);
+    virtual AVSValue __stdcall Invoke3(const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names = 0);
+    virtual bool __stdcall Invoke3Try(AVSValue* result, const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names = 0);
+
+private:
+    // One parameter of a function signature
+    struct Param
+    {
+        std::string name;   // empty for the unnamed parameters
+        char type;          // 'c', 'i', 'f', 's', 'b' or '.'
+        bool optionalFlag;
+    };
+
+    struct Function
+    {
+        std::vector<Param> params;
+        ApplyFunc apply;
+        void* userDataP;
+    };
+
+    // by lowercase name; the last added overload first
+    std::map<std::string, std::vector<Function> > functions;
+
+    // guards <strings>
+    std::mutex stringMutex;
+    std::deque<std::string> strings;
+
+    std::vector<std::pair<ShutdownFunc, void*> > atExit;
+
+    static std::string lowercase(const char* s);
+    static bool matches(char type, const AVSValue& value);
+    static std::vector<Param> parseParams(const char* params);
+    bool bindArguments(const Function& function, const AVSValue& args, const char* const* arg_names,
+                       std::vector<AVSValue>* boundP) const;
+    const Param* findParam(const char* name, const char* argName);
+
+    ScriptEnvironment(const ScriptEnvironment&);
+    ScriptEnvironment& operator=(const ScriptEnvironment&);
+};
+
+
+#endif // MOCKAVISYNTH_H
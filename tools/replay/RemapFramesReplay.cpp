@@ -0,0 +1,345 @@
+/** RemapFramesReplay
+  *     Replays an access trace recorded with the traceFile option against
+  *     a filter built on mock clips, to benchmark configurations of the
+  *     engine and of the caches on real-world access patterns.
+  *
+  *     usage: RemapFramesReplay [switches] trace function [name=value ...]
+  *
+  *     The filter is built by calling <function> with mock clips of the
+  *     formats recorded in the trace and the named arguments (mappings,
+  *     options). The mappings must be those of the recording.
+  *
+  *     switches:
+  *         -threads      replays the requests of each recorded thread in
+  *                         its own thread; otherwise all the requests are
+  *                         replayed in order from one thread
+  *         -timed        waits for the recorded time of each request;
+  *                         otherwise replays as fast as possible
+  *         -frameCost us simulated decoding time of a source frame
+  *         -seekCost us  additional decoding time of a non-sequential
+  *                         source frame
+  *         -repeat n     replays the trace n times
+  */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MockAvisynth.h"
+#include "TraceRecorder.h"
+
+
+
+// CLASS PROTOTYPES ----------------------------------------------------
+
+extern "C" const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* envP, const AVS_Linkage* const vectors);
+
+
+// Latencies of one kind of request
+struct Latencies
+{
+    std::vector<double> micros;
+
+    void report(const char* name) const;
+};
+
+
+// Requests of one replay thread, and what it measured
+struct ReplayThread
+{
+    std::vector<const TraceRecorder::Record*> records;
+    Latencies frames;
+    Latencies audio;
+    std::string error;
+};
+
+
+
+// LOCAL FUNCTIONS -----------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: RemapFramesReplay [switches] trace function [name=value ...]\n"
+            "switches: -threads -timed -frameCost us -seekCost us -repeat n\n");
+    exit(2);
+}
+
+
+/** Latencies::report
+  *
+  *     Prints the count, mean and percentiles of the latencies.
+  */
+void Latencies::report(const char* name) const
+{
+    if (micros.empty())
+    {
+        return;
+    }
+
+    std::vector<double> sorted(micros);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        total += sorted[i];
+    }
+
+    printf("%s: %u requests, mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           name, unsigned (sorted.size()), total / sorted.size(),
+           sorted[sorted.size() / 2], sorted[sorted.size() * 99 / 100], sorted.back());
+}
+
+
+// Case-insensitive comparison, as for the script function names
+static bool sameName(const char* aP, const char* bP)
+{
+    for (; *aP != '\0' && tolower((unsigned char) *aP) == tolower((unsigned char) *bP); ++aP, ++bP)
+    {
+    }
+    return *aP == *bP;
+}
+
+
+// Makes a mock clip from its description in the trace header
+static PClip makeClip(const TraceRecorder::ClipInfo& info, int seed, int frameCost, int seekCost)
+{
+    const VideoInfo vi = MockClip::makeVideoInfo(info.width, info.height, info.pixelType, info.numFrames,
+                                                 info.fpsNumerator, info.fpsDenominator,
+                                                 info.audioRate, info.channels);
+    MockClip* clipP = new MockClip(vi, seed);
+    clipP->setCosts(frameCost, seekCost);
+    return clipP;
+}
+
+
+/** replay
+  *
+  *     Runs the requests of a thread on the filter.
+  *
+  * PARAMETERS:
+  *     IN/OUT threadP - the requests; receives the latencies, or the
+  *                        error that stopped the replay
+  *     IN clip        - the filter
+  *     channels       - the number of audio channels of the filter
+  *     timedFlag      - indicates if the recorded times are kept
+  *     start          - the start of the replay, for <timedFlag>
+  *     IN/OUT envP    - the mock environment
+  */
+static void replay(ReplayThread* threadP, PClip clip, int channels, bool timedFlag,
+                   std::chrono::steady_clock::time_point start, IScriptEnvironment* envP)
+{
+    std::vector<SFLOAT> samples;
+
+    try
+    {
+        for (size_t i = 0; i < threadP->records.size(); ++i)
+        {
+            const TraceRecorder::Record& record = *threadP->records[i];
+            if (timedFlag)
+            {
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.time));
+            }
+
+            const std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+            if (record.type == TraceRecorder::GET_FRAME)
+            {
+                clip->GetFrame(int (record.arg0), envP);
+            }
+            else
+            {
+                samples.resize(size_t(record.arg1) * std::max(channels, 1));
+                clip->GetAudio(samples.data(), record.arg0, record.arg1, envP);
+            }
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - before;
+
+            ((record.type == TraceRecorder::GET_FRAME) ? threadP->frames : threadP->audio).micros.push_back(elapsed.count());
+        }
+    }
+    catch (const AvisynthError& err)
+    {
+        threadP->error = err.msg;
+    }
+}
+
+
+
+// MAIN ----------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    bool threadsFlag = false;
+    bool timedFlag = false;
+    int frameCost = 0;
+    int seekCost = 0;
+    int repeat = 1;
+
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; ++argi)
+    {
+        const std::string name = argv[argi];
+        if (name == "-threads")
+        {
+            threadsFlag = true;
+        }
+        else if (name == "-timed")
+        {
+            timedFlag = true;
+        }
+        else if (argi + 1 < argc && (name == "-frameCost" || name == "-seekCost" || name == "-repeat"))
+        {
+            const int value = atoi(argv[++argi]);
+            (name == "-frameCost" ? frameCost : name == "-seekCost" ? seekCost : repeat) = value;
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (argc - argi < 2)
+    {
+        usage();
+    }
+    const char* const traceFileP = argv[argi++];
+    const char* const functionP = argv[argi++];
+
+    TraceRecorder::Header header;
+    std::vector<TraceRecorder::Record> records;
+    if (!TraceRecorder::load(traceFileP, &header, &records))
+    {
+        fprintf(stderr, "%s: not a readable trace of version %d\n", traceFileP, int (TraceRecorder::VERSION));
+        return 1;
+    }
+
+    ScriptEnvironment env;
+    try
+    {
+        AvisynthPluginInit3(&env, NULL);
+
+        // The clips, then the named arguments
+        const PClip baseClip = makeClip(header.clips[TraceRecorder::BASE_CLIP], 0, frameCost, seekCost);
+        std::vector<AVSValue> args(1, AVSValue(baseClip));
+        std::vector<const char*> names(1, (const char*) NULL);
+        if (!(header.flags & TraceRecorder::SOURCE_IS_BASE))
+        {
+            const PClip sourceClip = makeClip(header.clips[TraceRecorder::SOURCE_CLIP], 1, frameCost, seekCost);
+            args.push_back(AVSValue(sourceClip));
+
+            // The replace filters take the source clip second
+            names.push_back(   sameName(functionP, "ReplaceFramesSimple")
+                            || sameName(functionP, "rfs")
+                            ? NULL : "sourceClip");
+        }
+        for (; argi < argc; ++argi)
+        {
+            const char* const equalP = strchr(argv[argi], '=');
+            if (equalP == NULL)
+            {
+                usage();
+            }
+            const std::string name(argv[argi], equalP - argv[argi]);
+            names.push_back(env.SaveString(name.c_str()));
+            args.push_back(env.parseArgument(functionP, name.c_str(), equalP + 1));
+        }
+
+        const PClip clip = env.Invoke(functionP, AVSValue(args.data(), int (args.size())), names.data()).AsClip();
+        const VideoInfo& vi = clip->GetVideoInfo();
+        if (vi.num_frames != header.clips[TraceRecorder::OUTPUT_CLIP].numFrames)
+        {
+            fprintf(stderr, "warning: %d output frames, %d when recorded\n",
+                    vi.num_frames, header.clips[TraceRecorder::OUTPUT_CLIP].numFrames);
+        }
+
+        // Requests to replay, by thread; the child calls are counted for
+        // the comparison with the replay
+        std::map<int, ReplayThread> threads;
+        int64_t recordedChildFrames = 0;
+        int64_t recordedChildSamples = 0;
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            const TraceRecorder::Record& record = records[i];
+            switch (record.type)
+            {
+                case TraceRecorder::GET_FRAME:
+                case TraceRecorder::GET_AUDIO:
+                    threads[threadsFlag ? record.thread : 0].records.push_back(&record);
+                    break;
+
+                case TraceRecorder::CHILD_FRAME:
+                    ++recordedChildFrames;
+                    break;
+
+                case TraceRecorder::CHILD_AUDIO:
+                    recordedChildSamples += record.arg1;
+                    break;
+            }
+        }
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat; ++r)
+        {
+            const std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+            for (std::map<int, ReplayThread>::iterator it = threads.begin(); it != threads.end(); ++it)
+            {
+                workers.push_back(std::thread(replay, &it->second, clip, vi.AudioChannels(), timedFlag,
+                                              passStart, &env));
+            }
+            for (size_t i = 0; i < workers.size(); ++i)
+            {
+                workers[i].join();
+            }
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        Latencies frames;
+        Latencies audio;
+        for (std::map<int, ReplayThread>::const_iterator it = threads.begin(); it != threads.end(); ++it)
+        {
+            if (!it->second.error.empty())
+            {
+                fprintf(stderr, "thread %d: %s\n", it->first, it->second.error.c_str());
+                return 1;
+            }
+            frames.micros.insert(frames.micros.end(), it->second.frames.micros.begin(), it->second.frames.micros.end());
+            audio.micros.insert(audio.micros.end(), it->second.audio.micros.begin(), it->second.audio.micros.end());
+        }
+
+        printf("elapsed: %.3f s, %u threads\n", elapsed.count(), unsigned (threads.size()));
+        frames.report("GetFrame");
+        audio.report("GetAudio");
+
+        const MockClip* baseP = static_cast<const MockClip*>(baseClip.operator->());
+        const MockClip* sourceP = static_cast<const MockClip*>(args[1].IsClip() ? args[1].AsClip().operator->() : baseP);
+        int64_t childFrames = baseP->getFrameCalls();
+        int64_t childSamples = baseP->getSamplesRead();
+        if (sourceP != baseP)
+        {
+            childFrames += sourceP->getFrameCalls();
+            childSamples += sourceP->getSamplesRead();
+        }
+        printf("source frames: %lld recorded, %lld replayed\n",
+               (long long) recordedChildFrames * repeat, (long long) childFrames);
+        printf("source samples: %lld recorded, %lld replayed\n",
+               (long long) recordedChildSamples * repeat, (long long) childSamples);
+    }
+    catch (const AvisynthError& err)
+    {
+        fprintf(stderr, "%s\n", err.msg);
+        return 1;
+    }
+    catch (const IScriptEnvironment::NotFound&)
+    {
+        fprintf(stderr, "%s: no such function\n", functionP);
+        return 1;
+    }
+
+    return 0;
+}